@@ -11,6 +11,9 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "lensfun.h"
 #include "image.h"
 #include "auxfun.h"
@@ -44,6 +47,11 @@ static struct
     lfLensType TargetGeom;
     const char *Database;
     bool Verbose;
+    bool Benchmark;
+    unsigned BenchmarkWidth;
+    unsigned BenchmarkHeight;
+    int BenchmarkRuns;
+    int MaxThreads;
 } opts =
 {
     NULL,
@@ -61,7 +69,12 @@ static struct
     Image::I_LANCZOS,
     LF_RECTILINEAR,
     NULL,
-    false
+    false,
+    false,
+    6000,
+    4000,
+    3,
+    0
 };
 
 
@@ -101,6 +114,12 @@ static void DisplayUsage ()
     g_print ("\n");
     g_print ("  -o#   --output=#   Set file name for output image\n");
     g_print ("        --database=# Only use the specified database folder or file\n");
+    g_print ("\n");
+    g_print ("  -B[#] --benchmark[=#] Time the processing stages on a synthetic image\n");
+    g_print ("                     of the given size (default 6000x4000) instead of\n");
+    g_print ("                     processing an input file\n");
+    g_print ("        --runs=#     Number of benchmark runs; the best one is shown\n");
+    g_print ("        --threads=#  Largest number of threads of the benchmark\n");
     g_print ("        --verbose    Verbose output\n");
     g_print ("        --version    Display program version and exit\n");
     g_print ("  -h    --help       Display this help text\n");
@@ -128,13 +147,16 @@ static bool ParseParameters(int argc, char **argv)
         {"database", required_argument, NULL, 3},
         {"version", no_argument, NULL, 4},
         {"verbose", no_argument, NULL, 5},
+        {"benchmark", optional_argument, NULL, 'B'},
+        {"runs", required_argument, NULL, 6},
+        {"threads", required_argument, NULL, 7},
         {0, 0, 0, 0}
     };
 
     opts.Program = argv [0];
 
     int c;
-    while ((c = getopt_long (argc, argv, "o:dg::tvaiS:L:C:c:F:A:D:I:h", long_options, NULL)) != EOF) {
+    while ((c = getopt_long (argc, argv, "o:dg::tvaiS:L:C:c:F:A:D:I:B::h", long_options, NULL)) != EOF) {
         switch (c) {
             case 'o':
                 opts.Output = optarg;
@@ -229,6 +251,24 @@ static bool ParseParameters(int argc, char **argv)
             case 5:
                 opts.Verbose = true;
                 break;
+            case 'B':
+                opts.Benchmark = true;
+                if (optarg &&
+                    (sscanf (optarg, "%ux%u", &opts.BenchmarkWidth, &opts.BenchmarkHeight) != 2 ||
+                     !opts.BenchmarkWidth || !opts.BenchmarkHeight)) {
+                    DisplayUsage();
+                    g_print ("\nThe benchmark image size must be given as WIDTHxHEIGHT\n");
+                    return false;
+                }
+                break;
+            case 6:
+                opts.BenchmarkRuns = atoi (optarg);
+                if (opts.BenchmarkRuns < 1)
+                    opts.BenchmarkRuns = 1;
+                break;
+            case 7:
+                opts.MaxThreads = atoi (optarg);
+                break;
             default:
                 return false;
         }
@@ -249,6 +289,12 @@ static bool ParseParameters(int argc, char **argv)
         return false;
     }
 
+    if (!opts.Lens && opts.Benchmark) {
+        DisplayUsage();
+        g_print ("\nNo lens information (-L) supplied for the benchmark!\n");
+        return false;
+    }
+
     return true;
 }
 
@@ -355,6 +401,177 @@ static Image *ApplyModifier (int modflags, bool reverse, Image *img,
 }
 
 
+/* The benchmark computes the coordinates of this many rows at once and then
+   resamples them, so that both can be timed separately. */
+#define BENCHMARK_BAND 64
+
+struct BenchmarkTimes
+{
+    // All in microseconds
+    gint64 Vignetting, TCA, Geometry, Resampling;
+};
+
+/* Runs the same stages as ApplyModifier with COMBINE_13 undefined, but with
+   every stage parallelised over rows and timed on its own. */
+static void BenchmarkModifier (int modflags, Image *&img, Image *&newimg,
+                               const lfModifier *mod, float *pos,
+                               BenchmarkTimes &times)
+{
+    const int width = img->width, height = img->height;
+    gint64 start;
+
+    times.Vignetting = times.TCA = times.Geometry = times.Resampling = 0;
+
+    if (modflags & LF_MODIFY_VIGNETTING)
+    {
+        start = g_get_monotonic_time ();
+#pragma omp parallel for schedule(static)
+        for (int y = 0; y < height; y++)
+            mod->ApplyColorModification (img->image + y * width, 0.0, y, width, 1,
+                LF_CR_4 (RED, GREEN, BLUE, UNKNOWN), 0);
+        times.Vignetting = g_get_monotonic_time () - start;
+    }
+
+    if (modflags & LF_MODIFY_TCA)
+    {
+        img->InitInterpolation (opts.Interpolation);
+        for (int y0 = 0; y0 < height; y0 += BENCHMARK_BAND)
+        {
+            const int y1 = y0 + BENCHMARK_BAND < height ? y0 + BENCHMARK_BAND : height;
+
+            start = g_get_monotonic_time ();
+#pragma omp parallel for schedule(static)
+            for (int y = y0; y < y1; y++)
+                mod->ApplySubpixelDistortion (0.0, y, width, 1, pos + (y - y0) * width * 2 * 3);
+            times.TCA += g_get_monotonic_time () - start;
+
+            start = g_get_monotonic_time ();
+#pragma omp parallel for schedule(static)
+            for (int y = y0; y < y1; y++)
+            {
+                const float *src = pos + (y - y0) * width * 2 * 3;
+                RGBpixel *dst = newimg->image + y * width;
+                for (int x = 0; x < width; x++)
+                {
+                    dst->red   = img->GetR (src [0], src [1]);
+                    dst->green = img->GetG (src [2], src [3]);
+                    dst->blue  = img->GetB (src [4], src [5]);
+                    src += 2 * 3;
+                    dst++;
+                }
+            }
+            times.Resampling += g_get_monotonic_time () - start;
+        }
+        Image *tmp = newimg;
+        newimg = img;
+        img = tmp;
+    }
+
+    if (modflags & (LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    {
+        img->InitInterpolation (opts.Interpolation);
+        for (int y0 = 0; y0 < height; y0 += BENCHMARK_BAND)
+        {
+            const int y1 = y0 + BENCHMARK_BAND < height ? y0 + BENCHMARK_BAND : height;
+
+            start = g_get_monotonic_time ();
+#pragma omp parallel for schedule(static)
+            for (int y = y0; y < y1; y++)
+                mod->ApplyGeometryDistortion (0.0, y, width, 1, pos + (y - y0) * width * 2);
+            times.Geometry += g_get_monotonic_time () - start;
+
+            start = g_get_monotonic_time ();
+#pragma omp parallel for schedule(static)
+            for (int y = y0; y < y1; y++)
+            {
+                const float *src = pos + (y - y0) * width * 2;
+                RGBpixel *dst = newimg->image + y * width;
+                for (int x = 0; x < width; x++)
+                {
+                    img->Get (*dst, src [0], src [1]);
+                    src += 2;
+                    dst++;
+                }
+            }
+            times.Resampling += g_get_monotonic_time () - start;
+        }
+        Image *tmp = newimg;
+        newimg = img;
+        img = tmp;
+    }
+}
+
+static int RunBenchmark (const lfLens *lens)
+{
+    const unsigned width = opts.BenchmarkWidth, height = opts.BenchmarkHeight;
+
+    lfModifier *mod = new lfModifier (lens, opts.Crop, width, height);
+    int modflags = mod->Initialize (
+        lens, LF_PF_U8, opts.Focal,
+        opts.Aperture, opts.Distance, opts.Scale, opts.TargetGeom,
+        opts.ModifyFlags, opts.Inverse);
+    if (!modflags) {
+        g_print ("\rERROR: none of the requested corrections is possible with this lens\n");
+        delete mod;
+        return -1;
+    }
+
+    // A synthetic test pattern; the speed does not depend on the contents
+    Image *img = new Image ();
+    Image *newimg = new Image ();
+    img->Resize (width, height);
+    newimg->Resize (width, height);
+    for (unsigned y = 0; y < height; y++)
+        for (unsigned x = 0; x < width; x++)
+        {
+            RGBpixel &p = img->image [y * width + x];
+            p.red = x;
+            p.green = y;
+            p.blue = ((x >> 4) ^ (y >> 4)) & 1 ? 255 : 0;
+        }
+    float *pos = new float [BENCHMARK_BAND * width * 2 * 3];
+
+#ifdef _OPENMP
+    int max_threads = opts.MaxThreads > 0 ? opts.MaxThreads : omp_get_max_threads ();
+#else
+    int max_threads = 1;
+#endif
+
+    g_print ("~ Benchmark on a %ux%u image, best of %d runs, times in ms\n",
+             width, height, opts.BenchmarkRuns);
+    g_print ("threads  vignetting       tca  geometry  resampling     total   Mpix/s\n");
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads (threads);
+#endif
+        BenchmarkTimes best;
+        gint64 best_total = 0;
+        for (int run = 0; run < opts.BenchmarkRuns; run++)
+        {
+            BenchmarkTimes times;
+            BenchmarkModifier (modflags, img, newimg, mod, pos, times);
+            gint64 total = times.Vignetting + times.TCA + times.Geometry + times.Resampling;
+            if (!run || total < best_total)
+            {
+                best = times;
+                best_total = total;
+            }
+        }
+        g_print ("%7d %11.1f %9.1f %9.1f %11.1f %9.1f %8.1f\n", threads,
+                 best.Vignetting / 1e3, best.TCA / 1e3, best.Geometry / 1e3,
+                 best.Resampling / 1e3, best_total / 1e3,
+                 best_total ? double (width) * height / best_total : 0.0);
+        if (threads >= max_threads)
+            break;
+    }
+
+    delete [] pos;
+    delete newimg;
+    delete img;
+    delete mod;
+    return 0;
+}
 
 int main (int argc, char **argv)
 {
@@ -429,7 +646,7 @@ int main (int argc, char **argv)
     }
 
     // nothing to process, so lets quit here
-    if (!opts.Input) {
+    if (!opts.Input && !(opts.Benchmark && lens)) {
         delete ldb;
         return 0;
     }
@@ -456,6 +673,12 @@ int main (int argc, char **argv)
                 opts.Crop, opts.Focal, opts.Aperture, opts.Distance);
     }
 
+    if (opts.Benchmark) {
+        int rc = RunBenchmark (lens);
+        delete ldb;
+        return rc;
+    }
+
     Image *img = new Image ();
     g_print ("~ Loading `%s' ... ", opts.Input);
     if (!img->Open (opts.Input)) {
@@ -0,0 +1,417 @@
+/*
+    Benchmark of loading the database and looking up cameras and lenses.
+
+    The database is loaded several times; then a corpus of EXIF-like maker,
+    model, and lens strings is replayed against it, the way an application
+    does it for every image.  Unless a corpus file is given, the corpus is
+    made up from the database itself: exact names, mangled names which need
+    fuzzy matching, and names which are not in the database at all.  The
+    results are written as CSV.
+*/
+
+#include <glib.h>
+
+#include <clocale>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <ctime>
+
+#include "lensfun.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#if defined(__GLIBC__)
+/* glibc lets programs replace malloc; these count the calls (also those of
+   the library and GLib) and forward them to the real implementation. */
+extern "C"
+{
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static unsigned long allocations;
+
+void *malloc (size_t size) __THROW
+{
+  allocations++;
+  return __libc_malloc (size);
+}
+
+void *calloc (size_t n, size_t size) __THROW
+{
+  allocations++;
+  return __libc_calloc (n, size);
+}
+
+void *realloc (void *ptr, size_t size) __THROW
+{
+  allocations++;
+  return __libc_realloc (ptr, size);
+}
+}
+#define HAVE_ALLOCATION_COUNT
+#endif
+
+typedef enum
+{
+  LF_QUERY_EXACT,
+  LF_QUERY_FUZZY,
+  LF_QUERY_MISS
+} lfQueryKind;
+
+static const char *kind_names [] = { "exact", "fuzzy", "miss" };
+
+typedef struct
+{
+  lfQueryKind kind;
+  std::string maker, model, lens;
+} lfQuery;
+
+typedef struct
+{
+  const char *database;
+  const char *corpus;
+  int loads;
+  int queries;
+  FILE *out;
+} lfBenchOptions;
+
+static double now_ns ()
+{
+#ifdef _WIN32
+  return g_get_monotonic_time () * 1e3;
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+#endif
+}
+
+static unsigned long allocation_count ()
+{
+#ifdef HAVE_ALLOCATION_COUNT
+  return allocations;
+#else
+  return 0;
+#endif
+}
+
+static double percentile (std::vector<double> &values, double p)
+{
+  if (values.empty ())
+    return 0;
+  std::sort (values.begin (), values.end ());
+  size_t i = (size_t)(p * (values.size () - 1) + 0.5);
+  return values [i];
+}
+
+// Deterministic, so that runs are comparable
+static unsigned random_number (unsigned &seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+// Turns "Canon EF 24-70mm f/2.8L II USM" into "canon EF 24-70mm F2.8L II"
+static std::string mangle (const char *name)
+{
+  std::string result;
+  bool first_word = true;
+  for (const char *c = name; *c; c++)
+  {
+    if (*c == ' ' && first_word)
+    {
+      first_word = false;
+      result += ' ';
+      c++;
+      while (*c == ' ')
+        c++;
+      if (!*c)
+        break;
+    }
+    if (first_word)
+      result += tolower (*c);
+    else if (*c == 'f' && c [1] == '/')
+    {
+      result += 'F';
+      c++;
+    }
+    else
+      result += *c;
+  }
+  size_t last_space = result.rfind (' ');
+  if (last_space != std::string::npos && last_space > result.find (' '))
+    result.erase (last_space);
+  return result;
+}
+
+static void build_corpus (const lfDatabase *db, int count, std::vector<lfQuery> &corpus)
+{
+  const lfCamera *const *cameras = db->GetCameras ();
+  const lfLens *const *lenses = db->GetLenses ();
+  int n_cameras = 0, n_lenses = 0;
+  while (cameras && cameras [n_cameras])
+    n_cameras++;
+  while (lenses && lenses [n_lenses])
+    n_lenses++;
+  if (!n_cameras || !n_lenses)
+    return;
+
+  unsigned seed = 1;
+  for (int i = 0; i < count; i++)
+  {
+    const lfLens *lens = lenses [random_number (seed) % n_lenses];
+
+    // A camera the lens fits on, if there is one among a couple of tries
+    const lfCamera *camera = cameras [random_number (seed) % n_cameras];
+    for (int j = 0; j < 50 && lens->Mounts; j++)
+    {
+      const lfCamera *candidate = cameras [random_number (seed) % n_cameras];
+      bool fits = false;
+      for (int k = 0; lens->Mounts [k] && !fits; k++)
+        fits = !strcmp (lens->Mounts [k], candidate->Mount);
+      if (fits)
+      {
+        camera = candidate;
+        break;
+      }
+    }
+
+    lfQuery q;
+    unsigned r = random_number (seed) % 100;
+    q.kind = r < 60 ? LF_QUERY_EXACT : r < 85 ? LF_QUERY_FUZZY : LF_QUERY_MISS;
+    switch (q.kind)
+    {
+      case LF_QUERY_EXACT:
+        q.maker = lf_mlstr_get (camera->Maker);
+        q.model = lf_mlstr_get (camera->Model);
+        q.lens = lf_mlstr_get (lens->Model);
+        break;
+      case LF_QUERY_FUZZY:
+        q.maker = mangle (lf_mlstr_get (camera->Maker));
+        q.model = lf_mlstr_get (camera->Model);
+        q.lens = mangle (lf_mlstr_get (lens->Model));
+        break;
+      case LF_QUERY_MISS:
+        q.maker = "Nonexistent";
+        q.model = std::string ("Phantom ") + lf_mlstr_get (camera->Model);
+        q.lens = "Imaginary 17-170mm f/1.2 XYZ";
+        break;
+    }
+    corpus.push_back (q);
+  }
+}
+
+// One query per line: maker, model, and lens, separated by tabs
+static bool read_corpus (const char *filename, std::vector<lfQuery> &corpus)
+{
+  FILE *f = fopen (filename, "r");
+  if (!f)
+    return false;
+  char line [1024];
+  while (fgets (line, sizeof (line), f))
+  {
+    line [strcspn (line, "\r\n")] = 0;
+    char *model = strchr (line, '\t');
+    char *lens = model ? strchr (model + 1, '\t') : NULL;
+    if (lens)
+    {
+      lfQuery q;
+      q.kind = LF_QUERY_EXACT;
+      q.maker.assign (line, model - line);
+      q.model.assign (model + 1, lens - model - 1);
+      q.lens = lens + 1;
+      corpus.push_back (q);
+    }
+  }
+  fclose (f);
+  return true;
+}
+
+static void report (FILE *out, const char *metric, double value, const char *unit)
+{
+  fprintf (out, "%s,%.3f,%s\n", metric, value, unit);
+}
+
+static void usage (const char *program)
+{
+  g_print ("Usage: %s [-d DATABASE] [-l LOADS] [-n QUERIES] [-c CORPUS] [-o FILE]\n\n"
+           "  -d  Database file or folder (default data/db)\n"
+           "  -l  How often the database is loaded (default 5)\n"
+           "  -n  Number of generated queries (default 2000)\n"
+           "  -c  Read the queries from CORPUS instead, one \"maker<TAB>model<TAB>lens\"\n"
+           "      per line\n"
+           "  -o  Write the CSV results to FILE instead of standard output\n", program);
+}
+
+int main (int argc, char **argv)
+{
+  setlocale (LC_ALL, "C");
+
+  lfBenchOptions options;
+  options.database = "data/db";
+  options.corpus = NULL;
+  options.loads = 5;
+  options.queries = 2000;
+  options.out = stdout;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv [i];
+    if (i + 1 >= argc)
+    {
+      usage (argv [0]);
+      return 1;
+    }
+    const char *value = argv [++i];
+    if (!strcmp (arg, "-d"))
+      options.database = value;
+    else if (!strcmp (arg, "-l") && atoi (value) > 0)
+      options.loads = atoi (value);
+    else if (!strcmp (arg, "-n") && atoi (value) > 0)
+      options.queries = atoi (value);
+    else if (!strcmp (arg, "-c"))
+      options.corpus = value;
+    else if (!strcmp (arg, "-o"))
+    {
+      options.out = fopen (value, "w");
+      if (!options.out)
+      {
+        g_printerr ("Cannot open %s for writing\n", value);
+        return 1;
+      }
+    }
+    else
+    {
+      usage (argv [0]);
+      return 1;
+    }
+  }
+
+  // Loading
+  std::vector<double> load_times;
+  unsigned long load_allocations = 0;
+  lfDatabase *db = NULL;
+  for (int i = 0; i < options.loads; i++)
+  {
+    delete db;
+    db = new lfDatabase ();
+    unsigned long allocations_before = allocation_count ();
+    double start = now_ns ();
+    if (db->Load (options.database) != LF_NO_ERROR)
+    {
+      g_printerr ("Cannot load the database from %s\n", options.database);
+      delete db;
+      return 1;
+    }
+    load_times.push_back (now_ns () - start);
+    load_allocations = allocation_count () - allocations_before;
+  }
+
+  // Parsing the focal lengths and apertures from the lens names, which
+  // lfLens::Check does for every lens that is loaded
+  std::vector<double> guess_times;
+  for (int i = 0; i < options.loads; i++)
+    for (const lfLens *const *lens = db->GetLenses (); *lens; lens++)
+    {
+      lfLens probe;
+      probe.SetModel (lf_mlstr_get ((*lens)->Model));
+      double start = now_ns ();
+      probe.GuessParameters ();
+      guess_times.push_back (now_ns () - start);
+    }
+
+  std::vector<lfQuery> corpus;
+  if (options.corpus)
+  {
+    if (!read_corpus (options.corpus, corpus))
+    {
+      g_printerr ("Cannot read the corpus %s\n", options.corpus);
+      delete db;
+      return 1;
+    }
+  }
+  else
+    build_corpus (db, options.queries, corpus);
+
+  // Lookups
+  std::vector<double> camera_times, lens_times;
+  int queries [3] = { 0, 0, 0 }, hits [3] = { 0, 0, 0 };
+  unsigned long allocations_before = allocation_count ();
+  for (size_t i = 0; i < corpus.size (); i++)
+  {
+    const lfQuery &q = corpus [i];
+
+    double start = now_ns ();
+    const lfCamera **cameras = db->FindCamerasExt (q.maker.c_str (), q.model.c_str ());
+    camera_times.push_back (now_ns () - start);
+
+    start = now_ns ();
+    const lfLens **lenses = db->FindLenses (cameras ? cameras [0] : NULL, NULL,
+                                            q.lens.c_str ());
+    lens_times.push_back (now_ns () - start);
+
+    queries [q.kind]++;
+    if (lenses)
+      hits [q.kind]++;
+    lf_free (lenses);
+    lf_free (cameras);
+  }
+  unsigned long lookup_allocations = allocation_count () - allocations_before;
+
+  int n_cameras = 0, n_lenses = 0;
+  while (db->GetCameras () [n_cameras])
+    n_cameras++;
+  while (db->GetLenses () [n_lenses])
+    n_lenses++;
+
+  fprintf (options.out, "metric,value,unit\n");
+  report (options.out, "cameras", n_cameras, "count");
+  report (options.out, "lenses", n_lenses, "count");
+  report (options.out, "load_min", *std::min_element (load_times.begin (), load_times.end ()) / 1e6, "ms");
+  report (options.out, "load_p50", percentile (load_times, 0.5) / 1e6, "ms");
+#ifdef HAVE_ALLOCATION_COUNT
+  report (options.out, "load_allocations", load_allocations, "count");
+#endif
+  report (options.out, "guess_parameters_p50", percentile (guess_times, 0.5) / 1e3, "us");
+  report (options.out, "guess_parameters_p99", percentile (guess_times, 0.99) / 1e3, "us");
+#ifndef _WIN32
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  report (options.out, "peak_rss", usage.ru_maxrss / 1024.0, "KiB");
+#else
+  report (options.out, "peak_rss", usage.ru_maxrss, "KiB");
+#endif
+#endif
+  report (options.out, "queries", corpus.size (), "count");
+  for (int k = 0; k < 3; k++)
+    if (queries [k])
+    {
+      gchar *metric = g_strdup_printf ("lens_hit_rate_%s", kind_names [k]);
+      report (options.out, metric, 100.0 * hits [k] / queries [k], "%");
+      g_free (metric);
+    }
+  report (options.out, "camera_lookup_p50", percentile (camera_times, 0.5) / 1e3, "us");
+  report (options.out, "camera_lookup_p99", percentile (camera_times, 0.99) / 1e3, "us");
+  report (options.out, "lens_lookup_p50", percentile (lens_times, 0.5) / 1e3, "us");
+  report (options.out, "lens_lookup_p99", percentile (lens_times, 0.99) / 1e3, "us");
+#ifdef HAVE_ALLOCATION_COUNT
+  if (!corpus.empty ())
+    report (options.out, "lookup_allocations", (double)lookup_allocations / corpus.size (),
+            "count per query");
+#endif
+
+  delete db;
+  if (options.out != stdout)
+    fclose (options.out);
+  return 0;
+}
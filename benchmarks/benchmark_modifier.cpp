@@ -0,0 +1,470 @@
+/*
+    Micro-benchmarks of the modifier callbacks.
+
+    Every correction which lfModifier can set up is timed on its own, for all
+    pixel formats, a couple of image sizes, with and without the SIMD code
+    paths.  The results are written as CSV, one line per measurement, so that
+    they can be compared across releases.
+*/
+
+#include <glib.h>
+
+#include <clocale>
+#include <vector>
+#include <string>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "lensfun.h"
+#include "../libs/lensfun/lensfunprv.h"
+
+#include "../tests/common_code.hpp"
+
+enum lfBenchGroup
+{
+  LF_BENCH_COORD,
+  LF_BENCH_SUBPIXEL,
+  LF_BENCH_COLOR
+};
+
+static const char *group_names [] = { "coord", "subpixel", "color" };
+
+typedef struct
+{
+  lfBenchGroup  group;
+  std::string   name;
+  lfLens       *lens;
+  int           flags;
+  bool          reverse;
+  lfLensType    targeom;
+  float         scale;
+  bool          perspective;
+  // Whether the chain is purely radial, so that it may be tabulated
+  bool          radial;
+} lfBenchCase;
+
+typedef struct
+{
+  const char *name;
+  lfPixelFormat format;
+  size_t size;
+} lfBenchFormat;
+
+static const lfBenchFormat formats [] =
+{
+  { "u8",  LF_PF_U8,  sizeof (unsigned char) },
+  { "u16", LF_PF_U16, sizeof (unsigned short) },
+  { "u32", LF_PF_U32, sizeof (unsigned int) },
+  { "f32", LF_PF_F32, sizeof (float) },
+  { "f64", LF_PF_F64, sizeof (double) },
+};
+
+typedef struct
+{
+  const char *name;
+  int comp_role;
+  int cpp;
+} lfBenchLayout;
+
+static const lfBenchLayout layouts [] =
+{
+  { "RGB",  LF_CR_3 (RED, GREEN, BLUE), 3 },
+  { "RGBA", LF_CR_4 (RED, GREEN, BLUE, UNKNOWN), 4 },
+};
+
+typedef struct
+{
+  const char *name;
+  guint mask;
+} lfBenchIsa;
+
+// One entry per feature level the library dispatches on
+static const lfBenchIsa isas [] =
+{
+  { "scalar", 0 },
+  { "sse",    LF_CPU_FLAG_SSE },
+  { "sse2",   LF_CPU_FLAG_SSE | LF_CPU_FLAG_SSE2 },
+};
+
+typedef struct
+{
+  std::vector<int> widths, heights;
+  double min_time;
+  const char *filter;
+  FILE *out;
+} lfBenchOptions;
+
+// Does nothing, but makes the chain non-radial and thus disables the table
+static void identity_callback (void *data, float *iocoord, int count)
+{
+}
+
+static lfLens *new_lens (lfLensType type)
+{
+  lfLens *lens = new lfLens ();
+  lens->CropFactor = 1.0f;
+  lens->AspectRatio = 1.5f;
+  lens->Type = type;
+  return lens;
+}
+
+static void add_case (std::vector<lfBenchCase> &cases, lfBenchGroup group,
+                      const std::string &name, lfLens *lens, int flags,
+                      bool reverse, bool radial)
+{
+  lfBenchCase c;
+  c.group = group;
+  c.name = name;
+  c.lens = lens;
+  c.flags = flags;
+  c.reverse = reverse;
+  c.targeom = lens->Type;
+  c.scale = 1.0f;
+  c.perspective = false;
+  c.radial = radial;
+  cases.push_back (c);
+}
+
+static void build_cases (std::vector<lfBenchCase> &cases, std::vector<lfLens *> &lenses)
+{
+  // Typical coefficients; most of them are also used in the unit tests
+  lfLensCalibDistortion distortion [] =
+  {
+    { LF_DIST_MODEL_POLY3, 24.0f, 24.0f, false, { -0.00412f } },
+    { LF_DIST_MODEL_POLY5, 24.0f, 24.0f, false, { -0.030571633f, 0.004658548f } },
+    { LF_DIST_MODEL_PTLENS, 24.0f, 24.46704f, false, { 0.02964f, -0.07853f, 0.02943f } },
+    { LF_DIST_MODEL_ACM, 24.0f, 24.0f, false, { -0.0125f, 0.0021f, 0.0f, 0.0001f, -0.0002f } },
+  };
+  const char *distortion_names [] = { "poly3", "poly5", "ptlens", "acm" };
+  lfLensCalibTCA tca [] =
+  {
+    { LF_TCA_MODEL_LINEAR, 24.0f, { 1.0003f, 1.0003f } },
+    { LF_TCA_MODEL_POLY3, 24.0f, { 1.0002104f, 1.0000529f, 0.0f, 0.0f, -0.0000220f, 0.0f } },
+    { LF_TCA_MODEL_ACM, 24.0f, { 1.0002f, 0.0001f, 0.0f, 0.0f, 0.0f, 0.0f,
+                                 0.9998f, -0.0001f, 0.0f, 0.0f, 0.0f, 0.0f } },
+  };
+  const char *tca_names [] = { "linear", "poly3", "acm" };
+  lfLensCalibVignetting vignetting [] =
+  {
+    { LF_VIGNETTING_MODEL_PA, 24.0f, 2.8f, 1000.0f, { -0.5334f, -0.7926f, 0.5243f } },
+    { LF_VIGNETTING_MODEL_ACM, 24.0f, 2.8f, 1000.0f, { -0.3213f, 0.1102f, -0.0124f } },
+  };
+  const char *vignetting_names [] = { "pa", "acm" };
+
+  for (int reverse = 0; reverse < 2; reverse++)
+  {
+    const char *direction = reverse ? "reverse" : "forward";
+
+    for (size_t i = 0; i < ARRAY_LEN (distortion); i++)
+    {
+      lfLens *lens = new_lens (LF_RECTILINEAR);
+      lens->AddCalibDistortion (&distortion [i]);
+      lenses.push_back (lens);
+      add_case (cases, LF_BENCH_COORD, std::string ("distortion/") + distortion_names [i] +
+                "/" + direction, lens, LF_MODIFY_DISTORTION, reverse, true);
+    }
+
+    for (size_t i = 0; i < ARRAY_LEN (tca); i++)
+    {
+      lfLens *lens = new_lens (LF_RECTILINEAR);
+      lens->AddCalibTCA (&tca [i]);
+      lenses.push_back (lens);
+      add_case (cases, LF_BENCH_SUBPIXEL, std::string ("tca/") + tca_names [i] +
+                "/" + direction, lens, LF_MODIFY_TCA, reverse, true);
+    }
+
+    for (size_t i = 0; i < ARRAY_LEN (vignetting); i++)
+    {
+      lfLens *lens = new_lens (LF_RECTILINEAR);
+      lens->AddCalibVignetting (&vignetting [i]);
+      lenses.push_back (lens);
+      add_case (cases, LF_BENCH_COLOR, std::string ("vignetting/") + vignetting_names [i] +
+                "/" + direction, lens, LF_MODIFY_VIGNETTING, reverse, false);
+    }
+
+    lfLens *lens = new_lens (LF_RECTILINEAR);
+    lenses.push_back (lens);
+    add_case (cases, LF_BENCH_COORD, std::string ("scale/") + direction,
+              lens, LF_MODIFY_SCALE, reverse, true);
+    cases.back ().scale = 1.2f;
+  }
+
+  // Every geometry conversion; the reverse ones are the same callbacks
+  const lfLensType types [] =
+  {
+    LF_RECTILINEAR, LF_FISHEYE, LF_PANORAMIC, LF_EQUIRECTANGULAR,
+    LF_FISHEYE_ORTHOGRAPHIC, LF_FISHEYE_STEREOGRAPHIC, LF_FISHEYE_EQUISOLID,
+    LF_FISHEYE_THOBY
+  };
+  const char *type_names [] =
+  {
+    "rectilinear", "fisheye", "panoramic", "equirectangular", "orthographic",
+    "stereographic", "equisolid", "thoby"
+  };
+  for (size_t i = 0; i < ARRAY_LEN (types); i++)
+    for (size_t j = 0; j < ARRAY_LEN (types); j++)
+      if (i != j)
+      {
+        lfLens *lens = new_lens (types [i]);
+        lenses.push_back (lens);
+        add_case (cases, LF_BENCH_COORD, std::string ("geometry/") + type_names [i] +
+                  "-" + type_names [j], lens, LF_MODIFY_GEOMETRY, false, false);
+        cases.back ().targeom = types [j];
+      }
+
+  lfLens *lens = new_lens (LF_RECTILINEAR);
+  lenses.push_back (lens);
+  add_case (cases, LF_BENCH_COORD, "perspective/4-points", lens, 0, false, false);
+  cases.back ().perspective = true;
+}
+
+static lfModifier *create_modifier (const lfBenchCase &c, lfPixelFormat format,
+                                    int width, int height)
+{
+  lfModifier *mod = new lfModifier (c.lens, 1.0f, width, height);
+  int flags = mod->Initialize (c.lens, format, 24.0f, 2.8f, 1000.0f, c.scale,
+                               c.targeom, c.flags, c.reverse);
+  if ((flags & c.flags) != c.flags)
+  {
+    // Not supported in this direction
+    delete mod;
+    return NULL;
+  }
+  if (c.perspective)
+  {
+    // Two converging verticals, like in test_modifier_coord_perspective_correction
+    float x [] = { 0.335f * width, 0.709f * width, 0.339f * width, 0.711f * width };
+    float y [] = { 0.150f * height, 0.197f * height, 0.860f * height, 0.759f * height };
+    if (!mod->EnablePerspectiveCorrection (x, y, 4, 0))
+    {
+      delete mod;
+      return NULL;
+    }
+  }
+  return mod;
+}
+
+template<typename T>
+static void fill_image (void *image, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    ((T *)image) [i] = (T)0.5;
+}
+
+template<>
+void fill_image<unsigned char> (void *image, size_t count)
+{
+  memset (image, 0x7f, count);
+}
+
+static void fill_pixels (lfPixelFormat format, void *image, size_t count)
+{
+  switch (format)
+  {
+    case LF_PF_U8:  fill_image<unsigned char> (image, count); break;
+    case LF_PF_U16: fill_image<unsigned short> (image, count); break;
+    case LF_PF_U32: fill_image<unsigned int> (image, count); break;
+    case LF_PF_F32: fill_image<float> (image, count); break;
+    case LF_PF_F64: fill_image<double> (image, count); break;
+  }
+}
+
+/*
+   Runs the correction over the whole image until at least min_time seconds
+   have passed, after one warm-up pass.  Coordinates are written to a single
+   row buffer since the callbacks don't read them back; pixels are processed
+   in a full image, refilled before each pass outside of the timing, because
+   vignetting modifies them in place.
+*/
+static double time_passes (lfModifier *mod, const lfBenchCase &c,
+                           const lfBenchFormat *format, const lfBenchLayout *layout,
+                           int width, int height, double min_time, int &passes)
+{
+  size_t row_size;
+  if (c.group == LF_BENCH_COLOR)
+    row_size = (size_t)layout->cpp * width * format->size;
+  else
+    row_size = (c.group == LF_BENCH_COORD ? 2 : 6) * width * sizeof (float);
+  size_t size = c.group == LF_BENCH_COLOR ? row_size * height : row_size;
+  void *buffer = lf_alloc_align (16, size);
+
+  gint64 elapsed = 0;
+  passes = 0;
+  for (int pass = -1; pass < 1 || elapsed < min_time * 1e6; pass++)
+  {
+    if (c.group == LF_BENCH_COLOR)
+      fill_pixels (format->format, buffer, size / format->size);
+
+    gint64 start = g_get_monotonic_time ();
+    for (int y = 0; y < height; y++)
+      switch (c.group)
+      {
+        case LF_BENCH_COORD:
+          mod->ApplyGeometryDistortion (0.0f, y, width, 1, (float *)buffer);
+          break;
+        case LF_BENCH_SUBPIXEL:
+          mod->ApplySubpixelGeometryDistortion (0.0f, y, width, 1, (float *)buffer);
+          break;
+        case LF_BENCH_COLOR:
+          mod->ApplyColorModification ((char *)buffer + y * row_size, 0.0f, y, width, 1,
+                                       layout->comp_role, layout->cpp * width);
+          break;
+      }
+    if (pass >= 0)
+    {
+      elapsed += g_get_monotonic_time () - start;
+      passes++;
+    }
+  }
+
+  lf_free_align (buffer);
+  return elapsed * 1e3 / ((double)passes * width * height);
+}
+
+static void run_case (const lfBenchCase &c, const lfBenchOptions &options)
+{
+  if (options.filter && !strstr (c.name.c_str (), options.filter))
+    return;
+
+  // Only the vignetting callbacks depend on the pixel format
+  size_t n_formats = c.group == LF_BENCH_COLOR ? ARRAY_LEN (formats) : 1;
+  size_t n_layouts = c.group == LF_BENCH_COLOR ? ARRAY_LEN (layouts) : 1;
+  const lfBenchFormat f32 = { "", LF_PF_F32, sizeof (float) };
+  const lfBenchLayout none = { "", 0, 0 };
+
+  for (size_t s = 0; s < options.widths.size (); s++)
+    for (size_t i = 0; i < ARRAY_LEN (isas); i++)
+    {
+      // Levels the CPU does not have would only repeat a lower one
+      if ((_lf_detect_cpu_features () & isas [i].mask) != isas [i].mask)
+        continue;
+      for (size_t f = 0; f < n_formats; f++)
+        for (size_t l = 0; l < n_layouts; l++)
+          for (int tabulated = c.radial ? 1 : 0; tabulated >= 0; tabulated--)
+          {
+            const lfBenchFormat *format = c.group == LF_BENCH_COLOR ? &formats [f] : &f32;
+            const lfBenchLayout *layout = c.group == LF_BENCH_COLOR ? &layouts [l] : &none;
+            int width = options.widths [s], height = options.heights [s];
+            const char *mode = c.radial ? (tabulated ? "table" : "callbacks") : "callbacks";
+
+            // Callbacks are selected when they are added to the modifier
+            _lf_set_cpu_features_mask (isas [i].mask);
+            lfModifier *mod = create_modifier (c, format->format, width, height);
+            _lf_set_cpu_features_mask ((guint)-1);
+            if (!mod)
+            {
+              // Keep the gap visible: a row without timings
+              g_printerr ("%s/%s: cannot set up the modifier (%s%s%s%s%s, %dx%d), skipped\n",
+                          group_names [c.group], c.name.c_str (), isas [i].name,
+                          *format->name ? ", " : "", format->name,
+                          *layout->name ? ", " : "", layout->name, width, height);
+              fprintf (options.out, "%s,%s,%s,%s,%s,%s,%d,%d,0,,\n",
+                       group_names [c.group], c.name.c_str (), mode,
+                       isas [i].name, format->name, layout->name, width, height);
+              continue;
+            }
+            if (c.radial && !tabulated)
+            {
+              if (c.group == LF_BENCH_COORD)
+                mod->AddCoordCallback (identity_callback, 999, NULL, 0);
+              else
+                mod->AddSubpixelCallback (identity_callback, 999, NULL, 0);
+            }
+
+            int passes;
+            double ns = time_passes (mod, c, format, layout, width, height,
+                                     options.min_time, passes);
+            fprintf (options.out, "%s,%s,%s,%s,%s,%s,%d,%d,%d,%.3f,%.2f\n",
+                     group_names [c.group], c.name.c_str (), mode,
+                     isas [i].name, format->name, layout->name, width, height,
+                     passes, ns, 1e3 / ns);
+            fflush (options.out);
+            delete mod;
+          }
+    }
+}
+
+static void usage (const char *program)
+{
+  g_print ("Usage: %s [-s WIDTHxHEIGHT]... [-t SECONDS] [-f FILTER] [-o FILE] [-q]\n\n"
+           "  -s  Image size; may be given several times (default 640x480 and 1920x1080)\n"
+           "  -t  Minimal time per measurement in seconds (default 0.1)\n"
+           "  -f  Only run cases whose name contains FILTER, e.g. \"distortion/\"\n"
+           "  -o  Write the CSV results to FILE instead of standard output\n"
+           "  -q  Quick run: one small image and short measurements\n", program);
+}
+
+int main (int argc, char **argv)
+{
+  setlocale (LC_ALL, "C");
+
+  lfBenchOptions options;
+  options.min_time = 0.1;
+  options.filter = NULL;
+  options.out = stdout;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv [i];
+    const char *value = i + 1 < argc ? argv [i + 1] : NULL;
+    int width, height;
+    if (!strcmp (arg, "-q"))
+    {
+      options.widths.assign (1, 320);
+      options.heights.assign (1, 240);
+      options.min_time = 0.01;
+    }
+    else if (!strcmp (arg, "-s") && value && sscanf (value, "%dx%d", &width, &height) == 2 &&
+             width > 0 && height > 0)
+    {
+      options.widths.push_back (width);
+      options.heights.push_back (height);
+      i++;
+    }
+    else if (!strcmp (arg, "-t") && value)
+      options.min_time = atof (argv [++i]);
+    else if (!strcmp (arg, "-f") && value)
+      options.filter = argv [++i];
+    else if (!strcmp (arg, "-o") && value)
+    {
+      options.out = fopen (argv [++i], "w");
+      if (!options.out)
+      {
+        g_printerr ("Cannot open %s for writing\n", argv [i]);
+        return 1;
+      }
+    }
+    else
+    {
+      usage (argv [0]);
+      return 1;
+    }
+  }
+  if (options.widths.empty ())
+  {
+    options.widths.push_back (640);
+    options.heights.push_back (480);
+    options.widths.push_back (1920);
+    options.heights.push_back (1080);
+  }
+
+  std::vector<lfBenchCase> cases;
+  std::vector<lfLens *> lenses;
+  build_cases (cases, lenses);
+
+  fprintf (options.out, "group,name,mode,isa,format,layout,width,height,passes,ns_per_pixel,mpix_per_s\n");
+  for (size_t i = 0; i < ARRAY_LEN (isas); i++)
+    if ((_lf_detect_cpu_features () & isas [i].mask) != isas [i].mask)
+      g_printerr ("The CPU does not support %s, it is left out\n", isas [i].name);
+  for (size_t i = 0; i < cases.size (); i++)
+    run_case (cases [i], options);
+
+  for (size_t i = 0; i < lenses.size (); i++)
+    delete lenses [i];
+  if (options.out != stdout)
+    fclose (options.out);
+  return 0;
+}
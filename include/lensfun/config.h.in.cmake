@@ -41,7 +41,13 @@
 #cmakedefine VECTORIZATION_SSE
 #cmakedefine VECTORIZATION_SSE2
 
+#cmakedefine MODIFIER_STATS
+
+#cmakedefine EMBEDDED_DB
+
 #cmakedefine HAVE_ENDIAN_H
+#cmakedefine HAVE_ZLIB
+#cmakedefine HAVE_ZSTD
 
 #ifdef _MSC_VER
 #define _USE_MATH_DEFINES
@@ -0,0 +1,173 @@
+/*
+    Memory arena for the database objects
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+
+/// Size of the first block; every further block is twice as large
+#define ARENA_MIN_BLOCK 0x8000
+/// Blocks do not grow beyond this size, unless a single allocation needs it
+#define ARENA_MAX_BLOCK 0x40000
+/// Alignment of all allocations
+#define ARENA_ALIGN 16
+
+struct lfArenaBlock
+{
+    lfArenaBlock *Next;
+    size_t Size;
+};
+
+// The block header is padded so that the data is aligned as well
+#define ARENA_HEADER ((sizeof (lfArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+#define ARENA_MUTEX_INIT(lock) g_mutex_init (&(lock))
+#define ARENA_MUTEX_CLEAR(lock) g_mutex_clear (&(lock))
+#define ARENA_LOCK(lock) g_mutex_lock (&(lock))
+#define ARENA_UNLOCK(lock) g_mutex_unlock (&(lock))
+#else
+#define ARENA_MUTEX_INIT(lock) g_static_mutex_init (&(lock))
+#define ARENA_MUTEX_CLEAR(lock) g_static_mutex_free (&(lock))
+#define ARENA_LOCK(lock) g_static_mutex_lock (&(lock))
+#define ARENA_UNLOCK(lock) g_static_mutex_unlock (&(lock))
+#endif
+
+static guint _lf_mlstr_hash (gconstpointer key)
+{
+    const char *str = (const char *)key;
+    size_t size = _lf_mlstr_size ((lfMLstr)str);
+    // The djb hash, as g_str_hash, but over all translations
+    guint h = 5381;
+    for (size_t i = 0; i < size; i++)
+        h = (h << 5) + h + (guchar)str [i];
+    return h;
+}
+
+static gboolean _lf_mlstr_equal (gconstpointer a, gconstpointer b)
+{
+    size_t size = _lf_mlstr_size ((lfMLstr)a);
+    return size == _lf_mlstr_size ((lfMLstr)b) && !memcmp (a, b, size);
+}
+
+lfArena::lfArena ()
+{
+    Blocks = NULL;
+    Free = NULL;
+    Left = 0;
+    Strings = g_hash_table_new (g_str_hash, g_str_equal);
+    MLstrings = g_hash_table_new (_lf_mlstr_hash, _lf_mlstr_equal);
+    ARENA_MUTEX_INIT (Lock);
+    Tokens = _lf_tokens_new ();
+}
+
+lfArena::~lfArena ()
+{
+    _lf_tokens_free (Tokens);
+    g_hash_table_destroy (Strings);
+    g_hash_table_destroy (MLstrings);
+    while (Blocks)
+    {
+        lfArenaBlock *next = Blocks->Next;
+        g_free (Blocks);
+        Blocks = next;
+    }
+    ARENA_MUTEX_CLEAR (Lock);
+}
+
+// Same as Alloc(), for callers which already hold the lock
+void *lfArena::AllocLocked (size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > Left)
+    {
+        size_t block_size = Blocks ? Blocks->Size * 2 : ARENA_MIN_BLOCK;
+        if (block_size > ARENA_MAX_BLOCK)
+            block_size = ARENA_MAX_BLOCK;
+        if (block_size < size)
+            block_size = size;
+
+        lfArenaBlock *block = (lfArenaBlock *)g_malloc0 (ARENA_HEADER + block_size);
+        block->Next = Blocks;
+        block->Size = block_size;
+        Blocks = block;
+        Free = (char *)block + ARENA_HEADER;
+        Left = block_size;
+    }
+
+    void *ret = Free;
+    Free += size;
+    Left -= size;
+    return ret;
+}
+
+void *lfArena::Alloc (size_t size)
+{
+    ARENA_LOCK (Lock);
+    void *ret = AllocLocked (size);
+    ARENA_UNLOCK (Lock);
+    return ret;
+}
+
+const char *lfArena::Intern (const char *str)
+{
+    if (!str)
+        return NULL;
+
+    ARENA_LOCK (Lock);
+    const char *ret = (const char *)g_hash_table_lookup (Strings, str);
+    if (!ret)
+    {
+        size_t size = strlen (str) + 1;
+        char *copy = (char *)AllocLocked (size);
+        memcpy (copy, str, size);
+        g_hash_table_insert (Strings, copy, copy);
+        ret = copy;
+    }
+    ARENA_UNLOCK (Lock);
+    return ret;
+}
+
+lfMLstr lfArena::InternMLstr (const lfMLstr str)
+{
+    if (!str)
+        return NULL;
+
+    ARENA_LOCK (Lock);
+    lfMLstr ret = (lfMLstr)g_hash_table_lookup (MLstrings, str);
+    if (!ret)
+    {
+        size_t size = _lf_mlstr_size ((lfMLstr)str);
+        ret = (lfMLstr)AllocLocked (size);
+        memcpy (ret, str, size);
+        g_hash_table_insert (MLstrings, ret, ret);
+    }
+    ARENA_UNLOCK (Lock);
+    return ret;
+}
+
+bool lfArena::Owns (const void *ptr) const
+{
+    bool ret = false;
+    ARENA_LOCK (Lock);
+    for (const lfArenaBlock *block = Blocks; block; block = block->Next)
+        if ((const char *)ptr >= (const char *)block + ARENA_HEADER &&
+            (const char *)ptr < (const char *)block + ARENA_HEADER + block->Size)
+        {
+            ret = true;
+            break;
+        }
+    ARENA_UNLOCK (Lock);
+    return ret;
+}
+
+size_t lfArena::GetSize () const
+{
+    size_t size = 0;
+    ARENA_LOCK (Lock);
+    for (const lfArenaBlock *block = Blocks; block; block = block->Next)
+        size += ARENA_HEADER + block->Size;
+    ARENA_UNLOCK (Lock);
+    return size;
+}
@@ -8,28 +8,24 @@
 #include "lensfunprv.h"
 #include <locale.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <math.h>
 
-static const char *_lf_get_lang ()
+void _lf_get_lang (char *lang, size_t size)
 {
 #ifndef LC_MESSAGES
    /* Windows badly sucks, like always */
 #  define LC_MESSAGES LC_ALL
 #endif
 
-    static char lang [16];
-    static const char *last_locale = NULL;
     const char *lc_msg = setlocale (LC_MESSAGES, NULL);
 
-    if (!lc_msg)
-        return strcpy (lang, "en");
-
-    if (lc_msg == last_locale)
-        return lang;
-
-    const char *u = strchr (lc_msg, '_');
-    if (!u || (size_t (u - lc_msg) >= sizeof (lang)))
-        return strcpy (lang, "en");
+    const char *u = lc_msg ? strchr (lc_msg, '_') : NULL;
+    if (!u || (size_t (u - lc_msg) >= size))
+    {
+        strcpy (lang, "en");
+        return;
+    }
 
     memcpy (lang, lc_msg, u - lc_msg);
     lang [u - lc_msg] = 0;
@@ -44,8 +40,6 @@ static const char *_lf_get_lang ()
         lang [1] = tolower (lang [1]);
         lang [2] = 0;
     }
-
-    return lang;
 }
 
 LF_EXPORT void lf_free (void *data)
@@ -53,13 +47,11 @@ LF_EXPORT void lf_free (void *data)
     g_free (data);
 }
 
-LF_EXPORT const char *lf_mlstr_get (const lfMLstr str)
+const char *_lf_mlstr_get_lang (const lfMLstr str, const char *lang)
 {
     if (!str)
         return str;
 
-    /* Get the current locale for messages */
-    const char *lang = _lf_get_lang ();
     /* Default value if no language matches */
     const char *def = str;
     /* Find the corresponding string in the lot */
@@ -78,6 +70,19 @@ LF_EXPORT const char *lf_mlstr_get (const lfMLstr str)
     return def;
 }
 
+LF_EXPORT const char *lf_mlstr_get (const lfMLstr str)
+{
+    /* Most strings have no translations and need no look at the locale */
+    if (!str || !*(strchr (str, 0) + 1))
+        return str;
+
+    /* Get the current locale for messages; on the stack, since several
+       threads may call this at once */
+    char lang [16];
+    _lf_get_lang (lang, sizeof (lang));
+    return _lf_mlstr_get_lang (str, lang);
+}
+
 LF_EXPORT lfMLstr lf_mlstr_add (lfMLstr str, const char *lang, const char *trstr)
 {
     if (!trstr)
@@ -119,7 +124,7 @@ LF_EXPORT lfMLstr lf_mlstr_add (lfMLstr str, const char *lang, const char *trstr
     return str;
 }
 
-LF_EXPORT lfMLstr lf_mlstr_dup (const lfMLstr str)
+size_t _lf_mlstr_size (const lfMLstr str)
 {
     /* Find the length of multi-language string */
     size_t str_len = 0;
@@ -131,7 +136,12 @@ LF_EXPORT lfMLstr lf_mlstr_dup (const lfMLstr str)
         /* Reserve space for the last - closing - zero */
         str_len++;
     }
+    return str_len;
+}
 
+LF_EXPORT lfMLstr lf_mlstr_dup (const lfMLstr str)
+{
+    size_t str_len = _lf_mlstr_size (str);
     gchar *ret = (char *)g_malloc (str_len);
     memcpy (ret, str, str_len);
     return ret;
@@ -204,36 +214,113 @@ bool _lf_delobj (void ***var, int idx)
     return true;
 }
 
-void _lf_xml_printf (GString *output, const char *format, ...)
+/*
+  Lists of records are a single memory block: first room for cap pointers
+  and the terminating NULL, then room for cap records.  The capacity is not
+  stored, it follows from the length, so that the pointers stay the only
+  public part of the list.
+*/
+static int _lf_rec_capacity (int len)
 {
-    va_list args;
-    va_start (args, format);
-    gchar *s = g_markup_vprintf_escaped (format, args);
-    va_end (args);
+    int cap = 4;
+    while (cap < len)
+        cap *= 2;
+    return cap;
+}
 
-    g_string_append (output, s);
+static void _lf_rec_index (void **list, int len, int cap, size_t val_size)
+{
+    char *data = (char *)(list + cap + 1);
+    for (int i = 0; i < len; i++, data += val_size)
+        list [i] = data;
+    list [len] = NULL;
+}
 
-    g_free (s);
+void _lf_addrec (void ***var, const void *val, size_t val_size,
+                 bool (*cmpf) (const void *, const void *))
+{
+    int len = 0;
+    if (*var)
+        for (len = 0; (*var) [len]; len++)
+            if (cmpf && cmpf (val, (*var) [len]))
+            {
+                memcpy ((*var) [len], val, val_size);
+                return;
+            }
+
+    int cap = _lf_rec_capacity (len);
+    if (!*var || len == cap)
+    {
+        int new_cap = _lf_rec_capacity (len + 1);
+        *var = (void **)g_realloc (*var, (new_cap + 1) * sizeof (void *) +
+                                   new_cap * val_size);
+        if (len)
+            memmove (*var + new_cap + 1, *var + cap + 1, len * val_size);
+        cap = new_cap;
+    }
+
+    memcpy ((char *)(*var + cap + 1) + len * val_size, val, val_size);
+    _lf_rec_index (*var, len + 1, cap, val_size);
 }
 
-void _lf_xml_printf_mlstr (GString *output, const char *prefix,
-                           const char *element, const lfMLstr val)
+bool _lf_delrec (void ***var, int idx, size_t val_size)
 {
-    if (!val)
-        return;
+    if (!(*var))
+        return false;
+
+    int len;
+    for (len = 0; (*var) [len]; len++)
+        ;
+    if (idx < 0 || idx >= len)
+        return false;
 
-    _lf_xml_printf (output, "%s<%s>%s</%s>\n", prefix, element, val, element);
+    if (len == 1)
+    {
+        g_free (*var);
+        *var = NULL;
+        return true;
+    }
 
-    for (const char *cur = val;;)
+    int cap = _lf_rec_capacity (len);
+    char *data = (char *)(*var + cap + 1);
+    memmove (data + idx * val_size, data + (idx + 1) * val_size,
+             (len - idx - 1) * val_size);
+
+    // The capacity follows from the length, so the records have to move to
+    // where the shorter list expects them
+    int new_cap = _lf_rec_capacity (len - 1);
+    if (new_cap != cap)
     {
-        cur = strchr (cur, 0) + 1;
-        if (!*cur)
-            break;
-        const char *lang = cur;
-        cur = strchr (cur, 0) + 1;
-        _lf_xml_printf (output, "%s<%s lang=\"%s\">%s</%s>\n",
-                        prefix, element, lang, cur, element);
+        memmove (*var + new_cap + 1, data, (len - 1) * val_size);
+        *var = (void **)g_realloc (*var, (new_cap + 1) * sizeof (void *) +
+                                   new_cap * val_size);
+        cap = new_cap;
     }
+    _lf_rec_index (*var, len - 1, cap, val_size);
+    return true;
+}
+
+void **_lf_duprec (void *const *list, size_t val_size)
+{
+    if (!list)
+        return NULL;
+
+    int len;
+    bool contiguous = true;
+    for (len = 0; list [len]; len++)
+        if ((char *)list [len] != (char *)list [0] + len * val_size)
+            contiguous = false;
+
+    int cap = _lf_rec_capacity (len);
+    void **ret = (void **)g_malloc ((cap + 1) * sizeof (void *) + cap * val_size);
+    char *data = (char *)(ret + cap + 1);
+    if (contiguous)
+        memcpy (data, list [0], len * val_size);
+    else
+        for (int i = 0; i < len; i++)
+            memcpy (data + i * val_size, list [i], val_size);
+    _lf_rec_index (ret, len, cap, val_size);
+    return ret;
 }
 
 int _lf_ptr_array_insert_sorted (
@@ -274,13 +361,18 @@ done:
 }
 
 int _lf_ptr_array_insert_unique (
-    GPtrArray *array, void *item, GCompareFunc compare, GDestroyNotify dest)
+    GPtrArray *array, void *item, GCompareFunc compare, GFunc dest,
+    gpointer user_data)
 {
     int idx1, idx2;
     int idx = _lf_ptr_array_insert_sorted (array, item, compare);
     void **root = array->pdata;
     int length = array->len;
 
+    // Skip trailing NULL, if any
+    if (length && !root [length - 1])
+        length--;
+
     for (idx1 = idx - 1; idx1 >= 0 && compare (root [idx1], item) == 0; idx1--)
         ;
     for (idx2 = idx + 1; idx2 < length && compare (root [idx2], item) == 0; idx2++)
@@ -289,7 +381,7 @@ int _lf_ptr_array_insert_unique (
     if (dest)
         for (int i = idx1 + 1; i < idx2; i++)
             if (i != idx)
-                dest (g_ptr_array_index (array, i));
+                dest (g_ptr_array_index (array, i), user_data);
 
     if (idx2 - idx - 1)
         g_ptr_array_remove_range (array, idx + 1, idx2 - idx - 1);
@@ -299,6 +391,98 @@ int _lf_ptr_array_insert_unique (
     return idx1 + 1;
 }
 
+/* An appended item together with its position, so that equal items keep
+   their order */
+struct lfAppendedItem
+{
+    void *Item;
+    guint Order;
+};
+
+static gint _lf_appended_compare (gconstpointer a, gconstpointer b, gpointer compare)
+{
+    const lfAppendedItem *i1 = (const lfAppendedItem *)a;
+    const lfAppendedItem *i2 = (const lfAppendedItem *)b;
+    int cmp = ((GCompareFunc)compare) (i1->Item, i2->Item);
+    if (cmp)
+        return cmp;
+    return i1->Order < i2->Order ? -1 : i1->Order > i2->Order;
+}
+
+void _lf_ptr_array_sort_unique (
+    GPtrArray *array, GCompareFunc compare, GFunc dest, gpointer user_data)
+{
+    void **root = array->pdata;
+    guint length = array->len;
+
+    // Skip trailing NULL, if any
+    bool null = length && !root [length - 1];
+    if (null)
+        length--;
+
+    // The sorted part: items which were inserted before, and maybe some of
+    // the appended ones which happen to be in order.  It has no duplicates,
+    // and any item equal to one of them was appended later.
+    guint sorted = length ? 1 : 0;
+    while (sorted < length && compare (root [sorted - 1], root [sorted]) < 0)
+        sorted++;
+    if (sorted == length)
+        return;
+
+    guint count = length - sorted;
+    lfAppendedItem *appended = g_new (lfAppendedItem, count);
+    for (guint i = 0; i < count; i++)
+    {
+        appended [i].Item = root [sorted + i];
+        appended [i].Order = i;
+    }
+    g_qsort_with_data (appended, count, sizeof (lfAppendedItem),
+                       _lf_appended_compare, (gpointer)compare);
+
+    // Of equal appended items keep the last one
+    guint unique = 0;
+    for (guint i = 0; i < count; i++)
+        if (i + 1 < count && !compare (appended [i].Item, appended [i + 1].Item))
+        {
+            if (dest)
+                dest (appended [i].Item, user_data);
+        }
+        else
+            appended [unique++] = appended [i];
+
+    // Merge both parts; appended items replace equal sorted ones
+    void **merged = g_new (void *, sorted + unique);
+    guint i = 0, j = 0, n = 0;
+    while (i < sorted && j < unique)
+    {
+        int cmp = compare (root [i], appended [j].Item);
+        if (cmp < 0)
+            merged [n++] = root [i++];
+        else
+        {
+            if (!cmp)
+            {
+                if (dest)
+                    dest (root [i], user_data);
+                i++;
+            }
+            merged [n++] = appended [j++].Item;
+        }
+    }
+    while (i < sorted)
+        merged [n++] = root [i++];
+    while (j < unique)
+        merged [n++] = appended [j++].Item;
+
+    memcpy (root, merged, n * sizeof (void *));
+    g_ptr_array_set_size (array, n);
+    if (null)
+        g_ptr_array_add (array, NULL);
+
+    g_free (merged);
+    g_free (appended);
+}
+
 int _lf_ptr_array_find_sorted (
     const GPtrArray *array, void *item, GCompareFunc compare)
 {
@@ -462,33 +646,12 @@ float _lf_interpolate (float y1, float y2, float y3, float y4, float t)
 
 //------------------------// Fuzzy string matching //------------------------//
 
-lfFuzzyStrCmp::lfFuzzyStrCmp (const char *pattern, bool allwords)
-{
-    pattern_words = g_ptr_array_new ();
-    match_words = g_ptr_array_new ();
-    Split (pattern, pattern_words);
-    match_all_words = allwords;
-}
-
-lfFuzzyStrCmp::~lfFuzzyStrCmp ()
-{
-    Free (pattern_words);
-    g_ptr_array_free (pattern_words, TRUE);
-    g_ptr_array_free (match_words, TRUE);
-}
-
-void lfFuzzyStrCmp::Free (GPtrArray *dest)
-{
-    for (size_t i = 0; i < dest->len; i++)
-        g_free (g_ptr_array_index (dest, i));
-    g_ptr_array_set_size (dest, 0);
-}
-
-void lfFuzzyStrCmp::Split (const char *str, GPtrArray *dest)
+/*
+  Find the next word for fuzzy matching in str.  Returns the end of the word
+  and sets word to its start, or returns NULL if there are no words left.
+*/
+static const char *_lf_next_word (const char *str, const char *&word)
 {
-    if (!str)
-        return;
-
     while (*str)
     {
         while (*str && isspace (*str))
@@ -496,7 +659,7 @@ void lfFuzzyStrCmp::Split (const char *str, GPtrArray *dest)
         if (!*str)
             break;
 
-        const char *word = str++;
+        word = str++;
 
         // Split into words based on character class
         if (isdigit (*word))
@@ -516,11 +679,210 @@ void lfFuzzyStrCmp::Split (const char *str, GPtrArray *dest)
             && *word != '*' && *word != '+')
             continue;
 
+        return str;
+    }
+    return NULL;
+}
+
+/*
+  The words found in the names of one database, casefolded, mapped to their
+  token IDs.  The IDs start at 0 and are never reused, so token lists stay
+  valid as long as the database.
+*/
+struct lfTokenTable
+{
+    GHashTable *Words;
+    /* Scratch space of _lf_tokenize_mlstr */
+    GArray *Buffer;
+    lfArenaMutex Lock;
+};
+
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+#define TOKENS_MUTEX_INIT(table) g_mutex_init (&(table)->Lock)
+#define TOKENS_MUTEX_CLEAR(table) g_mutex_clear (&(table)->Lock)
+#define TOKENS_LOCK(table) g_mutex_lock (&(table)->Lock)
+#define TOKENS_UNLOCK(table) g_mutex_unlock (&(table)->Lock)
+#else
+#define TOKENS_MUTEX_INIT(table) g_static_mutex_init (&(table)->Lock)
+#define TOKENS_MUTEX_CLEAR(table) g_static_mutex_free (&(table)->Lock)
+#define TOKENS_LOCK(table) g_static_mutex_lock (&(table)->Lock)
+#define TOKENS_UNLOCK(table) g_static_mutex_unlock (&(table)->Lock)
+#endif
+
+lfTokenTable *_lf_tokens_new ()
+{
+    lfTokenTable *table = g_new (lfTokenTable, 1);
+    table->Words = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    table->Buffer = g_array_new (FALSE, FALSE, sizeof (int));
+    TOKENS_MUTEX_INIT (table);
+    return table;
+}
+
+void _lf_tokens_free (lfTokenTable *table)
+{
+    g_hash_table_destroy (table->Words);
+    g_array_free (table->Buffer, TRUE);
+    TOKENS_MUTEX_CLEAR (table);
+    g_free (table);
+}
+
+static int _lf_compare_int (const void *a, const void *b)
+{
+    int i1 = *(const int *)a, i2 = *(const int *)b;
+    return i1 < i2 ? -1 : i1 > i2 ? +1 : 0;
+}
+
+/*
+  Append the sorted token IDs of the words of str to tokens, preceded by
+  their number.  If intern is false, unknown words get the ID -1, which
+  matches nothing.
+*/
+static void _lf_tokenize (GHashTable *words, const char *str, bool intern,
+                          GArray *tokens)
+{
+    guint count_index = tokens->len;
+    int count = 0;
+    g_array_append_val (tokens, count);
+
+    const char *word;
+    const char *end = str;
+    while (end && (end = _lf_next_word (end, word)))
+    {
+        // Casefolding plain ASCII words, which is nearly all of them, only
+        // lowercases them, so do it on the stack for the lookup
+        char buff [64];
+        gchar *item = buff;
+        size_t len = end - word;
+        for (size_t i = 0; i < len && item; i++)
+            if (i == sizeof (buff) - 1 || (guchar)word [i] >= 0x80)
+                item = NULL;
+            else
+                buff [i] = g_ascii_tolower (word [i]);
+        if (item)
+            buff [len] = 0;
+        else
+            item = g_utf8_casefold (word, len);
+
+        gpointer key, value;
+        int id = -1;
+        if (g_hash_table_lookup_extended (words, item, &key, &value))
+            id = GPOINTER_TO_INT (value);
+        else if (intern)
+        {
+            id = g_hash_table_size (words);
+            g_hash_table_insert (words, item == buff ? g_strdup (buff) : item,
+                                 GINT_TO_POINTER (id));
+            item = buff;
+        }
+        if (item != buff)
+            g_free (item);
+        g_array_append_val (tokens, id);
+        count++;
+    }
+
+    g_array_index (tokens, int, count_index) = count;
+    qsort (&g_array_index (tokens, int, count_index + 1), count, sizeof (int),
+           _lf_compare_int);
+}
+
+int *_lf_tokenize_mlstr (lfTokenTable *table, const lfMLstr str, lfArena *arena)
+{
+    if (!str)
+        return NULL;
+
+    TOKENS_LOCK (table);
+    GArray *tokens = table->Buffer;
+    g_array_set_size (tokens, 0);
+
+    // The same walk over the translations as in lfFuzzyStrCmp::Compare
+    const char *mc = str;
+    while (*mc)
+    {
+        _lf_tokenize (table->Words, mc, true, tokens);
+        mc = strchr (mc, 0) + 1;
+        if (!*mc)
+            break;
+        mc = strchr (mc, 0) + 1;
+    }
+    int end = -1;
+    g_array_append_val (tokens, end);
+
+    size_t size = tokens->len * sizeof (int);
+    int *ret = (int *)(arena ? arena->Alloc (size) : g_malloc (size));
+    memcpy (ret, tokens->data, size);
+    TOKENS_UNLOCK (table);
+    return ret;
+}
+
+lfFuzzyStrCmp::lfFuzzyStrCmp (const char *pattern, bool allwords,
+                              lfTokenTable *tokens)
+{
+    pattern_words = g_ptr_array_new ();
+    match_words = g_ptr_array_new ();
+    Split (pattern, pattern_words);
+    match_all_words = allwords;
+
+    GArray *ids = g_array_new (FALSE, FALSE, sizeof (int));
+    TOKENS_LOCK (tokens);
+    _lf_tokenize (tokens->Words, pattern, false, ids);
+    TOKENS_UNLOCK (tokens);
+    pattern_ids = (int *)g_array_free (ids, FALSE);
+}
+
+lfFuzzyStrCmp::~lfFuzzyStrCmp ()
+{
+    Free (pattern_words);
+    g_ptr_array_free (pattern_words, TRUE);
+    g_ptr_array_free (match_words, TRUE);
+    g_free (pattern_ids);
+}
+
+void lfFuzzyStrCmp::Free (GPtrArray *dest)
+{
+    for (size_t i = 0; i < dest->len; i++)
+        g_free (g_ptr_array_index (dest, i));
+    g_ptr_array_set_size (dest, 0);
+}
+
+void lfFuzzyStrCmp::Split (const char *str, GPtrArray *dest)
+{
+    const char *word;
+    while (str && (str = _lf_next_word (str, word)))
+    {
         gchar *item = g_utf8_casefold (word, str - word);
         _lf_ptr_array_insert_sorted (dest, item, (GCompareFunc)strcmp);
     }
 }
 
+int lfFuzzyStrCmp::CompareTokens (const int *match_ids)
+{
+    const int pattern_count = pattern_ids [0];
+    const int match_count = match_ids [0];
+    if (!match_count || !pattern_count)
+        return 0;
+
+    // Both lists are sorted, so this is a merge as in Compare (const char *).
+    // Unknown pattern words are -1 and are never found.
+    const int *p = pattern_ids + 1, *p_end = p + pattern_count;
+    const int *m = match_ids + 1, *m_end = m + match_count;
+    int score = 0;
+    for (; p < p_end; p++)
+    {
+        while (m < m_end && *m < *p)
+            m++;
+        if (m < m_end && *m == *p)
+        {
+            score++;
+            m++;
+        }
+        else if (match_all_words)
+            // Found a word not present in match
+            return 0;
+    }
+
+    return (score * 200) / (pattern_count + match_count);
+}
+
 int lfFuzzyStrCmp::Compare (const char *match)
 {
     Split (match, match_words);
@@ -593,6 +955,25 @@ int lfFuzzyStrCmp::Compare (const char *match)
     return score;
 }
 
+int lfFuzzyStrCmp::Compare (const lfMLstr match, const int *tokens)
+{
+    if (!tokens)
+        return Compare (match);
+
+    int ret = 0;
+    for (; *tokens >= 0; tokens += *tokens + 1)
+    {
+        int res = CompareTokens (tokens);
+        if (res > ret)
+        {
+            ret = res;
+            if (ret >= 100)
+                break;
+        }
+    }
+    return ret;
+}
+
 int lfFuzzyStrCmp::Compare (const lfMLstr match)
 {
     if (!match)
@@ -22,6 +22,8 @@ lfCamera::~lfCamera ()
     lf_free (Model);
     lf_free (Variant);
     lf_free (Mount);
+    g_free (MakerTokens);
+    g_free (ModelTokens);
 }
 
 lfCamera::lfCamera (const lfCamera &other)
@@ -31,6 +33,7 @@ lfCamera::lfCamera (const lfCamera &other)
     Variant = lf_mlstr_dup (other.Variant);
     Mount = g_strdup (other.Mount);
     CropFactor = other.CropFactor;
+    MakerTokens = ModelTokens = NULL;
 }
 
 lfCamera &lfCamera::operator = (const lfCamera &other)
@@ -43,17 +46,24 @@ lfCamera &lfCamera::operator = (const lfCamera &other)
     Variant = lf_mlstr_dup (other.Variant);
     _lf_setstr (&Mount, other.Mount);
     CropFactor = other.CropFactor;
+    g_free (MakerTokens);
+    g_free (ModelTokens);
+    MakerTokens = ModelTokens = NULL;
     return *this;
 }
 
 void lfCamera::SetMaker (const char *val, const char *lang)
 {
     Maker = lf_mlstr_add (Maker, lang, val);
+    g_free (MakerTokens);
+    MakerTokens = NULL;
 }
 
 void lfCamera::SetModel (const char *val, const char *lang)
 {
     Model = lf_mlstr_add (Model, lang, val);
+    g_free (ModelTokens);
+    ModelTokens = NULL;
 }
 
 void lfCamera::SetVariant (const char *val, const char *lang)
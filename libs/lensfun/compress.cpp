@@ -0,0 +1,352 @@
+/*
+    Compressed database files
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <errno.h>
+#ifdef PLATFORM_WINDOWS
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif
+
+lfCompression _lf_compression_of_data (const char *data, size_t size)
+{
+    const guchar *magic = (const guchar *)data;
+    if (size >= 2 && magic [0] == 0x1f && magic [1] == 0x8b)
+        return LF_COMPRESSION_GZIP;
+    if (size >= 4 && magic [0] == 0x28 && magic [1] == 0xb5 &&
+        magic [2] == 0x2f && magic [3] == 0xfd)
+        return LF_COMPRESSION_ZSTD;
+    return LF_COMPRESSION_NONE;
+}
+
+lfCompression _lf_compression_of_name (const char *filename)
+{
+    if (g_str_has_suffix (filename, ".gz"))
+        return LF_COMPRESSION_GZIP;
+    if (g_str_has_suffix (filename, ".zst"))
+        return LF_COMPRESSION_ZSTD;
+    return LF_COMPRESSION_NONE;
+}
+
+bool _lf_compression_supported (lfCompression type)
+{
+    switch (type)
+    {
+        case LF_COMPRESSION_NONE:
+            return true;
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+            return true;
+#endif
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+int _lf_write_all (int fd, const char *data, size_t size)
+{
+    while (size)
+    {
+        gssize n = write (fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return n < 0 ? errno : ENOSPC;
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+//------------------------------// Decoding //------------------------------//
+
+lfDecoder::lfDecoder (lfCompression type, const char *data, size_t size)
+{
+    Type = type;
+    Stream = NULL;
+    In = data;
+    InSize = size;
+    Finished = false;
+
+    switch (type)
+    {
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+        {
+            z_stream *zs = g_new0 (z_stream, 1);
+            // Only accept the gzip format
+            if (inflateInit2 (zs, 15 + 16) == Z_OK)
+            {
+                zs->next_in = (Bytef *)data;
+                zs->avail_in = size;
+                Stream = zs;
+            }
+            else
+                g_free (zs);
+            break;
+        }
+#endif
+
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+            Stream = ZSTD_createDCtx ();
+            break;
+#endif
+
+        default:
+            break;
+    }
+}
+
+lfDecoder::~lfDecoder ()
+{
+    if (!Stream)
+        return;
+
+    switch (Type)
+    {
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+            inflateEnd ((z_stream *)Stream);
+            g_free (Stream);
+            break;
+#endif
+
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+            ZSTD_freeDCtx ((ZSTD_DCtx *)Stream);
+            break;
+#endif
+
+        default:
+            break;
+    }
+}
+
+gssize lfDecoder::Read (char *buf, size_t size, GError **error)
+{
+    if (!Stream)
+    {
+        g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                     _lf_compression_supported (Type) ?
+                     "Cannot initialize the decompression" :
+                     "The file is compressed in a format which is not supported");
+        return -1;
+    }
+    if (Finished || !size)
+        return 0;
+
+    switch (Type)
+    {
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+        {
+            z_stream *zs = (z_stream *)Stream;
+            zs->next_out = (Bytef *)buf;
+            zs->avail_out = size;
+            while (zs->avail_out)
+            {
+                int ret = inflate (zs, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END)
+                {
+                    // Files may consist of several gzip members
+                    if (!zs->avail_in)
+                    {
+                        Finished = true;
+                        break;
+                    }
+                    ret = inflateReset (zs);
+                }
+                if (ret == Z_BUF_ERROR && !zs->avail_in)
+                {
+                    g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                                 "The compressed data is truncated");
+                    return -1;
+                }
+                if (ret != Z_OK)
+                {
+                    g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                                 "Cannot decompress the data: %s",
+                                 zs->msg ? zs->msg : "unknown error");
+                    return -1;
+                }
+            }
+            return size - zs->avail_out;
+        }
+#endif
+
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+        {
+            ZSTD_inBuffer in = { In, InSize, 0 };
+            ZSTD_outBuffer out = { buf, size, 0 };
+            while (out.pos < out.size)
+            {
+                size_t ret = ZSTD_decompressStream ((ZSTD_DCtx *)Stream, &out, &in);
+                if (ZSTD_isError (ret))
+                {
+                    g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                                 "Cannot decompress the data: %s",
+                                 ZSTD_getErrorName (ret));
+                    return -1;
+                }
+                // With all input used and room left, everything is out
+                if (in.pos == in.size && out.pos < out.size)
+                {
+                    if (ret)
+                    {
+                        g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                                     "The compressed data is truncated");
+                        return -1;
+                    }
+                    Finished = true;
+                    break;
+                }
+            }
+            In += in.pos;
+            InSize -= in.pos;
+            return out.pos;
+        }
+#endif
+
+        default:
+            return -1;
+    }
+}
+
+//------------------------------// Encoding //------------------------------//
+
+lfEncoder::lfEncoder (lfCompression type, int fd)
+{
+    Type = type;
+    Fd = fd;
+    Stream = NULL;
+    Out = NULL;
+
+    switch (type)
+    {
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+        {
+            z_stream *zs = g_new0 (z_stream, 1);
+            if (deflateInit2 (zs, 9, Z_DEFLATED, 15 + 16, 8,
+                              Z_DEFAULT_STRATEGY) == Z_OK)
+                Stream = zs;
+            else
+                g_free (zs);
+            break;
+        }
+#endif
+
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+        {
+            ZSTD_CCtx *cctx = ZSTD_createCCtx ();
+            if (cctx)
+                ZSTD_CCtx_setParameter (cctx, ZSTD_c_compressionLevel, 19);
+            Stream = cctx;
+            break;
+        }
+#endif
+
+        default:
+            break;
+    }
+
+    if (Stream)
+        Out = (char *)g_malloc (LF_XML_WRITE_CHUNK);
+}
+
+lfEncoder::~lfEncoder ()
+{
+    g_free (Out);
+    if (!Stream)
+        return;
+
+    switch (Type)
+    {
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+            deflateEnd ((z_stream *)Stream);
+            g_free (Stream);
+            break;
+#endif
+
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+            ZSTD_freeCCtx ((ZSTD_CCtx *)Stream);
+            break;
+#endif
+
+        default:
+            break;
+    }
+}
+
+int lfEncoder::Write (const char *data, size_t size, bool finish)
+{
+    if (!Stream)
+        return _lf_compression_supported (Type) ? ENOMEM : ENOTSUP;
+
+    switch (Type)
+    {
+#ifdef HAVE_ZLIB
+        case LF_COMPRESSION_GZIP:
+        {
+            z_stream *zs = (z_stream *)Stream;
+            zs->next_in = (Bytef *)data;
+            zs->avail_in = size;
+            for (;;)
+            {
+                zs->next_out = (Bytef *)Out;
+                zs->avail_out = LF_XML_WRITE_CHUNK;
+                int ret = deflate (zs, finish ? Z_FINISH : Z_NO_FLUSH);
+                if (ret == Z_STREAM_ERROR)
+                    return EINVAL;
+                int e = _lf_write_all (Fd, Out, LF_XML_WRITE_CHUNK - zs->avail_out);
+                if (e)
+                    return e;
+                if (finish ? ret == Z_STREAM_END : zs->avail_out != 0)
+                    return 0;
+            }
+        }
+#endif
+
+#ifdef HAVE_ZSTD
+        case LF_COMPRESSION_ZSTD:
+        {
+            ZSTD_inBuffer in = { data, size, 0 };
+            for (;;)
+            {
+                ZSTD_outBuffer out = { Out, LF_XML_WRITE_CHUNK, 0 };
+                size_t ret = ZSTD_compressStream2 (
+                    (ZSTD_CCtx *)Stream, &out, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
+                if (ZSTD_isError (ret))
+                    return EINVAL;
+                int e = _lf_write_all (Fd, Out, out.pos);
+                if (e)
+                    return e;
+                if (finish ? ret == 0 : in.pos == in.size)
+                    return 0;
+            }
+        }
+#endif
+
+        default:
+            return ENOTSUP;
+    }
+}
@@ -7,6 +7,13 @@
 #include "lensfun.h"
 #include "lensfunprv.h"
 
+static guint cpuflags_mask = (guint)-1;
+
+void _lf_set_cpu_features_mask (guint mask)
+{
+    cpuflags_mask = mask;
+}
+
 #if defined (_MSC_VER)
 #include <intrin.h>
 guint _lf_detect_cpu_features ()
@@ -70,7 +77,7 @@ guint _lf_detect_cpu_features ()
     g_static_mutex_unlock (&lock);
 #endif
 
-    return cpuflags;
+    return cpuflags & cpuflags_mask;
 };
 #else
 #if defined (__i386__) || defined (__x86_64__)
@@ -185,7 +192,7 @@ guint _lf_detect_cpu_features ()
     g_static_mutex_unlock (&lock);
 #endif
 
-    return cpuflags;
+    return cpuflags & cpuflags_mask;
 
 #undef cpuid
 }
@@ -9,7 +9,6 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdlib.h>
-#include <locale.h>
 #include <glib/gstdio.h>
 #include <math.h>
 #include <fstream>
@@ -21,6 +20,11 @@
 #  include <unistd.h>
 #endif
 
+/* Database files are written and read again as they are, also on Windows */
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
 const char* const lfDatabase::UserLocation = g_build_filename (g_get_user_data_dir (),
                                 CONF_PACKAGE, NULL);
 const char* const lfDatabase::UserUpdatesLocation = g_build_filename (lfDatabase::UserLocation, "updates",
@@ -30,6 +34,24 @@ const char* const lfDatabase::SystemLocation = g_build_filename (SYSTEM_DB_PATH,
 const char* const lfDatabase::SystemUpdatesLocation = g_build_filename (SYSTEM_DB_UPDATE_PATH,
                                           DATABASE_SUBDIR, NULL);
 
+/* The display names for lfDatabase::MLstrGet */
+struct lfNameTable
+{
+    /* The language of the names */
+    char Lang [16];
+    /* Maps the translated strings of the arena to the text for Lang */
+    GHashTable *Names;
+};
+
+static void _lf_names_add (lfNameTable *table, lfArena *arena, const lfMLstr str)
+{
+    // Strings without translations resolve to themselves anyway, and only
+    // strings of the arena live as long as the table
+    if (str && *(strchr (str, 0) + 1) && arena->Owns (str))
+        g_hash_table_insert (table->Names, (gpointer)str,
+                             (gpointer)_lf_mlstr_get_lang (str, table->Lang));
+}
+
 lfDatabase::lfDatabase ()
 {
 
@@ -44,22 +66,192 @@ lfDatabase::lfDatabase ()
     g_ptr_array_add ((GPtrArray *)Cameras, NULL);
     Lenses = g_ptr_array_new ();
     g_ptr_array_add ((GPtrArray *)Lenses, NULL);
+
+    Arena = new lfArena ();
+    LoadFlags = 0;
+    Filter = NULL;
+    lfNameTable *names = g_new (lfNameTable, 1);
+    _lf_get_lang (names->Lang, sizeof (names->Lang));
+    names->Names = g_hash_table_new (g_direct_hash, g_direct_equal);
+    Names = names;
+}
+
+/* The passes of LoadData: everything, or with a filter first all but
+   lenses and then the lenses */
+enum
+{
+    LF_PASS_ALL,
+    LF_PASS_NO_LENSES,
+    LF_PASS_LENSES
+};
+
+/* The filter set by lfDatabase::SetLoadFilter */
+struct lfLoadFilter
+{
+    gchar **Makers;
+    gchar **Mounts;
+    /* Mounts of lenses to load, not owned; set before lenses are parsed */
+    GPtrArray *Wanted;
+};
+
+static void _lf_filter_free (lfLoadFilter *filter)
+{
+    if (!filter)
+        return;
+    _lf_list_free ((void **)filter->Makers);
+    _lf_list_free ((void **)filter->Mounts);
+    g_ptr_array_free (filter->Wanted, TRUE);
+    g_free (filter);
+}
+
+static bool _lf_filter_has (gchar *const *list, const char *name)
+{
+    if (list && name)
+        for (int i = 0; list [i]; i++)
+            if (!_lf_strcmp (list [i], name))
+                return true;
+    return false;
+}
+
+static bool _lf_filter_has_maker (const lfLoadFilter *filter, const lfMLstr maker)
+{
+    if (filter->Makers && maker)
+        for (int i = 0; filter->Makers [i]; i++)
+            if (!_lf_mlstrcmp (filter->Makers [i], maker))
+                return true;
+    return false;
+}
+
+static bool _lf_filter_camera (const lfLoadFilter *filter, const lfCamera *camera)
+{
+    return _lf_filter_has_maker (filter, camera->Maker) ||
+        _lf_filter_has (filter->Mounts, camera->Mount);
+}
+
+static bool _lf_filter_lens (const lfLoadFilter *filter, const lfLens *lens)
+{
+    if (_lf_filter_has_maker (filter, lens->Maker))
+        return true;
+    if (lens->Mounts)
+        for (int i = 0; lens->Mounts [i]; i++)
+            for (guint j = 0; j < filter->Wanted->len; j++)
+                if (!_lf_strcmp (lens->Mounts [i],
+                                 (const char *)g_ptr_array_index (filter->Wanted, j)))
+                    return true;
+    return false;
+}
+
+static void _lf_filter_add_wanted (lfLoadFilter *filter, const char *mount)
+{
+    for (guint i = 0; i < filter->Wanted->len; i++)
+        if (!_lf_strcmp (mount, (const char *)g_ptr_array_index (filter->Wanted, i)))
+            return;
+    g_ptr_array_add (filter->Wanted, (gpointer)mount);
+}
+
+/* Find the mounts of the lenses to load, once all mounts and cameras are
+   known */
+static void _lf_filter_update (lfLoadFilter *filter, const lfDatabase *db)
+{
+    g_ptr_array_set_size (filter->Wanted, 0);
+    if (filter->Mounts)
+        for (int i = 0; filter->Mounts [i]; i++)
+            _lf_filter_add_wanted (filter, filter->Mounts [i]);
+    for (const lfCamera *const *camera = db->GetCameras (); *camera; camera++)
+        if ((*camera)->Mount)
+            _lf_filter_add_wanted (filter, (*camera)->Mount);
+
+    // Lenses for compatible mounts fit as well, see FindLenses
+    for (guint i = 0, n = filter->Wanted->len; i < n; i++)
+    {
+        const lfMount *mount = db->FindMount (
+            (const char *)g_ptr_array_index (filter->Wanted, i));
+        if (mount && mount->Compat)
+            for (int j = 0; mount->Compat [j]; j++)
+                _lf_filter_add_wanted (filter, mount->Compat [j]);
+    }
+}
+
+/* Check the <maker> and <mount> elements of a lens before it is parsed.
+   This is never false for a lens _lf_filter_lens accepts. */
+static bool _lf_filter_lens_text (
+    const lfLoadFilter *filter, const char *pos, const char *end)
+{
+    char text [256];
+    while ((pos = (const char *)memchr (pos, '<', end - pos)))
+    {
+        pos++;
+        bool mount = end - pos > 6 && !memcmp (pos, "mount>", 6);
+        if (!mount && !(end - pos > 6 && !memcmp (pos, "maker", 5) &&
+                        (pos [5] == '>' || isspace (pos [5]))))
+            continue;
+
+        const char *start = (const char *)memchr (pos, '>', end - pos);
+        const char *stop = start ? (const char *)memchr (start, '<', end - start) : NULL;
+        if (!stop)
+            break;
+        start++;
+        // Entities are not decoded here, so let the parser decide
+        if ((size_t)(stop - start) >= sizeof (text) || memchr (start, '&', stop - start))
+            return true;
+        memcpy (text, start, stop - start);
+        text [stop - start] = 0;
+
+        if (mount)
+        {
+            for (guint i = 0; i < filter->Wanted->len; i++)
+                if (!_lf_strcmp (text, (const char *)g_ptr_array_index (filter->Wanted, i)))
+                    return true;
+        }
+        else if (_lf_filter_has (filter->Makers, text))
+            return true;
+        pos = stop;
+    }
+    return false;
+}
+
+/* Objects loaded from files live in the arena and go away with it; only
+   objects added by the application are deleted one by one. */
+static void _lf_db_destroy_mount (gpointer mount, gpointer arena)
+{
+    if (!((lfArena *)arena)->Owns (mount))
+        delete static_cast<lfMount *> (mount);
+}
+
+static void _lf_db_destroy_camera (gpointer camera, gpointer arena)
+{
+    if (!((lfArena *)arena)->Owns (camera))
+        delete static_cast<lfCamera *> (camera);
+}
+
+static void _lf_db_destroy_lens (gpointer lens, gpointer arena)
+{
+    if (!((lfArena *)arena)->Owns (lens))
+        delete static_cast<lfLens *> (lens);
 }
 
 lfDatabase::~lfDatabase ()
 {
     size_t i;
     for (i = 0; i < ((GPtrArray *)Mounts)->len - 1; i++)
-         delete static_cast<lfMount *> (g_ptr_array_index ((GPtrArray *)Mounts, i));
+        _lf_db_destroy_mount (g_ptr_array_index ((GPtrArray *)Mounts, i), Arena);
     g_ptr_array_free ((GPtrArray *)Mounts, TRUE);
 
     for (i = 0; i < ((GPtrArray *)Cameras)->len - 1; i++)
-         delete static_cast<lfCamera *> (g_ptr_array_index ((GPtrArray *)Cameras, i));
+        _lf_db_destroy_camera (g_ptr_array_index ((GPtrArray *)Cameras, i), Arena);
     g_ptr_array_free ((GPtrArray *)Cameras, TRUE);
 
     for (i = 0; i < ((GPtrArray *)Lenses)->len - 1; i++)
-         delete static_cast<lfLens *> (g_ptr_array_index ((GPtrArray *)Lenses, i));
+        _lf_db_destroy_lens (g_ptr_array_index ((GPtrArray *)Lenses, i), Arena);
     g_ptr_array_free ((GPtrArray *)Lenses, TRUE);
+
+    delete (lfArena *)Arena;
+    _lf_filter_free ((lfLoadFilter *)Filter);
+    g_hash_table_destroy (((lfNameTable *)Names)->Names);
+    g_free (Names);
+
+    free (HomeDataDir);
+    free (UserUpdatesDir);
 }
 
 lfDatabase *lfDatabase::Create ()
@@ -99,39 +291,101 @@ bool lfDatabase::LoadDirectory (const gchar *dirname)
     return Load(dirname) == LF_NO_ERROR;
 }
 
-lfError lfDatabase::Load ()
+const char *_lf_db_main_location (const char *user_updates)
 {
-  lfError err = LF_NO_ERROR;
-
-    bool database_found = false;
-
     const int timestamp_system =
-        ReadTimestamp (SystemLocation);
+        lfDatabase::ReadTimestamp (lfDatabase::SystemLocation);
     const int timestamp_system_updates =
-        ReadTimestamp (SystemUpdatesLocation);
+        lfDatabase::ReadTimestamp (lfDatabase::SystemUpdatesLocation);
     const int timestamp_user_updates =
-        ReadTimestamp (UserUpdatesDir);
+        lfDatabase::ReadTimestamp (user_updates);
     if (timestamp_system > timestamp_system_updates)
         if (timestamp_user_updates > timestamp_system)
-            err = Load (UserUpdatesDir);
+            return user_updates;
         else
-            err = Load (SystemLocation);
+            return lfDatabase::SystemLocation;
     else
         if (timestamp_user_updates > timestamp_system_updates)
-            err = Load (UserUpdatesDir);
+            return user_updates;
         else
-            err = Load (SystemUpdatesLocation);
+            return lfDatabase::SystemUpdatesLocation;
+}
+
+lfError lfDatabase::Load ()
+{
+    const char *main = _lf_db_main_location (UserUpdatesDir);
+    lfError err;
+
+#ifdef EMBEDDED_DB
+    // The compiled-in database takes the place of the installed one,
+    // unless newer updates have been downloaded
+    if (ReadTimestamp (main) <= _lf_embedded_db_timestamp)
+        err = LoadEmbedded ();
+    else
+#endif
+    err = LoadPath (main);
+
+    LoadPath (HomeDataDir);
 
-    Load (HomeDataDir);
+    SortObjects ();
 
     return err == LF_NO_ERROR ? LF_NO_ERROR : LF_NO_DATABASE;
 }
 
 lfError lfDatabase::Load (const char *pathname)
+{
+    if (pathname == NULL)
+        return Load ();
+
+    lfError e = LoadPath (pathname);
+    SortObjects ();
+    return e;
+}
+
+void lfDatabase::SortObjects ()
+{
+    _lf_ptr_array_sort_unique (
+        (GPtrArray *)Mounts, _lf_mount_compare, _lf_db_destroy_mount, Arena);
+    _lf_ptr_array_sort_unique (
+        (GPtrArray *)Cameras, _lf_camera_compare, _lf_db_destroy_camera, Arena);
+    _lf_ptr_array_sort_unique (
+        (GPtrArray *)Lenses, _lf_lens_compare, _lf_db_destroy_lens, Arena);
+    UpdateNames ();
+}
+
+void lfDatabase::UpdateNames ()
+{
+    lfNameTable *table = (lfNameTable *)Names;
+    lfArena *arena = (lfArena *)Arena;
+    g_hash_table_remove_all (table->Names);
+
+    for (const lfMount *const *mount = GetMounts (); *mount; mount++)
+        _lf_names_add (table, arena, (*mount)->Name);
+    for (const lfCamera *const *camera = GetCameras (); *camera; camera++)
+    {
+        _lf_names_add (table, arena, (*camera)->Maker);
+        _lf_names_add (table, arena, (*camera)->Model);
+        _lf_names_add (table, arena, (*camera)->Variant);
+    }
+    for (const lfLens *const *lens = GetLenses (); *lens; lens++)
+    {
+        _lf_names_add (table, arena, (*lens)->Maker);
+        _lf_names_add (table, arena, (*lens)->Model);
+    }
+}
+
+/* Database files are XML, possibly compressed */
+static bool _lf_is_database_file (const char *fn)
+{
+    return g_str_has_suffix (fn, ".xml") || g_str_has_suffix (fn, ".xml.gz") ||
+        g_str_has_suffix (fn, ".xml.zst");
+}
+
+lfError lfDatabase::LoadPath (const char *pathname)
 {
 
-  if (pathname == NULL)
-    return Load();
+  if (Filter)
+    return LoadFiltered (pathname);
 
   lfError e;
 
@@ -142,23 +396,17 @@ lfError lfDatabase::Load (const char *pathname)
     GDir *dir = g_dir_open (pathname, 0, NULL);
     if (dir)
     {
-        GPatternSpec *ps = g_pattern_spec_new ("*.xml");
-        if (ps)
+        const gchar *fn;
+        while ((fn = g_dir_read_name (dir)))
         {
-            const gchar *fn;
-            while ((fn = g_dir_read_name (dir)))
+            if (_lf_is_database_file (fn))
             {
-                size_t sl = strlen (fn);
-                if (g_pattern_match (ps, sl, fn, NULL))
-                {
-                    gchar *ffn = g_build_filename (pathname, fn, NULL);
-                    /* Ignore errors */
-                    if (Load (ffn) == LF_NO_ERROR)
-                        database_found = true;
-                    g_free (ffn);
-                }
+                gchar *ffn = g_build_filename (pathname, fn, NULL);
+                /* Ignore errors */
+                if (LoadPath (ffn) == LF_NO_ERROR)
+                    database_found = true;
+                g_free (ffn);
             }
-            g_pattern_spec_free (ps);
         }
         g_dir_close (dir);
     }
@@ -166,28 +414,183 @@ lfError lfDatabase::Load (const char *pathname)
 
   } else {
 
-    // if filename is not a folder, load the file directly
-    gchar *contents;
-    gsize length;
+    // if filename is not a folder, load the file directly; the parser
+    // works in place on a private copy-on-write mapping of the file
     GError *err = NULL;
-    if (!g_file_get_contents (pathname, &contents, &length, &err))
-        return lfError (err->code == G_FILE_ERROR_ACCES ? -EACCES : -ENOENT);
+    GMappedFile *file = g_mapped_file_new (pathname, TRUE, &err);
+    if (!file)
+    {
+        e = lfError (err->code == G_FILE_ERROR_ACCES ? -EACCES : -ENOENT);
+        g_error_free (err);
+        return e;
+    }
 
-    e = Load (pathname, contents, length);
+    e = LoadData (pathname, g_mapped_file_get_contents (file),
+                  g_mapped_file_get_length (file), true, LF_PASS_ALL, NULL);
 
-    g_free (contents);
+    g_mapped_file_unref (file);
 
   }
 
   return e;
 }
 
+void _lf_list_database_files (GPtrArray *files, const char *pathname)
+{
+    if (!g_file_test (pathname, G_FILE_TEST_IS_DIR))
+    {
+        if (g_file_test (pathname, G_FILE_TEST_IS_REGULAR))
+            g_ptr_array_add (files, g_strdup (pathname));
+        return;
+    }
+
+    GDir *dir = g_dir_open (pathname, 0, NULL);
+    if (!dir)
+        return;
+    const gchar *fn;
+    while ((fn = g_dir_read_name (dir)))
+        if (_lf_is_database_file (fn))
+            g_ptr_array_add (files, g_build_filename (pathname, fn, NULL));
+    g_dir_close (dir);
+}
+
+lfError lfDatabase::LoadFiltered (const char *pathname)
+{
+    // Mounts and cameras of all files must be known before it is clear
+    // which lenses are needed, so keep the files in memory between the
+    // two passes
+    bool is_dir = g_file_test (pathname, G_FILE_TEST_IS_DIR);
+    GPtrArray *files = g_ptr_array_new ();
+    if (is_dir)
+        _lf_list_database_files (files, pathname);
+    else
+        g_ptr_array_add (files, g_strdup (pathname));
+
+    lfError e = is_dir ? LF_NO_DATABASE : LF_NO_ERROR;
+    GMappedFile **contents = g_new0 (GMappedFile *, files->len);
+    GArray **lenses = g_new0 (GArray *, files->len);
+    for (guint i = 0; i < files->len; i++)
+    {
+        const char *fn = (const char *)g_ptr_array_index (files, i);
+        GError *err = NULL;
+        contents [i] = g_mapped_file_new (fn, TRUE, &err);
+        if (!contents [i])
+        {
+            if (!is_dir)
+                e = lfError (err->code == G_FILE_ERROR_ACCES ? -EACCES : -ENOENT);
+            g_error_free (err);
+            continue;
+        }
+
+        lenses [i] = g_array_new (FALSE, FALSE, sizeof (gsize));
+        lfError file_e = LoadData (fn, g_mapped_file_get_contents (contents [i]),
+                                   g_mapped_file_get_length (contents [i]),
+                                   true, LF_PASS_NO_LENSES, lenses [i]);
+        if (file_e != LF_NO_ERROR)
+        {
+            /* Ignore errors in directories */
+            if (!is_dir)
+                e = file_e;
+            g_mapped_file_unref (contents [i]);
+            contents [i] = NULL;
+        }
+        else if (is_dir)
+            e = LF_NO_ERROR;
+    }
+
+    SortObjects ();
+    _lf_filter_update ((lfLoadFilter *)Filter, this);
+    for (guint i = 0; i < files->len; i++)
+    {
+        if (contents [i])
+        {
+            LoadData ((const char *)g_ptr_array_index (files, i),
+                      g_mapped_file_get_contents (contents [i]),
+                      g_mapped_file_get_length (contents [i]),
+                      true, LF_PASS_LENSES, lenses [i]);
+            g_mapped_file_unref (contents [i]);
+        }
+        if (lenses [i])
+            g_array_free (lenses [i], TRUE);
+        g_free (g_ptr_array_index (files, i));
+    }
+    g_free (contents);
+    g_free (lenses);
+    g_ptr_array_free (files, TRUE);
+
+    return e;
+}
+
+#ifdef EMBEDDED_DB
+lfError lfDatabase::LoadEmbedded ()
+{
+    // Like a directory in LoadFiltered(), but objects are only sorted
+    // once at the end if there is no filter
+    int count = 0;
+    while (_lf_embedded_db [count].Name)
+        count++;
+
+    lfError e = LF_NO_DATABASE;
+    char **contents = g_new0 (char *, count);
+    GArray **lenses = g_new0 (GArray *, count);
+    for (int i = 0; i < count; i++)
+    {
+        const lfEmbeddedFile *file = &_lf_embedded_db [i];
+        // The parser changes the data while reading it
+        contents [i] = (char *)g_malloc (file->Size);
+        memcpy (contents [i], file->Data, file->Size);
+
+        if (Filter)
+            lenses [i] = g_array_new (FALSE, FALSE, sizeof (gsize));
+        // Lazy calibrations point into the embedded data instead of
+        // keeping a copy
+        lfError file_e = LoadData (file->Name, contents [i], file->Size, false,
+                                   Filter ? LF_PASS_NO_LENSES : LF_PASS_ALL,
+                                   lenses [i], (const char *)file->Data);
+        if (file_e == LF_NO_ERROR)
+            e = LF_NO_ERROR;
+        if (file_e != LF_NO_ERROR || !Filter)
+        {
+            g_free (contents [i]);
+            contents [i] = NULL;
+        }
+    }
+
+    if (Filter)
+    {
+        SortObjects ();
+        _lf_filter_update ((lfLoadFilter *)Filter, this);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (contents [i])
+        {
+            LoadData (_lf_embedded_db [i].Name, contents [i],
+                      _lf_embedded_db [i].Size, false, LF_PASS_LENSES, lenses [i],
+                      (const char *)_lf_embedded_db [i].Data);
+            g_free (contents [i]);
+        }
+        if (lenses [i])
+            g_array_free (lenses [i], TRUE);
+    }
+    g_free (contents);
+    g_free (lenses);
+
+    return e;
+}
+#endif
+
 //-----------------------------// XML parser //-----------------------------//
 
 /* Private structure used by XML parse */
 typedef struct
 {
-    lfDatabase *db;
+    /* The arrays of the database; new objects are appended and sorted in
+       at the end of lfDatabase::Load */
+    GPtrArray *mounts;
+    GPtrArray *cameras;
+    GPtrArray *lenses;
+    lfArena *arena;
     lfMount *mount;
     lfCamera *camera;
     lfLens *lens;
@@ -195,6 +598,17 @@ typedef struct
     const gchar *stack [16];
     size_t stack_depth;
     const char *errcontext;
+    /* errcontext for lfLazyCalibrations, as an absolute file name if it is one */
+    const char *path;
+    /* The data being parsed and whether it is the contents of errcontext */
+    const char *data;
+    bool from_file;
+    /* An unchanged copy of data which stays valid as long as the process,
+       or NULL */
+    const char *persistent;
+    lfLoadFilter *filter;
+    /* Whether any element was found */
+    bool started;
 } lfParserData;
 
 static bool __chk_no_attrs(const gchar *element_name, const gchar **attribute_names,
@@ -209,7 +623,7 @@ static bool __chk_no_attrs(const gchar *element_name, const gchar **attribute_na
     return true;
 }
 
-static void _xml_start_element (GMarkupParseContext *context,
+static void _xml_start_element (lfXmlReader         *reader,
                                 const gchar         *element_name,
                                 const gchar        **attribute_names,
                                 const gchar        **attribute_values,
@@ -304,11 +718,11 @@ static void _xml_start_element (GMarkupParseContext *context,
 
         for (i = 0; attribute_names [i]; i++)
             if (!strcmp (attribute_names [i], "min"))
-                pd->lens->MinFocal = atof (attribute_values [i]);
+                pd->lens->MinFocal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "max"))
-                pd->lens->MaxFocal = atof (attribute_values [i]);
+                pd->lens->MaxFocal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "value"))
-                pd->lens->MinFocal = pd->lens->MaxFocal = atof (attribute_values [i]);
+                pd->lens->MinFocal = pd->lens->MaxFocal = g_ascii_strtod (attribute_values [i], NULL);
             else
                 goto bad_attr;
     }
@@ -319,11 +733,11 @@ static void _xml_start_element (GMarkupParseContext *context,
 
         for (i = 0; attribute_names [i]; i++)
             if (!strcmp (attribute_names [i], "min"))
-                pd->lens->MinAperture = atof (attribute_values [i]);
+                pd->lens->MinAperture = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "max"))
-                pd->lens->MaxAperture = atof (attribute_values [i]);
+                pd->lens->MaxAperture = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "value"))
-                pd->lens->MinAperture = pd->lens->MaxAperture = atof (attribute_values [i]);
+                pd->lens->MinAperture = pd->lens->MaxAperture = g_ascii_strtod (attribute_values [i], NULL);
             else
                 goto bad_attr;
     }
@@ -334,9 +748,9 @@ static void _xml_start_element (GMarkupParseContext *context,
 
         for (i = 0; attribute_names [i]; i++)
             if (!strcmp (attribute_names [i], "x"))
-                pd->lens->CenterX = atof (attribute_values [i]);
+                pd->lens->CenterX = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "y"))
-                pd->lens->CenterY = atof (attribute_values [i]);
+                pd->lens->CenterY = g_ascii_strtod (attribute_values [i], NULL);
             else
                 goto bad_attr;
     }
@@ -382,22 +796,22 @@ static void _xml_start_element (GMarkupParseContext *context,
                 }
             }
             else if (!strcmp (attribute_names [i], "focal"))
-                dc.Focal = atof (attribute_values [i]);
+                dc.Focal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "real-focal"))
-                dc.RealFocal = atof (attribute_values [i]);
+                dc.RealFocal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "a") ||
                      !strcmp (attribute_names [i], "k1"))
-                dc.Terms [0] = atof (attribute_values [i]);
+                dc.Terms [0] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "b") ||
                      !strcmp (attribute_names [i], "k2"))
-                dc.Terms [1] = atof (attribute_values [i]);
+                dc.Terms [1] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "c") ||
                      !strcmp (attribute_names [i], "k3"))
-                dc.Terms [2] = atof (attribute_values [i]);
+                dc.Terms [2] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "k4"))
-                dc.Terms [3] = atof (attribute_values [i]);
+                dc.Terms [3] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "k5"))
-                dc.Terms [4] = atof (attribute_values [i]);
+                dc.Terms [4] = g_ascii_strtod (attribute_values [i], NULL);
             else
             {
             unk_attr:
@@ -440,39 +854,39 @@ static void _xml_start_element (GMarkupParseContext *context,
                     goto bad_attr;
             }
             else if (!strcmp (attribute_names [i], "focal"))
-                tcac.Focal = atof (attribute_values [i]);
+                tcac.Focal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "kr") ||
                      !strcmp (attribute_names [i], "vr") ||
                      !strcmp (attribute_names [i], "alpha0"))
-                tcac.Terms [0] = atof (attribute_values [i]);
+                tcac.Terms [0] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "kb") ||
                      !strcmp (attribute_names [i], "vb") ||
                      !strcmp (attribute_names [i], "beta0"))
-                tcac.Terms [1] = atof (attribute_values [i]);
+                tcac.Terms [1] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "cr") ||
                      !strcmp (attribute_names [i], "alpha1"))
-                tcac.Terms [2] = atof (attribute_values [i]);
+                tcac.Terms [2] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "cb") ||
                      !strcmp (attribute_names [i], "beta1"))
-                tcac.Terms [3] = atof (attribute_values [i]);
+                tcac.Terms [3] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "br") ||
                      !strcmp (attribute_names [i], "alpha2"))
-                tcac.Terms [4] = atof (attribute_values [i]);
+                tcac.Terms [4] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "bb") ||
                      !strcmp (attribute_names [i], "beta2"))
-                tcac.Terms [5] = atof (attribute_values [i]);
+                tcac.Terms [5] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "alpha3"))
-                tcac.Terms [6] = atof (attribute_values [i]);
+                tcac.Terms [6] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "beta3"))
-                tcac.Terms [7] = atof (attribute_values [i]);
+                tcac.Terms [7] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "alpha4"))
-                tcac.Terms [8] = atof (attribute_values [i]);
+                tcac.Terms [8] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "beta4"))
-                tcac.Terms [9] = atof (attribute_values [i]);
+                tcac.Terms [9] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "alpha5"))
-                tcac.Terms [10] = atof (attribute_values [i]);
+                tcac.Terms [10] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "beta5"))
-                tcac.Terms [11] = atof (attribute_values [i]);
+                tcac.Terms [11] = g_ascii_strtod (attribute_values [i], NULL);
             else
                 goto unk_attr;
 
@@ -498,20 +912,20 @@ static void _xml_start_element (GMarkupParseContext *context,
                     goto bad_attr;
             }
             else if (!strcmp (attribute_names [i], "focal"))
-                vc.Focal = atof (attribute_values [i]);
+                vc.Focal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "aperture"))
-                vc.Aperture = atof (attribute_values [i]);
+                vc.Aperture = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "distance"))
-                vc.Distance = atof (attribute_values [i]);
+                vc.Distance = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "k1") ||
                      !strcmp (attribute_names [i], "alpha1"))
-                vc.Terms [0] = atof (attribute_values [i]);
+                vc.Terms [0] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "k2") ||
                      !strcmp (attribute_names [i], "alpha2"))
-                vc.Terms [1] = atof (attribute_values [i]);
+                vc.Terms [1] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "k3") ||
                      !strcmp (attribute_names [i], "alpha3"))
-                vc.Terms [2] = atof (attribute_values [i]);
+                vc.Terms [2] = g_ascii_strtod (attribute_values [i], NULL);
             else
                 goto unk_attr;
 
@@ -526,7 +940,7 @@ static void _xml_start_element (GMarkupParseContext *context,
         memset (&lcc, 0, sizeof (lcc));
         for (i = 0; attribute_names [i]; i++)
             if (!strcmp (attribute_names [i], "focal"))
-                lcc.Focal = atof (attribute_values [i]);
+                lcc.Focal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "mode"))
             {
                 if (!strcmp (attribute_values [i], "no_crop"))
@@ -541,13 +955,13 @@ static void _xml_start_element (GMarkupParseContext *context,
                 }
             }
             else if (!strcmp (attribute_names [i], "left"))
-                lcc.Crop [0] = atof (attribute_values [i]);
+                lcc.Crop [0] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "right"))
-                lcc.Crop [1] = atof (attribute_values [i]);
+                lcc.Crop [1] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "top"))
-                lcc.Crop [2] = atof (attribute_values [i]);
+                lcc.Crop [2] = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "bottom"))
-                lcc.Crop [3] = atof (attribute_values [i]);
+                lcc.Crop [3] = g_ascii_strtod (attribute_values [i], NULL);
             else
             {
                 goto unk_attr;
@@ -561,7 +975,7 @@ static void _xml_start_element (GMarkupParseContext *context,
             goto bad_ctx;
 
         gint line, col;
-        g_markup_parse_context_get_position (context, &line, &col);
+        reader->GetPosition (line, col);
         g_warning ("[Lensfun] %s:%d:%d: <field_of_view> tag is deprecated.  Use <real-focal> attribute instead",
                    pd->errcontext, line, col);
 
@@ -569,9 +983,9 @@ static void _xml_start_element (GMarkupParseContext *context,
         memset (&lcf, 0, sizeof (lcf));
         for (i = 0; attribute_names [i]; i++)
             if (!strcmp (attribute_names [i], "focal"))
-                lcf.Focal = atof (attribute_values [i]);
+                lcf.Focal = g_ascii_strtod (attribute_values [i], NULL);
             else if (!strcmp (attribute_names [i], "fov"))
-                lcf.FieldOfView = atof (attribute_values [i]);
+                lcf.FieldOfView = g_ascii_strtod (attribute_values [i], NULL);
             else
             {
                 goto unk_attr;
@@ -602,7 +1016,285 @@ static void _xml_start_element (GMarkupParseContext *context,
                      "Unknown element <%s>!\n", element_name);
 }
 
-static void _xml_end_element (GMarkupParseContext *context,
+/* Copy a list of records made by _lf_addrec() into the arena, the pointers
+   followed by the records themselves. */
+static void **_lf_arena_list (lfArena *arena, void *const *list, size_t size)
+{
+    if (!list)
+        return NULL;
+
+    int n = 0;
+    while (list [n])
+        n++;
+
+    void **ret = (void **)arena->Alloc ((n + 1) * sizeof (void *) + n * size);
+    char *data = (char *)(ret + n + 1);
+    memcpy (data, list [0], n * size);
+    for (int i = 0; i < n; i++, data += size)
+        ret [i] = data;
+    ret [n] = NULL;
+    return ret;
+}
+
+/* Copy a NULL-terminated list of strings into the arena, interning them */
+static char **_lf_arena_strlist (lfArena *arena, char *const *list)
+{
+    if (!list)
+        return NULL;
+
+    int n = 0;
+    while (list [n])
+        n++;
+
+    char **ret = (char **)arena->Alloc ((n + 1) * sizeof (char *));
+    for (int i = 0; i < n; i++)
+        ret [i] = (char *)arena->Intern (list [i]);
+    ret [n] = NULL;
+    return ret;
+}
+
+static lfMount *_lf_arena_mount (lfArena *arena, const lfMount *mount)
+{
+    lfMount *ret = (lfMount *)arena->Alloc (sizeof (lfMount));
+    memcpy ((void *)ret, mount, sizeof (lfMount));
+    ret->Name = arena->InternMLstr (mount->Name);
+    ret->Compat = _lf_arena_strlist (arena, mount->Compat);
+    return ret;
+}
+
+static lfCamera *_lf_arena_camera (lfArena *arena, const lfCamera *camera)
+{
+    lfCamera *ret = (lfCamera *)arena->Alloc (sizeof (lfCamera));
+    memcpy ((void *)ret, camera, sizeof (lfCamera));
+    ret->Maker = arena->InternMLstr (camera->Maker);
+    ret->Model = arena->InternMLstr (camera->Model);
+    ret->Variant = arena->InternMLstr (camera->Variant);
+    ret->Mount = (char *)arena->Intern (camera->Mount);
+    // Split the names for searching, see lfDatabase::AddCamera
+    ret->MakerTokens = _lf_tokenize_mlstr (arena->GetTokens (), ret->Maker, arena);
+    ret->ModelTokens = _lf_tokenize_mlstr (arena->GetTokens (), ret->Model, arena);
+    return ret;
+}
+
+#define ARENA_LIST(field, type) \
+    dest->field = (type **)_lf_arena_list ( \
+        arena, (void *const *)lens->field, sizeof (type))
+
+static void _lf_arena_calibrations (lfArena *arena, lfLens *dest, const lfLens *lens)
+{
+    ARENA_LIST (CalibDistortion, lfLensCalibDistortion);
+    ARENA_LIST (CalibTCA, lfLensCalibTCA);
+    ARENA_LIST (CalibVignetting, lfLensCalibVignetting);
+    ARENA_LIST (CalibCrop, lfLensCalibCrop);
+    ARENA_LIST (CalibFov, lfLensCalibFov);
+}
+
+#undef ARENA_LIST
+
+static lfLens *_lf_arena_lens (lfArena *arena, const lfLens *lens)
+{
+    lfLens *ret = (lfLens *)arena->Alloc (sizeof (lfLens));
+    memcpy ((void *)ret, lens, sizeof (lfLens));
+    ret->Maker = arena->InternMLstr (lens->Maker);
+    ret->Model = arena->InternMLstr (lens->Model);
+    ret->ModelTokens = _lf_tokenize_mlstr (arena->GetTokens (), ret->Model, arena);
+    ret->Mounts = _lf_arena_strlist (arena, lens->Mounts);
+    _lf_arena_calibrations (arena, ret, lens);
+    return ret;
+}
+
+static void _xml_start_element (lfXmlReader         *reader,
+                                const gchar         *element_name,
+                                const gchar        **attribute_names,
+                                const gchar        **attribute_values,
+                                gpointer             user_data,
+                                GError             **error);
+static void _xml_end_element (lfXmlReader         *reader,
+                              const gchar         *element_name,
+                              gpointer             user_data,
+                              GError             **error);
+static void _xml_text (lfXmlReader         *reader,
+                       const gchar         *text,
+                       gsize                text_len,
+                       gpointer             user_data,
+                       GError             **error);
+
+/* Read a range of the data and pass it to the handlers */
+static bool _lf_xml_feed (lfXmlReader *reader, lfParserData *pd,
+                          char *pos, char *end, GError **err)
+{
+    reader->SetRange (pos, end);
+    for (;;)
+    {
+        switch (reader->Next (err))
+        {
+            case LF_XML_START:
+                pd->started = true;
+                _xml_start_element (reader, reader->Name, reader->AttrNames,
+                                    reader->AttrValues, pd, err);
+                break;
+
+            case LF_XML_END:
+                _xml_end_element (reader, reader->Name, pd, err);
+                break;
+
+            case LF_XML_TEXT:
+                _xml_text (reader, reader->Text, reader->TextLen, pd, err);
+                break;
+
+            case LF_XML_EOF:
+                return true;
+
+            case LF_XML_ERROR:
+                return false;
+        }
+        if (*err)
+            return false;
+    }
+}
+
+/* Parse a <calibration> element on its own into lens */
+static bool _lf_parse_calibrations (
+    lfLens *lens, const char *errcontext, char *data, gsize size)
+{
+    lfParserData pd;
+    memset (&pd, 0, sizeof (pd));
+    pd.lens = lens;
+    pd.errcontext = errcontext;
+    pd.stack [0] = "lensdatabase";
+    pd.stack [1] = "lens";
+    pd.stack_depth = 2;
+
+    lfXmlReader reader (data, size);
+    GError *err = NULL;
+    bool ok = _lf_xml_feed (&reader, &pd, data, data + size, &err);
+    if (ok && reader.GetDepth ())
+        g_set_error (&err, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                     "Document ended unexpectedly");
+    if (err)
+    {
+        g_warning ("[Lensfun] %s: calibration data of %s: %s",
+                   errcontext, lens->Model, err->message);
+        g_error_free (err);
+        ok = false;
+    }
+    lf_free (pd.lang);
+    return ok;
+}
+
+/* Read the value of a float attribute at pos, the start of an attribute
+   name within a tag */
+static bool _lf_scan_attr (const char *pos, const char *end,
+                           const char *name, float &value)
+{
+    size_t len = strlen (name);
+    if ((size_t)(end - pos) <= len || memcmp (pos, name, len))
+        return false;
+    for (pos += len; pos < end && isspace (*pos); pos++)
+        ;
+    if (pos >= end || *pos++ != '=')
+        return false;
+    for (; pos < end && isspace (*pos); pos++)
+        ;
+    if (pos >= end || (*pos != '"' && *pos != '\''))
+        return false;
+    value = g_ascii_strtod (pos + 1, NULL);
+    return true;
+}
+
+/* Find the focal length and aperture ranges of a <calibration> element
+   without parsing it, the same way lfLens::GuessParameters does */
+static void _lf_scan_calibration_ranges (lfLazyCalibrations *lazy, const char *data)
+{
+    static const char *const elements [] =
+    { "distortion", "tca", "vignetting", "crop", "field_of_view", NULL };
+
+    lazy->MinFocal = lazy->MinAperture = float (INT_MAX);
+    lazy->MaxFocal = lazy->MaxAperture = float (INT_MIN);
+
+    const char *pos = data, *end = data + lazy->Size;
+    while ((pos = (const char *)memchr (pos, '<', end - pos)))
+    {
+        if (end - pos >= 4 && !memcmp (pos, "<!--", 4))
+        {
+            pos = g_strstr_len (pos, end - pos, "-->");
+            if (!pos)
+                break;
+            continue;
+        }
+
+        const char *name = ++pos;
+        while (pos < end && (isalnum (*pos) || *pos == '_'))
+            pos++;
+        int i;
+        for (i = 0; elements [i]; i++)
+            if ((size_t)(pos - name) == strlen (elements [i]) &&
+                !memcmp (name, elements [i], pos - name))
+                break;
+        if (!elements [i])
+            continue;
+
+        const char *tag_end = (const char *)memchr (pos, '>', end - pos);
+        if (!tag_end)
+            break;
+        bool vignetting = !strcmp (elements [i], "vignetting");
+        float focal = 0, aperture = 0;
+        for (; pos < tag_end; pos++)
+            if (isspace (pos [-1]) &&
+                !_lf_scan_attr (pos, tag_end, "focal", focal) && vignetting)
+                _lf_scan_attr (pos, tag_end, "aperture", aperture);
+
+        if (focal < lazy->MinFocal)
+            lazy->MinFocal = focal;
+        if (focal > lazy->MaxFocal)
+            lazy->MaxFocal = focal;
+        if (vignetting)
+        {
+            if (aperture < lazy->MinAperture)
+                lazy->MinAperture = aperture;
+            if (aperture > lazy->MaxAperture)
+                lazy->MaxAperture = aperture;
+        }
+    }
+}
+
+/* Checksum of a <calibration> element which is read again from its file
+   later; FNV-1a over 64-bit words, which is fast enough to be computed for
+   every lens while loading */
+static guint64 _lf_calibrations_checksum (const char *data, gsize size)
+{
+    guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+    const char *end = data + size;
+    for (; end - data >= 8; data += 8)
+    {
+        guint64 word;
+        memcpy (&word, data, 8);
+        hash = (hash ^ word) * G_GUINT64_CONSTANT (1099511628211);
+    }
+    for (; data < end; data++)
+        hash = (hash ^ (guchar)*data) * G_GUINT64_CONSTANT (1099511628211);
+    return hash;
+}
+
+/* Called at the end of a lens whose <calibration> was skipped while
+   loading with LF_LOAD_LAZY_CALIBRATIONS */
+static void _lf_defer_calibrations (lfParserData *pd)
+{
+    lfLazyCalibrations *lazy = (lfLazyCalibrations *)pd->lens->LazyCalibrations;
+
+    _lf_scan_calibration_ranges (lazy, pd->data + lazy->Offset);
+    if (pd->persistent)
+        lazy->Data = pd->persistent + lazy->Offset;
+    else if (!pd->from_file)
+    {
+        // The caller's buffer is gone later, so keep the text
+        char *text = (char *)pd->arena->Alloc (lazy->Size);
+        memcpy (text, pd->data + lazy->Offset, lazy->Size);
+        lazy->Data = text;
+    }
+}
+
+static void _xml_end_element (lfXmlReader         *reader,
                               const gchar         *element_name,
                               gpointer             user_data,
                               GError             **error)
@@ -627,7 +1319,8 @@ static void _xml_end_element (GMarkupParseContext *context,
             return;
         }
 
-        pd->db->AddMount(pd->mount);
+        g_ptr_array_add (pd->mounts, _lf_arena_mount (pd->arena, pd->mount));
+        delete pd->mount;
         pd->mount = NULL;
     }
     else if (!strcmp (element_name, "camera"))
@@ -642,11 +1335,16 @@ static void _xml_end_element (GMarkupParseContext *context,
             return;
         }
 
-        pd->db->AddCamera(pd->camera);
+        if (!pd->filter || _lf_filter_camera (pd->filter, pd->camera))
+            g_ptr_array_add (pd->cameras, _lf_arena_camera (pd->arena, pd->camera));
+        delete pd->camera;
         pd->camera = NULL;
     }
     else if (!strcmp (element_name, "lens"))
     {
+        if (pd->lens && pd->lens->LazyCalibrations)
+            _lf_defer_calibrations (pd);
+
         /* Sanity check */
         if (!pd->lens || !pd->lens->Check ())
         {
@@ -657,19 +1355,21 @@ static void _xml_end_element (GMarkupParseContext *context,
             return;
         }
 
-        pd->db->AddLens(pd->lens);
+        if (!pd->filter || _lf_filter_lens (pd->filter, pd->lens))
+            g_ptr_array_add (pd->lenses, _lf_arena_lens (pd->arena, pd->lens));
+        delete pd->lens;
         pd->lens = NULL;
     }
 }
 
-static void _xml_text (GMarkupParseContext *context,
+static void _xml_text (lfXmlReader         *reader,
                        const gchar         *text,
                        gsize                text_len,
                        gpointer             user_data,
                        GError             **error)
 {
     lfParserData *pd = (lfParserData *)user_data;
-    const gchar *ctx = g_markup_parse_context_get_element (context);
+    const gchar *ctx = reader->GetElement ();
 
     while (*text && strchr (" \t\n\r", *text))
         text++;
@@ -733,9 +1433,9 @@ static void _xml_text (GMarkupParseContext *context,
     else if (!strcmp (ctx, "cropfactor"))
     {
         if (pd->camera)
-            pd->camera->CropFactor = atof (text);
+            pd->camera->CropFactor = g_ascii_strtod (text, NULL);
         else if (pd->lens)
-            pd->lens->CropFactor = atof (text);
+            pd->lens->CropFactor = g_ascii_strtod (text, NULL);
         else
             goto bad_ctx;
     }
@@ -745,9 +1445,9 @@ static void _xml_text (GMarkupParseContext *context,
         {
             const char *colon = strpbrk (text, ":");
             if (colon)
-                pd->lens->AspectRatio = atof (text) / atof (colon + 1);
+                pd->lens->AspectRatio = g_ascii_strtod (text, NULL) / g_ascii_strtod (colon + 1, NULL);
             else
-                pd->lens->AspectRatio = atof (text);
+                pd->lens->AspectRatio = g_ascii_strtod (text, NULL);
         }
         else
             goto bad_ctx;
@@ -790,60 +1490,429 @@ leave:
     pd->lang = NULL;
 }
 
-lfError lfDatabase::Load (const char *errcontext, const char *data, size_t data_size)
+/* Find the next element with the given start tag ("<name") outside of
+   comments */
+static const char *_lf_find_element (const char *pos, const char *end, const char *tag)
 {
-    static GMarkupParser gmp =
-    {
-        _xml_start_element,
-        _xml_end_element,
-        _xml_text,
-        NULL,
-        NULL
-    };
-
-    /* Temporarily drop numeric format to "C" */
-    char *old_numeric = setlocale (LC_NUMERIC, NULL);
-    old_numeric = strdup(old_numeric);
-    setlocale(LC_NUMERIC,"C");
-
-    /* eek! GPtrArray does not have a method to insert a pointer
-     into middle of the array... We have to remove the trailing
-     NULL and re-append it after loading ... */
-    g_ptr_array_remove_index_fast ((GPtrArray *)Mounts, ((GPtrArray *)Mounts)->len - 1);
-    g_ptr_array_remove_index_fast ((GPtrArray *)Cameras, ((GPtrArray *)Cameras)->len - 1);
-    g_ptr_array_remove_index_fast ((GPtrArray *)Lenses, ((GPtrArray *)Lenses)->len - 1);
+    const size_t tag_len = strlen (tag);
 
-    lfParserData pd;
-    memset (&pd, 0, sizeof (pd));
-    pd.db = this;
-    pd.errcontext = errcontext;
+    while ((pos = (const char *)memchr (pos, '<', end - pos)))
+    {
+        if (end - pos >= 4 && !memcmp (pos, "<!--", 4))
+        {
+            pos = g_strstr_len (pos, end - pos, "-->");
+            if (!pos)
+                break;
+        }
+        else if ((size_t)(end - pos) > tag_len && !memcmp (pos, tag, tag_len) &&
+                 (pos [tag_len] == '>' || isspace (pos [tag_len])))
+            return pos;
+        pos++;
+    }
+    return end;
+}
 
-    GMarkupParseContext *mpc = g_markup_parse_context_new (
-        &gmp, (GMarkupParseFlags)0, &pd, NULL);
+/* Find the end of the element starting at pos, or return NULL */
+static const char *_lf_element_end (const char *pos, const char *end, const char *tag)
+{
+    pos = g_strstr_len (pos, end - pos, tag);
+    return pos ? pos + strlen (tag) : NULL;
+}
 
-    GError *err = NULL;
-    lfError e = g_markup_parse_context_parse (mpc, data, data_size, &err) ?
-        LF_NO_ERROR : LF_WRONG_FORMAT;
+/* Feed a part of the data to the parser.  With LF_LOAD_LAZY_CALIBRATIONS
+   the <calibration> elements of lenses are skipped, and only their
+   position is remembered. */
+static bool _lf_parse_range (lfXmlReader *reader, lfParserData *pd, bool lazy,
+                             char *pos, char *end, GError **err)
+{
+    if (!lazy)
+        return _lf_xml_feed (reader, pd, pos, end, err);
+
+    bool ok = true;
+    while (ok && pos < end)
+    {
+        char *calib = (char *)_lf_find_element (pos, end, "<calibration");
+        char *calib_end = calib < end ?
+            (char *)_lf_element_end (calib, end, "</calibration>") : NULL;
+        if (!calib_end)
+            calib = calib_end = end;
+
+        if (calib > pos)
+            ok = _lf_xml_feed (reader, pd, pos, calib, err);
+        if (!ok || calib == calib_end)
+            break;
+
+        if (pd->lens && pd->stack_depth == 2 && !pd->lens->LazyCalibrations)
+        {
+            lfLazyCalibrations *lazy = (lfLazyCalibrations *)
+                pd->arena->Alloc (sizeof (lfLazyCalibrations));
+            lazy->Arena = pd->arena;
+            if (!pd->path && pd->from_file && !g_path_is_absolute (pd->errcontext))
+            {
+                // The file is read again later, maybe from another directory
+                gchar *cwd = g_get_current_dir ();
+                gchar *path = g_build_filename (cwd, pd->errcontext, NULL);
+                pd->path = pd->arena->Intern (path);
+                g_free (path);
+                g_free (cwd);
+            }
+            else if (!pd->path)
+                pd->path = pd->arena->Intern (pd->errcontext);
+            lazy->ErrContext = pd->path;
+            lazy->Offset = calib - pd->data;
+            lazy->Size = calib_end - calib;
+            if (pd->from_file)
+                lazy->Checksum = _lf_calibrations_checksum (calib, lazy->Size);
+            pd->lens->LazyCalibrations = lazy;
+        }
+        else
+            ok = _lf_xml_feed (reader, pd, calib, calib_end, err);
+        pos = calib_end;
+    }
+    return ok;
+}
+
+/* Feed a part of the data to the parser as the pass of lfDatabase::LoadData
+   requires.  The range must not end inside of a lens.  Without lenses,
+   their positions relative to pd->data are added to spans if given, since
+   the rest of the data is changed by the parser and cannot be searched
+   again.  With LF_PASS_LENSES, the range is searched for the lenses to
+   load. */
+static bool _lf_parse_pass (lfXmlReader *reader, lfParserData *pd, bool lazy,
+                            int pass, char *pos, char *end, GArray *spans,
+                            GError **err)
+{
+    if (pass == LF_PASS_ALL)
+        return _lf_parse_range (reader, pd, lazy, pos, end, err);
+
+    bool ok = true;
+    while (ok && pos < end)
+    {
+        char *lens = (char *)_lf_find_element (pos, end, "<lens");
+        char *lens_end = lens < end ?
+            (char *)_lf_element_end (lens, end, "</lens>") : NULL;
+        if (!lens_end)
+            lens = lens_end = end;
+
+        if (pass == LF_PASS_NO_LENSES)
+        {
+            if (lens > pos)
+                ok = _lf_parse_range (reader, pd, lazy, pos, lens, err);
+            if (spans && lens < lens_end)
+            {
+                gsize span [2] = { gsize (lens - pd->data), gsize (lens_end - pd->data) };
+                g_array_append_vals (spans, span, 2);
+            }
+        }
+        else if (lens < lens_end && _lf_filter_lens_text (pd->filter, lens, lens_end))
+            ok = _lf_parse_range (reader, pd, lazy, lens, lens_end, err);
+        pos = lens_end;
+    }
+    return ok;
+}
+
+/* Skip a comment or processing instruction at pos; returns its end, or
+   NULL if it is not complete */
+static char *_lf_skip_markup (char *pos, char *end)
+{
+    const char *close = pos [1] == '?' ? "?>" : pos [1] == '!' &&
+        end - pos >= 4 && !memcmp (pos, "<!--", 4) ? "-->" : ">";
+    char *found = g_strstr_len (pos + 2, end - pos - 2, close);
+    return found ? found + strlen (close) : NULL;
+}
+
+/* Return the end of the start tag at pos, or NULL if it is not complete */
+static char *_lf_start_tag_end (char *pos, char *end)
+{
+    for (char quote = 0; pos < end; pos++)
+        if (quote)
+        {
+            if (*pos == quote)
+                quote = 0;
+        }
+        else if (*pos == '"' || *pos == '\'')
+            quote = *pos;
+        else if (*pos == '>')
+            return pos + 1;
+    return NULL;
+}
+
+/* Find the end of the root start tag in decompressed text, or return NULL
+   if it is not complete yet */
+static char *_lf_stream_root (char *pos, char *end)
+{
+    while ((pos = (char *)memchr (pos, '<', end - pos)))
+    {
+        if (end - pos < 2)
+            return NULL;
+        if (pos [1] != '?' && pos [1] != '!')
+            return _lf_start_tag_end (pos, end);
+        if (!(pos = _lf_skip_markup (pos, end)))
+            return NULL;
+    }
+    return NULL;
+}
+
+/* Find the end of the last complete child of the root in decompressed
+   text starting between two children, or pos if there is none */
+static char *_lf_stream_boundary (char *pos, char *end)
+{
+    char *last = pos;
+    while ((pos = (char *)memchr (pos, '<', end - pos)))
+    {
+        if (end - pos < 2 || pos [1] == '/')
+            break;
+        if (pos [1] == '?' || pos [1] == '!')
+        {
+            if (!(pos = _lf_skip_markup (pos, end)))
+                break;
+            last = pos;
+            continue;
+        }
+
+        char *name = pos + 1;
+        char *tag_end = _lf_start_tag_end (pos, end);
+        if (!tag_end)
+            break;
+        if (tag_end [-2] == '/')
+        {
+            last = pos = tag_end;
+            continue;
+        }
+
+        /* Like the lenses of a filtered load, elements end at the first
+           end tag with their name */
+        size_t len = strcspn (name, " \t\r\n/>");
+        for (pos = tag_end;; pos++)
+        {
+            pos = (char *)memchr (pos, '<', end - pos);
+            if (!pos || (size_t)(end - pos) < len + 3)
+                return last;
+            if (pos [1] == '/' && !memcmp (pos + 2, name, len) && pos [len + 2] == '>')
+                break;
+        }
+        last = pos = pos + len + 3;
+    }
+    return last;
+}
+
+/* Decompress a database file piece by piece and feed complete children of
+   the root to the parser, so that the whole text is never in memory.  The
+   root start tag stays at the start of the buffer, since the parser
+   refers to its name until the end.  On return, line and col are the
+   position of the parser. */
+static bool _lf_parse_stream (lfDecoder *decoder, lfParserData *pd, bool lazy,
+                              int pass, gint &line, gint &col, GError **err)
+{
+    gsize size = LF_DECODE_CHUNK, fill = 0, parsed = 0, keep = 0;
+    char *buf = (char *)g_malloc (size);
+    lfXmlReader reader (buf, size);
+    bool ok = true, eof = false, root = false;
+    int dropped = 0;
+
+    while (ok)
+    {
+        if (parsed > keep)
+        {
+            for (char *c = buf + keep; (c = (char *)memchr (c, '\n', buf + parsed - c)); c++)
+                dropped++;
+            memmove (buf + keep, buf + parsed, fill - parsed);
+            fill -= parsed - keep;
+            parsed = keep;
+        }
+
+        pd->data = buf;
+        char *pos = buf + parsed, *end = buf + fill;
+        char *stop;
+        if (eof)
+            stop = end;
+        else if (root)
+            stop = _lf_stream_boundary (pos, end);
+        else if ((stop = _lf_stream_root (pos, end)))
+        {
+            root = true;
+            if (pass != LF_PASS_LENSES)
+                keep = stop - buf;
+        }
+        else
+            stop = pos;
+
+        if (stop > pos)
+        {
+            ok = _lf_parse_pass (&reader, pd, lazy, pass, pos, stop, NULL, err);
+            parsed = stop - buf;
+            continue;
+        }
+        if (eof)
+            break;
+
+        // Only an element larger than the buffer makes it grow
+        if (fill == size)
+        {
+            // The names of the open elements are in the buffer
+            gsize names [G_N_ELEMENTS (pd->stack)];
+            for (size_t i = 0; i < pd->stack_depth; i++)
+                names [i] = pd->stack [i] >= buf && pd->stack [i] < buf + size ?
+                    pd->stack [i] - buf : G_MAXSIZE;
+
+            size *= 2;
+            buf = (char *)g_realloc (buf, size);
+            reader.Move (buf, size);
+            for (size_t i = 0; i < pd->stack_depth; i++)
+                if (names [i] != G_MAXSIZE)
+                    pd->stack [i] = buf + names [i];
+        }
+        gssize n = decoder->Read (buf + fill, size - fill, err);
+        if (n < 0)
+        {
+            ok = false;
+            break;
+        }
+        eof = !n;
+        fill += n;
+    }
+
+    if (ok && reader.GetDepth ())
+    {
+        g_set_error (err, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                     "Document ended unexpectedly");
+        ok = false;
+    }
+    reader.GetPosition (line, col);
+    line += dropped;
+
+    g_free (buf);
+    return ok;
+}
+
+lfError lfDatabase::Load (const char *errcontext, const char *data, size_t data_size)
+{
+    // The parser changes the data while reading it
+    char *copy = (char *)g_malloc (data_size);
+    memcpy (copy, data, data_size);
+    lfError e;
+
+    if (!Filter)
+        e = LoadData (errcontext, copy, data_size, false, LF_PASS_ALL, NULL);
+    else
+    {
+        GArray *lenses = g_array_new (FALSE, FALSE, sizeof (gsize));
+        e = LoadData (errcontext, copy, data_size, false, LF_PASS_NO_LENSES, lenses);
+        if (e == LF_NO_ERROR)
+        {
+            SortObjects ();
+            _lf_filter_update ((lfLoadFilter *)Filter, this);
+            e = LoadData (errcontext, copy, data_size, false, LF_PASS_LENSES, lenses);
+        }
+        g_array_free (lenses, TRUE);
+    }
+
+    SortObjects ();
+    g_free (copy);
+    return e;
+}
+
+lfError lfDatabase::LoadData (const char *errcontext, char *data,
+                              size_t data_size, bool from_file, int pass,
+                              void *lenses, const char *persistent)
+{
+    /* eek! GPtrArray does not have a method to insert a pointer
+     into middle of the array... We have to remove the trailing
+     NULL and re-append it after loading ... */
+    g_ptr_array_remove_index_fast ((GPtrArray *)Mounts, ((GPtrArray *)Mounts)->len - 1);
+    g_ptr_array_remove_index_fast ((GPtrArray *)Cameras, ((GPtrArray *)Cameras)->len - 1);
+    g_ptr_array_remove_index_fast ((GPtrArray *)Lenses, ((GPtrArray *)Lenses)->len - 1);
+
+    lfParserData pd;
+    memset (&pd, 0, sizeof (pd));
+    pd.mounts = (GPtrArray *)Mounts;
+    pd.cameras = (GPtrArray *)Cameras;
+    pd.lenses = (GPtrArray *)Lenses;
+    pd.arena = (lfArena *)Arena;
+    pd.errcontext = errcontext;
+    pd.data = data;
+    pd.from_file = from_file;
+    pd.persistent = persistent;
+    pd.filter = (lfLoadFilter *)Filter;
+
+    GError *err = NULL;
+    bool lazy = LoadFlags & LF_LOAD_LAZY_CALIBRATIONS;
+    bool ok = true;
+    gint line = 0, col = 0;
+
+    if (pass == LF_PASS_LENSES)
+    {
+        /* The lenses are fed to the parser one by one, without the
+           surrounding <lensdatabase> element */
+        pd.stack [0] = "lensdatabase";
+        pd.stack_depth = 1;
+        pd.started = true;
+    }
+
+    lfCompression compression = _lf_compression_of_data (data, data_size);
+    if (compression != LF_COMPRESSION_NONE)
+    {
+        /* The decompressed text is gone after loading */
+        pd.from_file = false;
+        pd.persistent = NULL;
+        lfDecoder decoder (compression, data, data_size);
+        ok = _lf_parse_stream (&decoder, &pd, lazy, pass, line, col, &err);
+    }
+    else
+    {
+        lfXmlReader reader (data, data_size);
+
+        if (pass != LF_PASS_LENSES)
+            ok = _lf_parse_pass (&reader, &pd, lazy, pass, data, data + data_size,
+                                 (GArray *)lenses, &err);
+        else
+        {
+            GArray *spans = (GArray *)lenses;
+            for (guint i = 0; ok && i < spans->len; i += 2)
+            {
+                char *lens = data + g_array_index (spans, gsize, i);
+                char *lens_end = data + g_array_index (spans, gsize, i + 1);
+                if (_lf_filter_lens_text (pd.filter, lens, lens_end))
+                    ok = _lf_parse_range (&reader, &pd, lazy, lens, lens_end, &err);
+            }
+        }
+
+        if (ok && reader.GetDepth ())
+        {
+            g_set_error (&err, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                         "Document ended unexpectedly");
+            ok = false;
+        }
+        if (!ok || !pd.started)
+            reader.GetPosition (line, col);
+    }
+
+    if (ok && !pd.started)
+    {
+        g_set_error (&err, G_MARKUP_ERROR, G_MARKUP_ERROR_EMPTY,
+                     "Document was empty or contained only whitespace");
+        ok = false;
+    }
+    lfError e = ok ? LF_NO_ERROR : LF_WRONG_FORMAT;
 
     /* Display the parsing error as a warning */
     if (e != LF_NO_ERROR)
     {
-        gint line, col;
-        g_markup_parse_context_get_position (mpc, &line, &col);
         g_warning ("[Lensfun] %s:%d:%d: %s", errcontext, line, col, err->message);
+        g_error_free (err);
     }
 
-    g_markup_parse_context_free (mpc);
+    /* Objects left unfinished by an error */
+    delete pd.mount;
+    delete pd.camera;
+    delete pd.lens;
+    lf_free (pd.lang);
 
     /* Re-add the trailing NULL */
     g_ptr_array_add ((GPtrArray *)Mounts, NULL);
     g_ptr_array_add ((GPtrArray *)Cameras, NULL);
     g_ptr_array_add ((GPtrArray *)Lenses, NULL);
 
-    /* Restore numeric format */
-    setlocale (LC_NUMERIC, old_numeric);
-    free(old_numeric);
-
     return e;
 }
 
@@ -855,298 +1924,347 @@ lfError lfDatabase::Save (const char *filename) const
                  (lfLens **)((GPtrArray *)Lenses)->pdata);
 }
 
-lfError lfDatabase::Save (const char *filename,
-                          const lfMount *const *mounts,
-                          const lfCamera *const *cameras,
-                          const lfLens *const *lenses) const
+static void _lf_save_lens (lfXmlWriter &out, const lfLens *lens)
 {
-    char *output = Save (mounts, cameras, lenses);
-    if (!output)
-        return lfError (-ENOMEM);
+    int j;
 
-    int fh = g_open (filename, O_CREAT | O_WRONLY | O_TRUNC, 0666);
-    if (fh < 0)
+    out.Write ("\t<lens>\n");
+
+    out.MLstr ("\t\t", "maker", lens->Maker);
+    out.MLstr ("\t\t", "model", lens->Model);
+    if (lens->MinFocal)
     {
-        g_free (output);
-        return lfError (-errno);
+        out.Write ("\t\t<focal ");
+        if (lens->MinFocal == lens->MaxFocal)
+            out.Attr ("value", lens->MinFocal);
+        else
+        {
+            out.Attr ("min", lens->MinFocal);
+            out.Attr ("max", lens->MaxFocal);
+        }
+        out.Write ("/>\n");
+    }
+    if (lens->MinAperture)
+    {
+        out.Write ("\t\t<aperture ");
+        if (lens->MinAperture == lens->MaxAperture)
+            out.Attr ("value", lens->MinAperture);
+        else
+        {
+            out.Attr ("min", lens->MinAperture);
+            out.Attr ("max", lens->MaxAperture);
+        }
+        out.Write ("/>\n");
     }
 
-    int ol = strlen (output);
-    ol = (write (fh, output, ol) == ol);
-    close (fh);
+    if (lens->Mounts)
+        for (j = 0; lens->Mounts [j]; j++)
+            out.Element ("\t\t", "mount", lens->Mounts [j]);
+
+    if (lens->Type != LF_RECTILINEAR)
+        out.Element ("\t\t", "type",
+                     lens->Type == LF_FISHEYE ? "fisheye" :
+                     lens->Type == LF_PANORAMIC ? "panoramic" :
+                     lens->Type == LF_EQUIRECTANGULAR ? "equirectangular" :
+                     lens->Type == LF_FISHEYE_ORTHOGRAPHIC ? "orthographic" :
+                     lens->Type == LF_FISHEYE_STEREOGRAPHIC ? "stereographic" :
+                     lens->Type == LF_FISHEYE_EQUISOLID ? "equisolid" :
+                     lens->Type == LF_FISHEYE_THOBY ? "fisheye_thoby" :
+                     "rectilinear");
+
+    if (lens->CenterX || lens->CenterY)
+    {
+        out.Write ("\t\t<center ");
+        out.Attr ("x", lens->CenterX);
+        out.Attr ("y", lens->CenterY);
+        out.Write ("/>\n");
+    }
 
-    g_free (output);
+    out.Element ("\t\t", "cropfactor", lens->CropFactor);
+    out.Element ("\t\t", "aspect-ratio", lens->AspectRatio);
 
-    return ol ? LF_NO_ERROR : lfError (-ENOSPC);
-}
+    _lf_lens_need_calibrations (lens);
+    bool calibrated = lens->CalibDistortion || lens->CalibTCA ||
+        lens->CalibVignetting || lens->CalibCrop || lens->CalibFov;
+    if (calibrated)
+        out.Write ("\t\t<calibration>\n");
 
-char *lfDatabase::Save (const lfMount *const *mounts,
-                        const lfCamera *const *cameras,
-                        const lfLens *const *lenses)
-{
-    /* Temporarily drop numeric format to "C" */
-    char *old_numeric = setlocale (LC_NUMERIC, NULL);
-    old_numeric = strdup(old_numeric);
-    setlocale(LC_NUMERIC,"C");
+    if (lens->CalibDistortion)
+    {
+        for (j = 0; lens->CalibDistortion [j]; j++)
+        {
+            lfLensCalibDistortion *cd = lens->CalibDistortion [j];
 
-    int i, j;
-    GString *output = g_string_sized_new (1024);
+            out.Write ("\t\t\t<distortion ");
+            out.Attr ("focal", cd->Focal);
+            if (cd->RealFocal > 0)
+                out.Attr ("real-focal", cd->RealFocal);
+            switch (cd->Model)
+            {
+                case LF_DIST_MODEL_POLY3:
+                    out.Write ("model=\"poly3\" ");
+                    out.Attr ("k1", cd->Terms [0]);
+                    break;
 
-    g_string_append (output, "<!DOCTYPE lensdatabase SYSTEM \"lensfun-database.dtd\">\n");
-    g_string_append (output, "<lensdatabase>\n\n");
+                case LF_DIST_MODEL_POLY5:
+                    out.Write ("model=\"poly5\" ");
+                    out.Attr ("k1", cd->Terms [0]);
+                    out.Attr ("k2", cd->Terms [1]);
+                    break;
 
-    if (mounts)
-        for (i = 0; mounts [i]; i++)
-        {
-            g_string_append (output, "\t<mount>\n");
-            _lf_xml_printf_mlstr (output, "\t\t", "name",
-                                        mounts [i]->Name);
-            if (mounts [i]->Compat)
-                for (j = 0; mounts [i]->Compat [j]; j++)
-                    _lf_xml_printf (output, "\t\t<compat>%s</compat>\n",
-                                    mounts [i]->Compat [j]);
-            g_string_append (output, "\t</mount>\n\n");
+                case LF_DIST_MODEL_PTLENS:
+                    out.Write ("model=\"ptlens\" ");
+                    out.Attr ("a", cd->Terms [0]);
+                    out.Attr ("b", cd->Terms [1]);
+                    out.Attr ("c", cd->Terms [2]);
+                    break;
+
+                case LF_DIST_MODEL_ACM:
+                    out.Write ("model=\"acm\" ");
+                    out.Attr ("k1", cd->Terms [0]);
+                    out.Attr ("k2", cd->Terms [1]);
+                    out.Attr ("k3", cd->Terms [2]);
+                    out.Attr ("k4", cd->Terms [3]);
+                    out.Attr ("k5", cd->Terms [4]);
+                    break;
+
+                default:
+                    out.Write ("model=\"none\" ");
+                    break;
+            }
+            out.Write ("/>\n");
         }
+    }
 
-    if (cameras)
-        for (i = 0; cameras [i]; i++)
+    if (lens->CalibTCA)
+    {
+        static const char *const poly3 [] = { "vr", "vb", "cr", "cb", "br", "bb" };
+        static const char *const acm [] = {
+            "alpha0", "beta0", "alpha1", "beta1", "alpha2", "beta2",
+            "alpha3", "beta3", "alpha4", "beta4", "alpha5", "beta5" };
+
+        for (j = 0; lens->CalibTCA [j]; j++)
         {
-            g_string_append (output, "\t<camera>\n");
+            lfLensCalibTCA *ctca = lens->CalibTCA [j];
+
+            out.Write ("\t\t\t<tca ");
+            out.Attr ("focal", ctca->Focal);
+            switch (ctca->Model)
+            {
+                case LF_TCA_MODEL_LINEAR:
+                    out.Write ("model=\"linear\" ");
+                    out.Attr ("kr", ctca->Terms [0]);
+                    out.Attr ("kb", ctca->Terms [1]);
+                    break;
+
+                case LF_TCA_MODEL_POLY3:
+                    out.Write ("model=\"poly3\" ");
+                    for (int k = 0; k < 6; k++)
+                        out.Attr (poly3 [k], ctca->Terms [k]);
+                    break;
 
-            _lf_xml_printf_mlstr (output, "\t\t", "maker", cameras [i]->Maker);
-            _lf_xml_printf_mlstr (output, "\t\t", "model", cameras [i]->Model);
-            _lf_xml_printf_mlstr (output, "\t\t", "variant", cameras [i]->Variant);
-            _lf_xml_printf (output, "\t\t<mount>%s</mount>\n",
-                            cameras [i]->Mount);
-            _lf_xml_printf (output, "\t\t<cropfactor>%g</cropfactor>\n",
-                            cameras [i]->CropFactor);
+                case LF_TCA_MODEL_ACM:
+                    out.Write ("model=\"acm\" ");
+                    for (int k = 0; k < 12; k++)
+                        out.Attr (acm [k], ctca->Terms [k]);
+                    break;
 
-            g_string_append (output, "\t</camera>\n\n");
+                default:
+                    out.Write ("model=\"none\" ");
+                    break;
+            }
+            out.Write ("/>\n");
         }
+    }
 
-    if (lenses)
-        for (i = 0; lenses [i]; i++)
+    if (lens->CalibVignetting)
+    {
+        for (j = 0; lens->CalibVignetting [j]; j++)
         {
-            g_string_append (output, "\t<lens>\n");
+            lfLensCalibVignetting *cv = lens->CalibVignetting [j];
 
-            _lf_xml_printf_mlstr (output, "\t\t", "maker", lenses [i]->Maker);
-            _lf_xml_printf_mlstr (output, "\t\t", "model", lenses [i]->Model);
-            if (lenses [i]->MinFocal)
+            out.Write ("\t\t\t<vignetting ");
+            out.Attr ("focal", cv->Focal);
+            out.Attr ("aperture", cv->Aperture);
+            out.Attr ("distance", cv->Distance);
+            switch (cv->Model)
             {
-                if (lenses [i]->MinFocal == lenses [i]->MaxFocal)
-                    _lf_xml_printf (output, "\t\t<focal value=\"%g\" />\n",
-                                    lenses [i]->MinFocal);
-                else
-                    _lf_xml_printf (output, "\t\t<focal min=\"%g\" max=\"%g\" />\n",
-                                    lenses [i]->MinFocal, lenses [i]->MaxFocal);
-            }
-            if (lenses [i]->MinAperture)
-            {
-                if (lenses [i]->MinAperture == lenses [i]->MaxAperture)
-                    _lf_xml_printf (output, "\t\t<aperture value=\"%g\" />\n",
-                                    lenses [i]->MinAperture);
-                else
-                    _lf_xml_printf (output, "\t\t<aperture min=\"%g\" max=\"%g\" />\n",
-                                    lenses [i]->MinAperture, lenses [i]->MaxAperture);
-            }
+                case LF_VIGNETTING_MODEL_PA:
+                    out.Write ("model=\"pa\" ");
+                    out.Attr ("k1", cv->Terms [0]);
+                    out.Attr ("k2", cv->Terms [1]);
+                    out.Attr ("k3", cv->Terms [2]);
+                    break;
 
-            if (lenses [i]->Mounts)
-                for (j = 0; lenses [i]->Mounts [j]; j++)
-                    _lf_xml_printf (output, "\t\t<mount>%s</mount>\n",
-                                    lenses [i]->Mounts [j]);
-
-            if (lenses [i]->Type != LF_RECTILINEAR)
-                _lf_xml_printf (output, "\t\t<type>%s</type>\n",
-                                lenses [i]->Type == LF_FISHEYE ? "fisheye" :
-                                lenses [i]->Type == LF_PANORAMIC ? "panoramic" :
-                                lenses [i]->Type == LF_EQUIRECTANGULAR ? "equirectangular" :
-                                lenses [i]->Type == LF_FISHEYE_ORTHOGRAPHIC ? "orthographic" :
-                                lenses [i]->Type == LF_FISHEYE_STEREOGRAPHIC ? "stereographic" :
-                                lenses [i]->Type == LF_FISHEYE_EQUISOLID ? "equisolid" :
-                                lenses [i]->Type == LF_FISHEYE_THOBY ? "fisheye_thoby" :
-                                "rectilinear");
-
-            if (lenses [i]->CenterX || lenses [i]->CenterY)
-                _lf_xml_printf (output, "\t\t<center x=\"%g\" y=\"%g\" />\n",
-                                lenses [i]->CenterX, lenses [i]->CenterY);
-
-            _lf_xml_printf (output, "\t\t<cropfactor>%g</cropfactor>\n",
-                            lenses [i]->CropFactor);
-            _lf_xml_printf (output, "\t\t<aspect-ratio>%g</aspect-ratio>\n",
-                            lenses [i]->AspectRatio);
-
-            if (lenses [i]->CalibDistortion || lenses [i]->CalibTCA ||
-                lenses [i]->CalibVignetting || lenses [i]->CalibCrop ||
-                lenses [i]->CalibFov)
-                g_string_append (output, "\t\t<calibration>\n");
-
-            if (lenses [i]->CalibDistortion)
-            {
-                for (j = 0; lenses [i]->CalibDistortion [j]; j++)
-                {
-                    lfLensCalibDistortion *cd = lenses [i]->CalibDistortion [j];
+                case LF_VIGNETTING_MODEL_ACM:
+                    out.Write ("model=\"acm\" ");
+                    out.Attr ("alpha1", cv->Terms [0]);
+                    out.Attr ("alpha2", cv->Terms [1]);
+                    out.Attr ("alpha3", cv->Terms [2]);
+                    break;
 
-                    _lf_xml_printf (output, "\t\t\t<distortion focal=\"%g\" ",
-                                    cd->Focal);
-                    if (cd->RealFocal > 0)
-                    _lf_xml_printf (output, "real-focal=\"%g\" ", cd->RealFocal);
-                    switch (cd->Model)
-                    {
-                        case LF_DIST_MODEL_POLY3:
-                            _lf_xml_printf (
-                                output, "model=\"poly3\" k1=\"%g\" />\n",
-                                cd->Terms [0]);
-                            break;
-
-                        case LF_DIST_MODEL_POLY5:
-                            _lf_xml_printf (
-                                output, "model=\"poly5\" k1=\"%g\" k2=\"%g\" />\n",
-                                cd->Terms [0], cd->Terms [1]);
-                            break;
-
-                        case LF_DIST_MODEL_PTLENS:
-                            _lf_xml_printf (
-                                output, "model=\"ptlens\" a=\"%g\" b=\"%g\" c=\"%g\" />\n",
-                                cd->Terms [0], cd->Terms [1], cd->Terms [2]);
-                            break;
-
-                        case LF_DIST_MODEL_ACM:
-                            _lf_xml_printf (
-                                output, "model=\"acm\" k1=\"%g\" k2=\"%g\" k3=\"%g\" k4=\"%g\" k5=\"%g\" />\n",
-                                cd->Terms [0], cd->Terms [1], cd->Terms [2], cd->Terms [3], cd->Terms [4]);
-                            break;
-
-                        default:
-                            _lf_xml_printf (output, "model=\"none\" />\n");
-                            break;
-                    }
-                }
+                default:
+                    out.Write ("model=\"none\" ");
+                    break;
             }
+            out.Write ("/>\n");
+        }
+    }
 
-            if (lenses [i]->CalibTCA)
+    if (lens->CalibCrop)
+    {
+        for (j = 0; lens->CalibCrop [j]; j++)
+        {
+            lfLensCalibCrop *lcc = lens->CalibCrop [j];
+
+            out.Write ("\t\t\t<crop ");
+            out.Attr ("focal", lcc->Focal);
+            switch (lcc->CropMode)
             {
-                for (j = 0; lenses [i]->CalibTCA [j]; j++)
-                {
-                    lfLensCalibTCA *ctca = lenses [i]->CalibTCA [j];
-                    _lf_xml_printf (output, "\t\t\t<tca focal=\"%g\" ", ctca->Focal);
-                    switch (ctca->Model)
-                    {
-                        case LF_TCA_MODEL_LINEAR:
-                            _lf_xml_printf (output, "model=\"linear\" kr=\"%g\" kb=\"%g\" />\n",
-                                            ctca->Terms [0], ctca->Terms [1]);
-                            break;
-
-                        case LF_TCA_MODEL_POLY3:
-                            _lf_xml_printf (output, "model=\"poly3\" vr=\"%g\" vb=\"%g\" "
-                                            "cr=\"%g\" cb=\"%g\" br=\"%g\" bb=\"%g\" />\n",
-                                            ctca->Terms [0], ctca->Terms [1], ctca->Terms [2],
-                                            ctca->Terms [3], ctca->Terms [4], ctca->Terms [5]);
-                            break;
-
-                        case LF_TCA_MODEL_ACM:
-                            _lf_xml_printf (output, "model=\"acm\" alpha0=\"%g\" beta0=\"%g\" "
-                                            "alpha1=\"%g\" beta1=\"%g\" alpha2=\"%g\" "
-                                            "beta2=\"%g\" alpha3=\"%g\" beta3=\"%g\" "
-                                            "alpha4=\"%g\" beta4=\"%g\" alpha5=\"%g\" "
-                                            "beta5=\"%g\" />\n",
-                                            ctca->Terms [0], ctca->Terms [1], ctca->Terms [2],
-                                            ctca->Terms [3], ctca->Terms [4], ctca->Terms [5],
-                                            ctca->Terms [6], ctca->Terms [7], ctca->Terms [8],
-                                            ctca->Terms [9], ctca->Terms [10], ctca->Terms [11]);
-                            break;
-
-                        default:
-                            _lf_xml_printf (output, "model=\"none\" />\n");
-                            break;
-                    }
-                }
+                case LF_CROP_RECTANGLE:
+                case LF_CROP_CIRCLE:
+                    out.Write (lcc->CropMode == LF_CROP_RECTANGLE ?
+                               "mode=\"crop_rectangle\" " : "mode=\"crop_circle\" ");
+                    out.Attr ("left", lcc->Crop [0]);
+                    out.Attr ("right", lcc->Crop [1]);
+                    out.Attr ("top", lcc->Crop [2]);
+                    out.Attr ("bottom", lcc->Crop [3]);
+                    break;
+
+                case LF_NO_CROP:
+                default:
+                    out.Write ("mode=\"no_crop\" ");
+                    break;
             }
+            out.Write ("/>\n");
+        }
+    }
 
-            if (lenses [i]->CalibVignetting)
+    if (lens->CalibFov)
+    {
+        for (j = 0; lens->CalibFov [j]; j++)
+        {
+            lfLensCalibFov *lcf = lens->CalibFov [j];
+
+            if (lcf->FieldOfView > 0)
             {
-                for (j = 0; lenses [i]->CalibVignetting [j]; j++)
-                {
-                    lfLensCalibVignetting *cv = lenses [i]->CalibVignetting [j];
-                    _lf_xml_printf (output, "\t\t\t<vignetting focal=\"%g\" aperture=\"%g\" distance=\"%g\" ",
-                                    cv->Focal, cv->Aperture, cv->Distance);
-                    switch (cv->Model)
-                    {
-                        case LF_VIGNETTING_MODEL_PA:
-                            _lf_xml_printf (output, "model=\"pa\" k1=\"%g\" k2=\"%g\" k3=\"%g\" />\n",
-                                            cv->Terms [0], cv->Terms [1], cv->Terms [2]);
-                            break;
-
-                        case LF_VIGNETTING_MODEL_ACM:
-                            _lf_xml_printf (output, "model=\"acm\" alpha1=\"%g\" alpha2=\"%g\" alpha3=\"%g\" />\n",
-                                            cv->Terms [0], cv->Terms [1], cv->Terms [2]);
-                            break;
-
-                        default:
-                            _lf_xml_printf (output, "model=\"none\" />\n");
-                            break;
-                    }
-                }
+                out.Write ("\t\t\t<field_of_view ");
+                out.Attr ("focal", lcf->Focal);
+                out.Attr ("fov", lcf->FieldOfView);
+                out.Write ("/>\n");
             }
+        }
+    }
 
-            if (lenses [i]->CalibCrop)
-            {
-                for (j = 0; lenses [i]->CalibCrop [j]; j++)
-                {
-                    lfLensCalibCrop *lcc = lenses [i]->CalibCrop [j];
+    if (calibrated)
+        out.Write ("\t\t</calibration>\n");
 
-                    _lf_xml_printf (output, "\t\t\t<crop focal=\"%g\" ",
-                                    lcc->Focal);
-                    switch (lcc->CropMode)
-                    {
-                        case LF_CROP_RECTANGLE:
-                            _lf_xml_printf (
-                                output, "mode=\"crop_rectangle\" left=\"%g\" right=\"%g\" top=\"%g\" bottom=\"%g\" />\n",
-                                lcc->Crop [0], lcc->Crop [1], lcc->Crop [2], lcc->Crop [3]);
-                            break;
-
-                        case LF_CROP_CIRCLE:
-                            _lf_xml_printf (
-                                output, "mode=\"crop_circle\" left=\"%g\" right=\"%g\" top=\"%g\" bottom=\"%g\" />\n",
-                                lcc->Crop [0], lcc->Crop [1], lcc->Crop [2], lcc->Crop [3]);
-                            break;
-
-                        case LF_NO_CROP:
-                        default:
-                            _lf_xml_printf (output, "mode=\"no_crop\" />\n");
-                            break;
-                    }
-                }
-            }
+    out.Write ("\t</lens>\n\n");
+}
 
-            if (lenses [i]->CalibFov)
-            {
-                for (j = 0; lenses [i]->CalibFov [j]; j++)
-                {
-                    lfLensCalibFov *lcf = lenses [i]->CalibFov [j];
+static void _lf_save (lfXmlWriter &out,
+                      const lfMount *const *mounts,
+                      const lfCamera *const *cameras,
+                      const lfLens *const *lenses)
+{
+    int i, j;
 
-                    if (lcf->FieldOfView>0)
-                    {
-                        _lf_xml_printf (output, "\t\t\t<field_of_view focal=\"%g\" fov=\"%g\" />\n",
-                            lcf->Focal, lcf->FieldOfView);
-                    };
-                }
-            }
+    out.Write ("<!DOCTYPE lensdatabase SYSTEM \"lensfun-database.dtd\">\n");
+    out.Write ("<lensdatabase>\n\n");
 
-            if (lenses [i]->CalibDistortion || lenses [i]->CalibTCA ||
-                lenses [i]->CalibVignetting || lenses [i]->CalibCrop ||
-                lenses [i]->CalibFov)
-                g_string_append (output, "\t\t</calibration>\n");
+    if (mounts)
+        for (i = 0; mounts [i]; i++)
+        {
+            out.Write ("\t<mount>\n");
+            out.MLstr ("\t\t", "name", mounts [i]->Name);
+            if (mounts [i]->Compat)
+                for (j = 0; mounts [i]->Compat [j]; j++)
+                    out.Element ("\t\t", "compat", mounts [i]->Compat [j]);
+            out.Write ("\t</mount>\n\n");
+        }
+
+    if (cameras)
+        for (i = 0; cameras [i]; i++)
+        {
+            out.Write ("\t<camera>\n");
 
-            g_string_append (output, "\t</lens>\n\n");
+            out.MLstr ("\t\t", "maker", cameras [i]->Maker);
+            out.MLstr ("\t\t", "model", cameras [i]->Model);
+            out.MLstr ("\t\t", "variant", cameras [i]->Variant);
+            if (cameras [i]->Mount)
+                out.Element ("\t\t", "mount", cameras [i]->Mount);
+            out.Element ("\t\t", "cropfactor", cameras [i]->CropFactor);
+
+            out.Write ("\t</camera>\n\n");
         }
 
-    g_string_append (output, "</lensdatabase>\n");
+    if (lenses)
+    {
+#ifdef _OPENMP
+        // Lens blocks are independent of each other, so a batch of them
+        // is serialized in parallel, each into its own buffer, and the
+        // buffers are written out in order
+        const int batch = 256;
+        lfXmlWriter *blocks = new lfXmlWriter [batch];
+        for (i = 0; lenses [i]; )
+        {
+            int n = 0;
+            while (n < batch && lenses [i + n])
+                n++;
+
+            #pragma omp parallel for schedule(dynamic, 4) if (n > 16)
+            for (j = 0; j < n; j++)
+                _lf_save_lens (blocks [j], lenses [i + j]);
 
-    /* Restore numeric format */
-    setlocale (LC_NUMERIC, old_numeric);
-    free(old_numeric);
+            for (j = 0; j < n; j++)
+            {
+                out.Write (blocks [j].Buffer->str, blocks [j].Buffer->len);
+                g_string_truncate (blocks [j].Buffer, 0);
+            }
+            i += n;
+        }
+        delete [] blocks;
+#else
+        for (i = 0; lenses [i]; i++)
+            _lf_save_lens (out, lenses [i]);
+#endif
+    }
 
-    return g_string_free (output, FALSE);
+    out.Write ("</lensdatabase>\n");
+}
+
+lfError lfDatabase::Save (const char *filename,
+                          const lfMount *const *mounts,
+                          const lfCamera *const *cameras,
+                          const lfLens *const *lenses) const
+{
+    lfCompression compression = _lf_compression_of_name (filename);
+    if (!_lf_compression_supported (compression))
+        return lfError (-ENOTSUP);
+
+    int fh = g_open (filename, O_CREAT | O_WRONLY | O_TRUNC | O_BINARY, 0666);
+    if (fh < 0)
+        return lfError (-errno);
+
+    // Streamed to the file, so that large databases never have to be
+    // held in memory as a whole
+    lfXmlWriter out (fh, compression);
+    _lf_save (out, mounts, cameras, lenses);
+    out.Finish ();
+
+    if (close (fh) && !out.Error)
+        out.Error = errno;
+
+    return out.Error ? lfError (-out.Error) : LF_NO_ERROR;
+}
+
+char *lfDatabase::Save (const lfMount *const *mounts,
+                        const lfCamera *const *cameras,
+                        const lfLens *const *lenses)
+{
+    lfXmlWriter out;
+    _lf_save (out, mounts, cameras, lenses);
+    return out.Steal ();
 }
 
 static gint __find_camera_compare (gconstpointer a, gconstpointer b)
@@ -1216,15 +2334,16 @@ const lfCamera **lfDatabase::FindCamerasExt (const char *maker, const char *mode
 
     GPtrArray *ret = g_ptr_array_new ();
 
-    lfFuzzyStrCmp fcmaker (maker, (sflags & LF_SEARCH_LOOSE) == 0);
-    lfFuzzyStrCmp fcmodel (model, (sflags & LF_SEARCH_LOOSE) == 0);
+    lfTokenTable *tokens = ((lfArena *)Arena)->GetTokens ();
+    lfFuzzyStrCmp fcmaker (maker, (sflags & LF_SEARCH_LOOSE) == 0, tokens);
+    lfFuzzyStrCmp fcmodel (model, (sflags & LF_SEARCH_LOOSE) == 0, tokens);
 
     for (size_t i = 0; i < ((GPtrArray *)Cameras)->len - 1; i++)
     {
         lfCamera *dbcam = static_cast<lfCamera *> (g_ptr_array_index ((GPtrArray *)Cameras, i));
         int score1 = 0, score2 = 0;
-        if ((!maker || (score1 = fcmaker.Compare (dbcam->Maker))) &&
-            (!model || (score2 = fcmodel.Compare (dbcam->Model))))
+        if ((!maker || (score1 = fcmaker.Compare (dbcam->Maker, dbcam->MakerTokens))) &&
+            (!model || (score2 = fcmodel.Compare (dbcam->Model, dbcam->ModelTokens))))
         {
             dbcam->Score = score1 + score2;
             _lf_ptr_array_insert_sorted (ret, dbcam, _lf_compare_camera_score);
@@ -1317,7 +2436,8 @@ const lfLens **lfDatabase::FindLenses (const lfLens *lens, int sflags) const
     GPtrArray *ret = g_ptr_array_new ();
     GPtrArray *mounts = g_ptr_array_new ();
 
-    lfFuzzyStrCmp fc (lens->Model, (sflags & LF_SEARCH_LOOSE) == 0);
+    lfFuzzyStrCmp fc (lens->Model, (sflags & LF_SEARCH_LOOSE) == 0,
+                      ((lfArena *)Arena)->GetTokens ());
 
     // Create a list of compatible mounts
     if (lens->Mounts)
@@ -1386,7 +2506,28 @@ const char *lfDatabase::MountName (const char *mount) const
     const lfMount *m = FindMount (mount);
     if (!m)
         return mount;
-    return lf_mlstr_get (m->Name);
+    return MLstrGet (m->Name);
+}
+
+void lfDatabase::SetLanguage (const char *lang)
+{
+    lfNameTable *table = (lfNameTable *)Names;
+    if (lang)
+        g_strlcpy (table->Lang, lang, sizeof (table->Lang));
+    else
+        _lf_get_lang (table->Lang, sizeof (table->Lang));
+    UpdateNames ();
+}
+
+const char *lfDatabase::MLstrGet (const lfMLstr str) const
+{
+    if (!str || !*(strchr (str, 0) + 1))
+        return str;
+
+    // Objects added after the last Load are not in the table
+    const lfNameTable *table = (const lfNameTable *)Names;
+    const char *ret = (const char *)g_hash_table_lookup (table->Names, str);
+    return ret ? ret : _lf_mlstr_get_lang (str, table->Lang);
 }
 
 const lfMount * const *lfDatabase::GetMounts () const
@@ -1394,22 +2535,162 @@ const lfMount * const *lfDatabase::GetMounts () const
     return (lfMount **)((GPtrArray *)Mounts)->pdata;
 }
 
+void lfDatabase::SetLoadFlags (int flags)
+{
+    LoadFlags = flags;
+}
+
+void lfDatabase::SetLoadFilter (const char *const *makers, const char *const *mounts)
+{
+    _lf_filter_free ((lfLoadFilter *)Filter);
+    Filter = NULL;
+    if (!makers && !mounts)
+        return;
+
+    lfLoadFilter *filter = g_new0 (lfLoadFilter, 1);
+    if (makers)
+        for (int i = 0; makers [i]; i++)
+            _lf_addstr (&filter->Makers, makers [i]);
+    if (mounts)
+        for (int i = 0; mounts [i]; i++)
+            _lf_addstr (&filter->Mounts, mounts [i]);
+    filter->Wanted = g_ptr_array_new ();
+    Filter = filter;
+}
+
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+static GMutex _lf_lazy_lock;
+#define LAZY_LOCK() g_mutex_lock (&_lf_lazy_lock)
+#define LAZY_UNLOCK() g_mutex_unlock (&_lf_lazy_lock)
+#else
+static GStaticMutex _lf_lazy_lock = G_STATIC_MUTEX_INIT;
+#define LAZY_LOCK() g_static_mutex_lock (&_lf_lazy_lock)
+#define LAZY_UNLOCK() g_static_mutex_unlock (&_lf_lazy_lock)
+#endif
+
+/* Read a <calibration> element from a database file again */
+static gchar *_lf_read_calibrations (const lfLazyCalibrations *lazy)
+{
+    gchar *data = NULL;
+    int fh = g_open (lazy->ErrContext, O_RDONLY | O_BINARY, 0);
+    if (fh >= 0)
+    {
+        data = (gchar *)g_malloc (lazy->Size);
+        if (lseek (fh, lazy->Offset, SEEK_SET) < 0 ||
+            (gsize)read (fh, data, lazy->Size) != lazy->Size ||
+            _lf_calibrations_checksum (data, lazy->Size) != lazy->Checksum)
+        {
+            g_free (data);
+            data = NULL;
+        }
+        close (fh);
+    }
+
+    if (!data)
+        g_warning ("[Lensfun] %s: cannot read calibration data again, "
+                   "the file has changed", lazy->ErrContext);
+    return data;
+}
+
+void _lf_lens_load_calibrations (const lfLens *lens)
+{
+    LAZY_LOCK ();
+
+    lfLazyCalibrations *lazy = (lfLazyCalibrations *)lens->LazyCalibrations;
+    if (lazy)
+    {
+        // The parser changes the text, so it works on a copy
+        gchar *data;
+        if (lazy->Data)
+        {
+            data = (gchar *)g_malloc (lazy->Size);
+            memcpy (data, lazy->Data, lazy->Size);
+        }
+        else
+            data = _lf_read_calibrations (lazy);
+
+        if (data)
+        {
+            // Database lenses live in the arena, so parse into a temporary
+            // lens and copy the lists over
+            lfLens temp;
+            temp.Model = lens->Model;
+            if (_lf_parse_calibrations (&temp, lazy->ErrContext, data, lazy->Size))
+                _lf_arena_calibrations (lazy->Arena, const_cast<lfLens *> (lens), &temp);
+            temp.Model = NULL;
+        }
+        g_free (data);
+
+        g_atomic_pointer_set (&const_cast<lfLens *> (lens)->LazyCalibrations, NULL);
+    }
+
+    LAZY_UNLOCK ();
+}
+
 void lfDatabase::AddMount (lfMount *mount)
 {
     _lf_ptr_array_insert_unique (
-        (GPtrArray *)Mounts, mount, _lf_mount_compare, (GDestroyNotify)lf_mount_destroy);
+        (GPtrArray *)Mounts, mount, _lf_mount_compare, _lf_db_destroy_mount, Arena);
 }
 
 void lfDatabase::AddCamera (lfCamera *camera)
 {
+    // Split the names once here instead of in every search.  The tokens of
+    // objects in the arena are allocated there as well.
+    lfArena *arena = (lfArena *)Arena;
+    lfTokenTable *tokens = arena->GetTokens ();
+    if (!arena->Owns (camera))
+    {
+        g_free (camera->MakerTokens);
+        g_free (camera->ModelTokens);
+        arena = NULL;
+    }
+    camera->MakerTokens = _lf_tokenize_mlstr (tokens, camera->Maker, arena);
+    camera->ModelTokens = _lf_tokenize_mlstr (tokens, camera->Model, arena);
     _lf_ptr_array_insert_unique (
-        (GPtrArray *)Cameras, camera, _lf_camera_compare, (GDestroyNotify)lf_camera_destroy);
+        (GPtrArray *)Cameras, camera, _lf_camera_compare, _lf_db_destroy_camera, Arena);
 }
 
 void lfDatabase::AddLens (lfLens *lens)
 {
+    // See lfDatabase::AddCamera
+    lfArena *arena = (lfArena *)Arena;
+    lfTokenTable *tokens = arena->GetTokens ();
+    if (!arena->Owns (lens))
+    {
+        g_free (lens->ModelTokens);
+        arena = NULL;
+    }
+    lens->ModelTokens = _lf_tokenize_mlstr (tokens, lens->Model, arena);
     _lf_ptr_array_insert_unique (
-        (GPtrArray *)Lenses, lens, _lf_lens_compare, (GDestroyNotify)lf_lens_destroy);
+        (GPtrArray *)Lenses, lens, _lf_lens_compare, _lf_db_destroy_lens, Arena);
+}
+
+/* Append copies of all objects of another database, as if it was loaded
+   again.  They still have to be sorted with SortObjects.  The database must
+   not load its calibrations lazily. */
+void lfDatabase::Merge (const lfDatabase *db)
+{
+    lfArena *arena = (lfArena *)Arena;
+    GPtrArray *mounts = (GPtrArray *)Mounts;
+    GPtrArray *cameras = (GPtrArray *)Cameras;
+    GPtrArray *lenses = (GPtrArray *)Lenses;
+
+    // Remove the trailing NULL, see LoadData
+    g_ptr_array_remove_index_fast (mounts, mounts->len - 1);
+    g_ptr_array_remove_index_fast (cameras, cameras->len - 1);
+    g_ptr_array_remove_index_fast (lenses, lenses->len - 1);
+
+    for (const lfMount *const *mount = db->GetMounts (); *mount; mount++)
+        g_ptr_array_add (mounts, _lf_arena_mount (arena, *mount));
+    for (const lfCamera *const *camera = db->GetCameras (); *camera; camera++)
+        g_ptr_array_add (cameras, _lf_arena_camera (arena, *camera));
+    for (const lfLens *const *lens = db->GetLenses (); *lens; lens++)
+        g_ptr_array_add (lenses, _lf_arena_lens (arena, *lens));
+
+    g_ptr_array_add (mounts, NULL);
+    g_ptr_array_add (cameras, NULL);
+    g_ptr_array_add (lenses, NULL);
 }
 
 //---------------------------// The C interface //---------------------------//
@@ -1460,6 +2741,17 @@ lfError lf_db_load_data (lfDatabase *db, const char *errcontext,
     return db->Load (errcontext, data, data_size);
 }
 
+void lf_db_set_load_flags (lfDatabase *db, int flags)
+{
+    db->SetLoadFlags (flags);
+}
+
+void lf_db_set_load_filter (lfDatabase *db, const char *const *makers,
+                            const char *const *mounts)
+{
+    db->SetLoadFilter (makers, mounts);
+}
+
 lfError lf_db_save_all (const lfDatabase *db, const char *filename)
 {
     return db->Save (filename);
@@ -1523,6 +2815,16 @@ const char *lf_db_mount_name (const lfDatabase *db, const char *mount)
     return db->MountName (mount);
 }
 
+void lf_db_set_language (lfDatabase *db, const char *lang)
+{
+    db->SetLanguage (lang);
+}
+
+const char *lf_db_mlstr_get (const lfDatabase *db, const lfMLstr str)
+{
+    return db->MLstrGet (str);
+}
+
 const lfMount * const *lf_db_get_mounts (const lfDatabase *db)
 {
     return db->GetMounts ();
@@ -0,0 +1,48 @@
+# Compile the database files into a C++ source file for BUILD_EMBEDDED_DB.
+#
+# Usage: cmake -DDB_DIR=<data/db> -DOUTPUT=<file.cpp> -P embed-database.cmake
+#
+# Comments, the XML declaration, the DOCTYPE, and whitespace between tags
+# are dropped, which saves a fifth of the size.  Every file becomes a char
+# array, since string literals of this size are not portable.
+
+FILE(GLOB DB_FILES "${DB_DIR}/*.xml")
+LIST(SORT DB_FILES)
+FILE(READ "${DB_DIR}/timestamp.txt" DB_TIMESTAMP)
+STRING(STRIP "${DB_TIMESTAMP}" DB_TIMESTAMP)
+
+SET(SOURCE "/* Generated by embed-database.cmake from ${DB_DIR}, do not edit */\n\n")
+SET(SOURCE "${SOURCE}#include \"config.h\"\n#include \"lensfun.h\"\n#include \"lensfunprv.h\"\n")
+SET(TABLE "")
+SET(TOTAL 0)
+SET(INDEX 0)
+
+FOREACH(DB_FILE ${DB_FILES})
+  FILE(READ "${DB_FILE}" XML)
+  # CMake has no lazy quantifiers, so the comment body is spelled out such
+  # that it cannot contain "-->"; a comment may also end in "--->".
+  STRING(REGEX REPLACE "<!--([^-]|-[^-]|--+[^->])*--+>" "" XML "${XML}")
+  STRING(REGEX REPLACE "<[?!][^>]*>" "" XML "${XML}")
+  STRING(REGEX REPLACE ">[ \t\r\n]+<" "><" XML "${XML}")
+  STRING(STRIP "${XML}" XML)
+
+  # Go through a file to get at the bytes; string(HEX) needs CMake 3.18
+  FILE(WRITE "${OUTPUT}.tmp" "${XML}")
+  FILE(READ "${OUTPUT}.tmp" HEX HEX)
+  STRING(LENGTH "${HEX}" SIZE)
+  MATH(EXPR SIZE "${SIZE} / 2")
+  MATH(EXPR TOTAL "${TOTAL} + ${SIZE}")
+  STRING(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," HEX "${HEX}")
+  STRING(REGEX REPLACE "((0x..,){24})" "\\1\n" HEX "${HEX}")
+
+  GET_FILENAME_COMPONENT(NAME "${DB_FILE}" NAME)
+  SET(SOURCE "${SOURCE}\n/* ${NAME} */\nstatic const unsigned char _lf_db_${INDEX} [] = {\n${HEX}\n};\n")
+  SET(TABLE "${TABLE}    { \"${NAME}\", _lf_db_${INDEX}, ${SIZE} },\n")
+  MATH(EXPR INDEX "${INDEX} + 1")
+ENDFOREACH()
+FILE(REMOVE "${OUTPUT}.tmp")
+
+SET(SOURCE "${SOURCE}\nconst lfEmbeddedFile _lf_embedded_db [] =\n{\n${TABLE}    { NULL, NULL, 0 }\n};\n")
+SET(SOURCE "${SOURCE}\nconst long _lf_embedded_db_timestamp = ${DB_TIMESTAMP};\n")
+FILE(WRITE "${OUTPUT}" "${SOURCE}")
+MESSAGE(STATUS "Embedded ${INDEX} database files, ${TOTAL} bytes")
@@ -8,63 +8,143 @@
 #include "lensfunprv.h"
 #include <limits.h>
 #include <stdlib.h>
-#include <regex.h>
 #include <string.h>
-#include <locale.h>
 #include <math.h>
 #include "windows/mathconstants.h"
 #include <algorithm>
 
-static struct
+// The focal lengths and apertures are scanned from lens names like
+// "Canon EF 70-200mm f/2.8L" by hand.  The scanner accepts the same names
+// as the regular expressions it replaces; it keeps no state, so it is safe
+// to call from several threads, and does not depend on the locale.  The
+// patterns, ignoring case and tried in this order on the whole name:
+//
+//   ([[:space:]]+|^)([0-9]+[0-9.]*)(-[0-9]+[0-9.]*)?(mm)?[[:space:]]+(f/|f|1/|1:)?([0-9.]+)(-[0-9.]+)?
+//   [[:space:]]+1:([0-9.]+)(-[0-9.]+)?[[:space:]]+([0-9.]+)(-[0-9.]+)?(mm)?
+//   ([0-9.]+)(-[0-9.]+)?[[:space:]]*/[[:space:]]*([0-9.]+)(-[0-9.]+)?
+//
+// None of them needs to backtrack: every part ends with a character the
+// part itself cannot contain, so there is only one way to match at a given
+// start, and the first start which matches wins.
+
+static inline bool _lf_is_number_char (char c)
 {
-    const char *regex;
-    guchar matchidx [3];
-    bool compiled;
-    regex_t rex;
-} lens_name_regex [] =
+    return g_ascii_isdigit (c) || c == '.';
+}
+
+static const char *_lf_skip_number (const char *str)
 {
-    {
-        // [min focal]-[max focal]mm f/[min aperture]-[max aperture]
-        "([[:space:]]+|^)([0-9]+[0-9.]*)(-[0-9]+[0-9.]*)?(mm)?[[:space:]]+(f/|f|1/|1:)?([0-9.]+)(-[0-9.]+)?",
-        { 2, 3, 6 },
-        false
-    },
-    {
-        // 1:[min aperture]-[max aperture] [min focal]-[max focal]mm
-        "[[:space:]]+1:([0-9.]+)(-[0-9.]+)?[[:space:]]+([0-9.]+)(-[0-9.]+)?(mm)?",
-        { 3, 4, 1 },
-        false
-    },
-    {
-        // [min aperture]-[max aperture]/[min focal]-[max focal]
-        "([0-9.]+)(-[0-9.]+)?[[:space:]]*/[[:space:]]*([0-9.]+)(-[0-9.]+)?",
-        { 3, 4, 1 },
-        false
-    },
-};
+    while (_lf_is_number_char (*str))
+        str++;
+    return str;
+}
 
-static struct
+static const char *_lf_skip_space (const char *str)
 {
-    bool compiled;
-    regex_t rex;
-} extender_magnification_regex =
+    while (g_ascii_isspace (*str))
+        str++;
+    return str;
+}
+
+static float _lf_parse_float (const char *start, const char *end)
 {
-    false
-};
+    // Only digits and dots, so nothing but the number itself is parsed
+    char tmp [32];
+    size_t len = MIN (size_t (end - start), sizeof (tmp) - 1);
+    memcpy (tmp, start, len);
+    tmp [len] = 0;
+    return g_ascii_strtod (tmp, NULL);
+}
 
-static float _lf_parse_float (const char *model, const regmatch_t &match)
+/* [min focal]-[max focal]mm f/[min aperture]-[max aperture], at a word */
+static bool _lf_scan_focal_aperture (const char *str,
+                                     float &minf, float &maxf, float &mina)
 {
-    char tmp [100];
-    const char *src = model + match.rm_so;
-    int len = match.rm_eo - match.rm_so;
+    const char *minf_end = _lf_skip_number (str);
+    const char *maxf_start = NULL, *cur = minf_end;
+    if (*cur == '-')
+    {
+        if (!g_ascii_isdigit (cur [1]))
+            return false;
+        maxf_start = cur + 1;
+        cur = _lf_skip_number (maxf_start);
+    }
+    const char *maxf_end = cur;
+    if (g_ascii_tolower (cur [0]) == 'm' && g_ascii_tolower (cur [1]) == 'm')
+        cur += 2;
+    if (!g_ascii_isspace (*cur))
+        return false;
+    cur = _lf_skip_space (cur);
+
+    if (g_ascii_tolower (*cur) == 'f')
+        cur += cur [1] == '/' ? 2 : 1;
+    else if (cur [0] == '1' && (cur [1] == '/' || cur [1] == ':') &&
+             _lf_is_number_char (cur [2]))
+        cur += 2;
+    if (!_lf_is_number_char (*cur))
+        return false;
 
-    // Skip '-' since it's not a minus sign but rather the separator
-    if (*src == '-')
-        src++, len--;
-    strncpy (tmp, src, len);
-    tmp [len] = 0;
+    minf = _lf_parse_float (str, minf_end);
+    if (maxf_start)
+        maxf = _lf_parse_float (maxf_start, maxf_end);
+    mina = _lf_parse_float (cur, _lf_skip_number (cur));
+    return true;
+}
 
-    return atof (tmp);
+/* 1:[min aperture]-[max aperture] [min focal]-[max focal]mm, at the "1:" */
+static bool _lf_scan_ratio_focal (const char *str,
+                                  float &minf, float &maxf, float &mina)
+{
+    const char *mina_start = str + 2;
+    const char *mina_end = _lf_skip_number (mina_start);
+    if (mina_end == mina_start)
+        return false;
+    const char *cur = mina_end;
+    if (*cur == '-')
+    {
+        if (!_lf_is_number_char (cur [1]))
+            return false;
+        cur = _lf_skip_number (cur + 1);
+    }
+    if (!g_ascii_isspace (*cur))
+        return false;
+    const char *minf_start = _lf_skip_space (cur);
+    const char *minf_end = _lf_skip_number (minf_start);
+    if (minf_end == minf_start)
+        return false;
+
+    minf = _lf_parse_float (minf_start, minf_end);
+    if (*minf_end == '-' && _lf_is_number_char (minf_end [1]))
+        maxf = _lf_parse_float (minf_end + 1, _lf_skip_number (minf_end + 1));
+    mina = _lf_parse_float (mina_start, mina_end);
+    return true;
+}
+
+/* [min aperture]-[max aperture]/[min focal]-[max focal], at a number */
+static bool _lf_scan_aperture_focal (const char *str,
+                                     float &minf, float &maxf, float &mina)
+{
+    const char *mina_end = _lf_skip_number (str);
+    const char *cur = mina_end;
+    if (*cur == '-')
+    {
+        if (!_lf_is_number_char (cur [1]))
+            return false;
+        cur = _lf_skip_number (cur + 1);
+    }
+    cur = _lf_skip_space (cur);
+    if (*cur != '/')
+        return false;
+    const char *minf_start = _lf_skip_space (cur + 1);
+    const char *minf_end = _lf_skip_number (minf_start);
+    if (minf_end == minf_start)
+        return false;
+
+    minf = _lf_parse_float (minf_start, minf_end);
+    if (*minf_end == '-' && _lf_is_number_char (minf_end [1]))
+        maxf = _lf_parse_float (minf_end + 1, _lf_skip_number (minf_end + 1));
+    mina = _lf_parse_float (str, mina_end);
+    return true;
 }
 
 static bool _lf_parse_lens_name (const char *model,
@@ -74,46 +154,35 @@ static bool _lf_parse_lens_name (const char *model,
     if (!model)
         return false;
 
-    for (size_t i = 0; i < ARRAY_LEN (lens_name_regex); i++)
-    {
-        if (!lens_name_regex [i].compiled)
-        {
-            regcomp (&lens_name_regex [i].rex, lens_name_regex [i].regex,
-                     REG_EXTENDED | REG_ICASE);
-            lens_name_regex [i].compiled = true;
-        }
-
-        regmatch_t matches [10];
-        if (regexec (&lens_name_regex [i].rex, model, 10, matches, 0))
-            continue;
-
-        guchar *matchidx = lens_name_regex [i].matchidx;
-        if (matches [matchidx [0]].rm_so != -1)
-            minf = _lf_parse_float (model, matches [matchidx [0]]);
-        if (matches [matchidx [1]].rm_so != -1)
-            maxf = _lf_parse_float (model, matches [matchidx [1]]);
-        if (matches [matchidx [2]].rm_so != -1)
-            mina = _lf_parse_float (model, matches [matchidx [2]]);
-        return true;
-    }
+    const char *cur;
+    for (cur = model; *cur; cur++)
+        if (g_ascii_isdigit (*cur) && (cur == model || g_ascii_isspace (cur [-1])) &&
+            _lf_scan_focal_aperture (cur, minf, maxf, mina))
+            return true;
+    for (cur = model; *cur; cur++)
+        if (cur [0] == '1' && cur [1] == ':' && cur != model && g_ascii_isspace (cur [-1]) &&
+            _lf_scan_ratio_focal (cur, minf, maxf, mina))
+            return true;
+    // A match inside a number would match from its first character as well
+    for (cur = model; *cur; cur++)
+        if (_lf_is_number_char (*cur) && (cur == model || !_lf_is_number_char (cur [-1])) &&
+            _lf_scan_aperture_focal (cur, minf, maxf, mina))
+            return true;
 
     return false;
 }
 
-static void _lf_free_lens_regex ()
+/* A digit directly followed by "x", as in "1.4x" */
+static bool _lf_has_magnification (const char *model)
 {
-    for (size_t i = 0; i < ARRAY_LEN (lens_name_regex); i++)
-        if (lens_name_regex [i].compiled)
-        {
-            regfree (&lens_name_regex [i].rex);
-            lens_name_regex [i].compiled = false;
-        }
+    for (const char *cur = model; *cur; cur++)
+        if (g_ascii_isdigit (cur [0]) && g_ascii_tolower (cur [1]) == 'x')
+            return true;
+    return false;
 }
 
 //------------------------------------------------------------------------//
 
-static int _lf_lens_regex_refs = 0;
-
 lfLens::lfLens ()
 {
     // Defaults for attributes are "unknown" (mostly 0).  Otherwise, ad hoc
@@ -122,27 +191,43 @@ lfLens::lfLens ()
     // reading the database.
     memset (this, 0, sizeof (*this));
     Type = LF_UNKNOWN;
-    _lf_lens_regex_refs++;
 }
 
 lfLens::~lfLens ()
 {
     lf_free (Maker);
     lf_free (Model);
+    g_free (ModelTokens);
     _lf_list_free ((void **)Mounts);
-    _lf_list_free ((void **)CalibDistortion);
-    _lf_list_free ((void **)CalibTCA);
-    _lf_list_free ((void **)CalibVignetting);
-    _lf_list_free ((void **)CalibCrop);
-    _lf_list_free ((void **)CalibFov);
-    if (!--_lf_lens_regex_refs)
-        _lf_free_lens_regex ();
+    g_free (CalibDistortion);
+    g_free (CalibTCA);
+    g_free (CalibVignetting);
+    g_free (CalibCrop);
+    g_free (CalibFov);
+}
+
+static void _lf_copy_calibrations (lfLens *dest, const lfLens &other)
+{
+    // Every list is one block, so this copies the records at once
+    dest->CalibDistortion = (lfLensCalibDistortion **)_lf_duprec (
+        (void *const *)other.CalibDistortion, sizeof (lfLensCalibDistortion));
+    dest->CalibTCA = (lfLensCalibTCA **)_lf_duprec (
+        (void *const *)other.CalibTCA, sizeof (lfLensCalibTCA));
+    dest->CalibVignetting = (lfLensCalibVignetting **)_lf_duprec (
+        (void *const *)other.CalibVignetting, sizeof (lfLensCalibVignetting));
+    dest->CalibCrop = (lfLensCalibCrop **)_lf_duprec (
+        (void *const *)other.CalibCrop, sizeof (lfLensCalibCrop));
+    dest->CalibFov = (lfLensCalibFov **)_lf_duprec (
+        (void *const *)other.CalibFov, sizeof (lfLensCalibFov));
 }
 
 lfLens::lfLens (const lfLens &other)
 {
+    _lf_lens_need_calibrations (&other);
     Maker = lf_mlstr_dup (other.Maker);
     Model = lf_mlstr_dup (other.Model);
+    ModelTokens = NULL;
+    LazyCalibrations = NULL;
     MinFocal = other.MinFocal;
     MaxFocal = other.MaxFocal;
     MinAperture = other.MinAperture;
@@ -159,34 +244,19 @@ lfLens::lfLens (const lfLens &other)
     AspectRatio = other.AspectRatio;
     Type = other.Type;
 
-    CalibDistortion = NULL;
-    if (other.CalibDistortion)
-        for (int i = 0; other.CalibDistortion [i]; i++)
-            AddCalibDistortion (other.CalibDistortion [i]);
-    CalibTCA = NULL;
-    if (other.CalibTCA)
-        for (int i = 0; other.CalibTCA [i]; i++)
-            AddCalibTCA (other.CalibTCA [i]);
-    CalibVignetting = NULL;
-    if (other.CalibVignetting)
-        for (int i = 0; other.CalibVignetting [i]; i++)
-            AddCalibVignetting (other.CalibVignetting [i]);
-    CalibCrop = NULL;
-    if (other.CalibCrop)
-        for (int i = 0; other.CalibCrop [i]; i++)
-            AddCalibCrop (other.CalibCrop [i]);
-    CalibFov = NULL;
-    if (other.CalibFov)
-        for (int i = 0; other.CalibFov [i]; i++)
-            AddCalibFov (other.CalibFov [i]);
+    _lf_copy_calibrations (this, other);
 }
 
 lfLens &lfLens::operator = (const lfLens &other)
 {
+    _lf_lens_need_calibrations (&other);
     lf_free (Maker);
     Maker = lf_mlstr_dup (other.Maker);
     lf_free (Model);
     Model = lf_mlstr_dup (other.Model);
+    g_free (ModelTokens);
+    ModelTokens = NULL;
+    LazyCalibrations = NULL;
     MinFocal = other.MinFocal;
     MaxFocal = other.MaxFocal;
     MinAperture = other.MinAperture;
@@ -203,26 +273,15 @@ lfLens &lfLens::operator = (const lfLens &other)
     AspectRatio = other.AspectRatio;
     Type = other.Type;
 
-    lf_free (CalibDistortion); CalibDistortion = NULL;
-    if (other.CalibDistortion)
-        for (int i = 0; other.CalibDistortion [i]; i++)
-            AddCalibDistortion (other.CalibDistortion [i]);
-    lf_free (CalibTCA); CalibTCA = NULL;
-    if (other.CalibTCA)
-        for (int i = 0; other.CalibTCA [i]; i++)
-            AddCalibTCA (other.CalibTCA [i]);
-    lf_free (CalibVignetting); CalibVignetting = NULL;
-    if (other.CalibVignetting)
-        for (int i = 0; other.CalibVignetting [i]; i++)
-            AddCalibVignetting (other.CalibVignetting [i]);
-    lf_free (CalibCrop); CalibCrop = NULL;
-    if (other.CalibCrop)
-        for (int i = 0; other.CalibCrop [i]; i++)
-            AddCalibCrop (other.CalibCrop [i]);
-    lf_free (CalibFov); CalibFov = NULL;
-    if (other.CalibFov)
-        for (int i = 0; other.CalibFov [i]; i++)
-            AddCalibFov (other.CalibFov [i]);
+    if (this != &other)
+    {
+        g_free (CalibDistortion);
+        g_free (CalibTCA);
+        g_free (CalibVignetting);
+        g_free (CalibCrop);
+        g_free (CalibFov);
+        _lf_copy_calibrations (this, other);
+    }
 
     return *this;
 }
@@ -235,6 +294,8 @@ void lfLens::SetMaker (const char *val, const char *lang)
 void lfLens::SetModel (const char *val, const char *lang)
 {
     Model = lf_mlstr_add (Model, lang, val);
+    g_free (ModelTokens);
+    ModelTokens = NULL;
 }
 
 void lfLens::AddMount (const char *val)
@@ -245,27 +306,16 @@ void lfLens::AddMount (const char *val)
 
 void lfLens::GuessParameters ()
 {
-    if (!extender_magnification_regex.compiled)
-    {
-        regcomp (&extender_magnification_regex.rex, "[0-9](\\.[0.9]+)?x",
-                 REG_EXTENDED | REG_ICASE);
-        extender_magnification_regex.compiled = true;
-    }
-
     float minf = float (INT_MAX), maxf = float (INT_MIN);
     float mina = float (INT_MAX), maxa = float (INT_MIN);
 
-    char *old_numeric = setlocale (LC_NUMERIC, NULL);
-    old_numeric = strdup (old_numeric);
-    setlocale (LC_NUMERIC, "C");
-
     if (Model && (!MinAperture || !MinFocal) &&
         !strstr (Model, "adapter") &&
         !strstr (Model, "reducer") &&
         !strstr (Model, "booster") &&
         !strstr (Model, "extender") &&
         !strstr (Model, "converter") &&
-        regexec (&extender_magnification_regex.rex, Model, 0, NULL, 0))
+        !_lf_has_magnification (Model))
         _lf_parse_lens_name (Model, minf, maxf, mina);
 
     if (!MinAperture || !MinFocal)
@@ -322,6 +372,21 @@ void lfLens::GuessParameters ()
                     maxf = f;
             }
 
+        // Calibration data not loaded yet, see LF_LOAD_LAZY_CALIBRATIONS
+        const lfLazyCalibrations *lazy =
+            (const lfLazyCalibrations *)g_atomic_pointer_get (&LazyCalibrations);
+        if (lazy)
+        {
+            if (lazy->MinFocal < minf)
+                minf = lazy->MinFocal;
+            if (lazy->MaxFocal > maxf)
+                maxf = lazy->MaxFocal;
+            if (lazy->MinAperture < mina)
+                mina = lazy->MinAperture;
+            if (lazy->MaxAperture > maxa)
+                maxa = lazy->MaxAperture;
+        }
+
     }
 
     if (minf != INT_MAX && !MinFocal)
@@ -335,9 +400,6 @@ void lfLens::GuessParameters ()
 
     if (!MaxFocal)
         MaxFocal = MinFocal;
-
-    setlocale (LC_NUMERIC, old_numeric);
-    free (old_numeric);
 }
 
 bool lfLens::Check ()
@@ -708,7 +770,7 @@ void lfLens::AddCalibDistortion (const lfLensCalibDistortion *dc)
         lfLensCalibDistortion ***cd;
         void ***arr;
     } x = { &CalibDistortion };
-    _lf_addobj (x.arr, dc, sizeof (*dc), cmp_distortion);
+    _lf_addrec (x.arr, dc, sizeof (*dc), cmp_distortion);
 }
 
 bool lfLens::RemoveCalibDistortion (int idx)
@@ -719,7 +781,7 @@ bool lfLens::RemoveCalibDistortion (int idx)
         lfLensCalibDistortion ***cd;
         void ***arr;
     } x = { &CalibDistortion };
-    return _lf_delobj (x.arr, idx);
+    return _lf_delrec (x.arr, idx, sizeof (lfLensCalibDistortion));
 }
 
 static bool cmp_tca (const void *x1, const void *x2)
@@ -737,7 +799,7 @@ void lfLens::AddCalibTCA (const lfLensCalibTCA *tcac)
         lfLensCalibTCA ***ctca;
         void ***arr;
     } x = { &CalibTCA };
-    _lf_addobj (x.arr, tcac, sizeof (*tcac), cmp_tca);
+    _lf_addrec (x.arr, tcac, sizeof (*tcac), cmp_tca);
 }
 
 bool lfLens::RemoveCalibTCA (int idx)
@@ -748,7 +810,7 @@ bool lfLens::RemoveCalibTCA (int idx)
         lfLensCalibTCA ***ctca;
         void ***arr;
     } x = { &CalibTCA };
-    return _lf_delobj (x.arr, idx);
+    return _lf_delrec (x.arr, idx, sizeof (lfLensCalibTCA));
 }
 
 static bool cmp_vignetting (const void *x1, const void *x2)
@@ -768,7 +830,7 @@ void lfLens::AddCalibVignetting (const lfLensCalibVignetting *vc)
         lfLensCalibVignetting ***cv;
         void ***arr;
     } x = { &CalibVignetting };
-    _lf_addobj (x.arr, vc, sizeof (*vc), cmp_vignetting);
+    _lf_addrec (x.arr, vc, sizeof (*vc), cmp_vignetting);
 }
 
 bool lfLens::RemoveCalibVignetting (int idx)
@@ -779,7 +841,7 @@ bool lfLens::RemoveCalibVignetting (int idx)
         lfLensCalibVignetting ***cv;
         void ***arr;
     } x = { &CalibVignetting };
-    return _lf_delobj (x.arr, idx);
+    return _lf_delrec (x.arr, idx, sizeof (lfLensCalibVignetting));
 }
 
 static bool cmp_lenscrop (const void *x1, const void *x2)
@@ -797,7 +859,7 @@ void lfLens::AddCalibCrop (const lfLensCalibCrop *lcc)
         lfLensCalibCrop ***cd;
         void ***arr;
     } x = { &CalibCrop };
-    _lf_addobj (x.arr, lcc, sizeof (*lcc), cmp_lenscrop);
+    _lf_addrec (x.arr, lcc, sizeof (*lcc), cmp_lenscrop);
 }
 
 bool lfLens::RemoveCalibCrop (int idx)
@@ -808,7 +870,7 @@ bool lfLens::RemoveCalibCrop (int idx)
         lfLensCalibCrop ***cd;
         void ***arr;
     } x = { &CalibCrop };
-    return _lf_delobj (x.arr, idx);
+    return _lf_delrec (x.arr, idx, sizeof (lfLensCalibCrop));
 }
 
 static bool cmp_lensfov (const void *x1, const void *x2)
@@ -826,7 +888,7 @@ void lfLens::AddCalibFov (const lfLensCalibFov *lcf)
         lfLensCalibFov ***cd;
         void ***arr;
     } x = { &CalibFov };
-    _lf_addobj (x.arr, lcf, sizeof (*lcf), cmp_lensfov);
+    _lf_addrec (x.arr, lcf, sizeof (*lcf), cmp_lensfov);
 }
 
 bool lfLens::RemoveCalibFov (int idx)
@@ -837,7 +899,7 @@ bool lfLens::RemoveCalibFov (int idx)
         lfLensCalibFov ***cd;
         void ***arr;
     } x = { &CalibFov };
-    return _lf_delobj (x.arr, idx);
+    return _lf_delrec (x.arr, idx, sizeof (lfLensCalibFov));
 }
 
 static int __insert_spline (void **spline, float *spline_dist, float dist, void *val)
@@ -1001,6 +1063,7 @@ static void __parameter_scales (float values [], int number_of_values,
 
 bool lfLens::InterpolateDistortion (float focal, lfLensCalibDistortion &res) const
 {
+    _lf_lens_need_calibrations (this);
     if (!CalibDistortion)
         return false;
 
@@ -1080,6 +1143,7 @@ bool lfLens::InterpolateDistortion (float focal, lfLensCalibDistortion &res) con
 
 bool lfLens::InterpolateTCA (float focal, lfLensCalibTCA &res) const
 {
+    _lf_lens_need_calibrations (this);
     if (!CalibTCA)
         return false;
 
@@ -1177,6 +1241,7 @@ static float __vignetting_dist (
 bool lfLens::InterpolateVignetting (
     float focal, float aperture, float distance, lfLensCalibVignetting &res) const
 {
+    _lf_lens_need_calibrations (this);
     if (!CalibVignetting)
         return false;
 
@@ -1244,6 +1309,7 @@ bool lfLens::InterpolateVignetting (
 
 bool lfLens::InterpolateCrop (float focal, lfLensCalibCrop &res) const
 {
+    _lf_lens_need_calibrations (this);
     if (!CalibCrop)
         return false;
 
@@ -1312,6 +1378,7 @@ bool lfLens::InterpolateCrop (float focal, lfLensCalibCrop &res) const
 
 bool lfLens::InterpolateFov (float focal, lfLensCalibFov &res) const
 {
+    _lf_lens_need_calibrations (this);
     if (!CalibFov)
         return false;
 
@@ -1543,7 +1610,7 @@ int _lf_lens_compare_score (const lfLens *pattern, const lfLens *match,
     // And now the most complex part - compare models
     if (pattern->Model && match->Model)
     {
-        int _score = fuzzycmp->Compare (match->Model);
+        int _score = fuzzycmp->Compare (match->Model, match->ModelTokens);
         if (!_score)
             return 0; // Model does not match
         _score = (_score * 4) / 10;
@@ -8,6 +8,7 @@
 
 #include <glib.h>
 #include <string.h>
+#include <math.h>
 #include <vector>
 
 #define MEMBER_OFFSET(s,f)   ((unsigned int)(char *)&((s *)0)->f)
@@ -117,12 +118,36 @@ extern int _lf_ptr_array_insert_sorted (
  * @param compare
  *     The function to compare two items.
  * @param dest
- *     The function to destroy old duplicate item (if found).
+ *     The function to destroy old duplicate item (if found).  It gets the
+ *     item and @a user_data.
+ * @param user_data
+ *     Passed to @a dest.
  * @return
  *     The index at which the item was inserted.
  */
 extern int _lf_ptr_array_insert_unique (
-    GPtrArray *array, void *item, GCompareFunc compare, GDestroyNotify dest);
+    GPtrArray *array, void *item, GCompareFunc compare, GFunc dest,
+    gpointer user_data);
+
+/**
+ * @brief Sort the items appended to a sorted GPtrArray into it.
+ *
+ * This has the same result as inserting the appended items one by one
+ * with _lf_ptr_array_insert_unique(), in the order they were appended,
+ * but takes O(n + k log k) time for k appended items instead of O(n k).
+ * @param array
+ *     The array, sorted and without duplicates except for the items added
+ *     to its end with g_ptr_array_add() (before the trailing NULL, if any).
+ * @param compare
+ *     The function to compare two items.
+ * @param dest
+ *     The function to destroy items which are overridden by an equal item
+ *     appended later.  It gets the item and @a user_data.
+ * @param user_data
+ *     Passed to @a dest.
+ */
+extern void _lf_ptr_array_sort_unique (
+    GPtrArray *array, GCompareFunc compare, GFunc dest, gpointer user_data);
 
 /**
  * @brief Find a item in a sorted array.
@@ -170,36 +195,51 @@ extern void _lf_addobj (void ***var, const void *val, size_t val_size,
 extern bool _lf_delobj (void ***var, int idx);
 
 /**
- * @brief Appends a formatted string to a dynamically-growing string
- * using g_markup_printf_escaped() internally.
- * @param output
- *     The output array.
- * @param format
- *     The format string.
+ * @brief Add a record to a contiguous list of records.
+ *
+ * Unlike _lf_addobj(), the NULL-terminated array of pointers and the
+ * records it points to are a single memory block, with the records
+ * following each other.  Room for further records is reserved, so most
+ * calls do not allocate memory.  Free the list with g_free().
+ * @param var
+ *     A pointer to a list of records.
+ * @param val
+ *     The record to be added to the list.
+ * @param val_size
+ *     The size of the record in bytes.
+ * @param cmpf
+ *     An auxiliary function which, if not NULL, should return true if two
+ *     records are similar; a similar record is overwritten by the new one.
  */
-extern void _lf_xml_printf (GString *output, const char *format, ...);
+extern void _lf_addrec (void ***var, const void *val, size_t val_size,
+    bool (*cmpf) (const void *, const void *));
 
 /**
- * @brief Output a multi-language value to output string.
- *
- * Outputs a number of lines which looks like:
- *
- * \Verbatim
- * ${prefix}<${element}>${val}</${element}>
- * ${prefix}<${element} lang="xxx">${val[xxx]}</${element}>
- * ...
- * \EndVerbatim
- * @param output
- *     The output array.
- * @param prefix
- *     The prefix at the start of every line of output.
- * @param element
- *     The name of the element to output.
- * @param val
- *     The value of the multi-language string.
+ * @brief Remove a record from a list created by _lf_addrec().
+ * @param var
+ *     A pointer to a list of records.  It becomes NULL when the last
+ *     record is removed.
+ * @param idx
+ *     The index of the record to remove (zero-based).
+ * @param val_size
+ *     The size of a record in bytes.
+ * @return
+ *     false if idx is out of range.
  */
-extern void _lf_xml_printf_mlstr (GString *output, const char *prefix,
-                                  const char *element, const lfMLstr val);
+extern bool _lf_delrec (void ***var, int idx, size_t val_size);
+
+/**
+ * @brief Copy a NULL-terminated list of records into a new list in the
+ * format of _lf_addrec().
+ * @param list
+ *     The list of records, may be NULL.
+ * @param val_size
+ *     The size of a record in bytes.
+ * @return
+ *     The new list; if the records of @a list lie next to each other, they
+ *     are copied at once.
+ */
+extern void **_lf_duprec (void *const *list, size_t val_size);
 
 /**
  * @brief Get the XML id of the given distortion model
@@ -228,6 +268,29 @@ extern int _lf_strcmp (const char *s1, const char *s2);
  */
 extern int _lf_mlstrcmp (const char *s1, const lfMLstr s2);
 
+/**
+ * @brief Get the language code of LC_MESSAGES, e.g. "de".
+ *
+ * "en" is returned if the locale does not name a language.  Unlike a
+ * static buffer, this may be called from several threads at once.
+ * @param lang
+ *     The buffer for the language code.
+ * @param size
+ *     The size of @a lang, at least 3 bytes.
+ */
+extern void _lf_get_lang (char *lang, size_t size);
+
+/**
+ * @brief Same as lf_mlstr_get(), but for a given language.
+ * @param str
+ *     The multi-language string, may be NULL.
+ * @param lang
+ *     The language code, e.g. "de".
+ * @return
+ *     The translation to @a lang, else the English or the default string.
+ */
+extern const char *_lf_mlstr_get_lang (const lfMLstr str, const char *lang);
+
 /**
  * @brief Comparison function for mount sorting and finding.
  *
@@ -374,8 +437,568 @@ enum
 /**
  * @brief Detect supported CPU features (used for runtime selection of accelerated
  * functions for specific architecture extensions).
+ *
+ * Exported for the benchmarks like _lf_set_cpu_features_mask().
+ */
+LF_EXPORT guint _lf_detect_cpu_features ();
+
+/**
+ * @brief Restrict the CPU features reported by _lf_detect_cpu_features().
+ *
+ * This is meant for benchmarks and tests which compare the accelerated
+ * functions with the plain ones.  Only modifiers initialised afterwards are
+ * affected.  It is exported from the shared library for them, but it is not
+ * part of the public API.
+ * @param mask
+ *     The LF_CPU_FLAG_XXX flags that may be reported; ~0 restores the default.
+ */
+LF_EXPORT void _lf_set_cpu_features_mask (guint mask);
+
+/**
+ * @brief Choose the main database directory that lfDatabase::Load() reads.
+ *
+ * This is the one with the newest timestamp among the system location,
+ * the system updates location, and @a user_updates.
+ * @param user_updates
+ *     The directory of automatic updates in the home directory.
+ * @return
+ *     One of the directories.
+ */
+extern const char *_lf_db_main_location (const char *user_updates);
+
+#ifdef EMBEDDED_DB
+/// A database file compiled into the library, see BUILD_EMBEDDED_DB
+struct lfEmbeddedFile
+{
+    /// The file name, used as the error context
+    const char *Name;
+    /// The XML, without comments and whitespace between tags
+    const unsigned char *Data;
+    size_t Size;
+};
+
+/// The files of data/db, terminated by an entry without a name
+extern const lfEmbeddedFile _lf_embedded_db [];
+/// The contents of data/db/timestamp.txt
+extern const long _lf_embedded_db_timestamp;
+#endif
+
+/**
+ * @brief List the database files which lfDatabase::Load would read.
+ * @param files
+ *     The newly allocated file names are appended to this array.
+ * @param pathname
+ *     A database file, or a directory of XML files.
+ */
+extern void _lf_list_database_files (GPtrArray *files, const char *pathname);
+
+/**
+ * @brief Return the size of a multi-language string in bytes.
+ * @param str
+ *     The multi-language string, may be NULL.
+ * @return
+ *     The number of bytes including the closing zero, or 0 if @a str is NULL.
+ */
+extern size_t _lf_mlstr_size (const lfMLstr str);
+
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+typedef GMutex lfArenaMutex;
+#else
+typedef GStaticMutex lfArenaMutex;
+#endif
+
+struct lfTokenTable;
+
+/**
+ * @brief A memory arena for the objects of a lfDatabase.
+ *
+ * Memory is handed out from a few large blocks and is never freed
+ * individually; all of it is released at once when the arena is destroyed.
+ * Strings stored in the arena are interned, so every distinct maker, model
+ * or mount name is kept only once, no matter how many database entries
+ * refer to it.  Objects allocated here must therefore never be modified
+ * or freed with g_free() or delete.
+ *
+ * All methods are thread-safe: calibrations which are loaded lazily are
+ * stored in the arena by whatever thread asks for them first, while other
+ * threads may be adding objects to the database.
+ */
+class lfArena
+{
+    /// The most recent block; older blocks are chained through their header
+    struct lfArenaBlock *Blocks;
+    /// Free space in the most recent block
+    char *Free;
+    size_t Left;
+    /// Interned strings and multi-language strings
+    GHashTable *Strings;
+    GHashTable *MLstrings;
+    /// Protects all of the above
+    mutable lfArenaMutex Lock;
+    /// The words of the names, see _lf_tokenize_mlstr()
+    lfTokenTable *Tokens;
+
+    void *AllocLocked (size_t size);
+
+public:
+    lfArena ();
+    ~lfArena ();
+
+    /**
+     * @brief Allocate memory in the arena.
+     * @param size
+     *     The number of bytes to allocate.
+     * @return
+     *     Zero-initialized memory, aligned for any of the database structures.
+     */
+    void *Alloc (size_t size);
+
+    /**
+     * @brief Return the interned copy of a string.
+     * @param str
+     *     The string, may be NULL.
+     * @return
+     *     A string owned by the arena which is equal to @a str.
+     */
+    const char *Intern (const char *str);
+
+    /**
+     * @brief Return the interned copy of a multi-language string.
+     * @param str
+     *     The multi-language string, may be NULL.
+     * @return
+     *     A multi-language string owned by the arena which is equal to @a str.
+     */
+    lfMLstr InternMLstr (const lfMLstr str);
+
+    /**
+     * @brief Check whether memory has been allocated from this arena.
+     * @param ptr
+     *     The pointer to check.
+     * @return
+     *     true if @a ptr points into one of the blocks of the arena.
+     */
+    bool Owns (const void *ptr) const;
+
+    /**
+     * @brief Return the memory used by the arena.
+     * @return
+     *     The total size of all blocks in bytes.
+     */
+    size_t GetSize () const;
+
+    /**
+     * @brief Return the table of the words in the names of the database.
+     *
+     * The token IDs of search patterns and database objects are only
+     * comparable if they come from the same table.  It is freed together
+     * with the arena.
+     */
+    lfTokenTable *GetTokens () const
+    { return Tokens; }
+};
+
+/// Maximum nesting of elements in database files
+#define LF_XML_MAX_DEPTH 16
+/// Maximum number of attributes of an element in database files
+#define LF_XML_MAX_ATTRS 32
+/// Size of the pieces in which lfXmlWriter writes to files
+#define LF_XML_WRITE_CHUNK 65536
+/// Size of the pieces in which compressed database files are decoded
+#define LF_DECODE_CHUNK 65536
+
+/// The tokens returned by lfXmlReader::Next()
+enum lfXmlToken
+{
+    /// A start tag; for an empty element (\<name/\>) the end follows
+    LF_XML_START,
+    /// An end tag
+    LF_XML_END,
+    /// Text between tags
+    LF_XML_TEXT,
+    /// The end of the range being read
+    LF_XML_EOF,
+    /// The data is not well-formed
+    LF_XML_ERROR
+};
+
+/**
+ * @brief A pull parser for the XML of the database files.
+ *
+ * It works in place on a writable buffer: element and attribute names,
+ * attribute values, and text are terminated with zeros and have their
+ * entities decoded right in the buffer, so nothing is copied.  Names stay
+ * valid as long as the buffer, values and text only until the next call
+ * of Next().  Comments, processing instructions, and the DOCTYPE are
+ * skipped.  The buffer can be read in several consecutive ranges, as long
+ * as they start and end between tags; data outside of the ranges is left
+ * untouched.
+ */
+class lfXmlReader
+{
+    char *Base, *Limit;
+    /// The current position and the end of the current range
+    char *Pos, *End;
+    /// The byte which was replaced by the zero after the last text
+    char *Restore;
+    char RestoreChar;
+    /// The first byte of the current range which is not valid UTF-8
+    const char *Invalid;
+    /// The last start tag was an empty element
+    bool SelfClosed;
+    const char *Stack [LF_XML_MAX_DEPTH];
+    int Depth;
+    const char *Names [LF_XML_MAX_ATTRS + 1];
+    const char *Values [LF_XML_MAX_ATTRS + 1];
+
+    lfXmlToken Fail (GError **error, const char *format, ...) G_GNUC_PRINTF (3, 4);
+    bool Decode (char *str, char *&end, GError **error);
+
+public:
+    /**
+     * @brief Create a reader for a buffer.
+     * @param data
+     *     The buffer, which is changed while reading.
+     * @param size
+     *     The size of the buffer in bytes.
+     */
+    lfXmlReader (char *data, size_t size);
+
+    /**
+     * @brief Set the part of the buffer to read next.
+     * @param pos
+     *     The start of the range.
+     * @param end
+     *     The end of the range.
+     */
+    void SetRange (char *pos, char *end);
+
+    /**
+     * @brief Read the next token.
+     * @param error
+     *     Set if LF_XML_ERROR is returned.
+     * @return
+     *     The kind of token; the details are in Name, AttrNames,
+     *     AttrValues, and Text.
+     */
+    lfXmlToken Next (GError **error);
+
+    /**
+     * @brief Return the name of the innermost open element, or NULL.
+     */
+    const char *GetElement () const
+    { return Depth ? Stack [Depth - 1] : NULL; }
+
+    /**
+     * @brief Return the number of open elements.
+     */
+    int GetDepth () const
+    { return Depth; }
+
+    /**
+     * @brief Return the line and column of the current position.
+     */
+    void GetPosition (int &line, int &col) const;
+
+    /**
+     * @brief Continue in a buffer which was moved, e.g. by g_realloc().
+     * @param data
+     *     The new address of the buffer.
+     * @param size
+     *     The new size of the buffer.
+     */
+    void Move (char *data, size_t size);
+
+    /// Name of the element of LF_XML_START and LF_XML_END
+    const char *Name;
+    /// NULL-terminated attribute names and values of LF_XML_START
+    const char **AttrNames, **AttrValues;
+    /// Zero-terminated text of LF_XML_TEXT, with its length
+    const char *Text;
+    size_t TextLen;
+};
+
+/// Compression formats of database files
+enum lfCompression
+{
+    LF_COMPRESSION_NONE,
+    /// gzip, available if the library is built with zlib
+    LF_COMPRESSION_GZIP,
+    /// Zstandard, available if the library is built with libzstd
+    LF_COMPRESSION_ZSTD
+};
+
+/**
+ * @brief Recognize compressed data by its magic number.
+ * @param data
+ *     The start of the data.
+ * @param size
+ *     The size of the data in bytes.
+ */
+extern lfCompression _lf_compression_of_data (const char *data, size_t size);
+
+/**
+ * @brief Choose the compression for a file from its name (".gz", ".zst").
+ * @param filename
+ *     The name of the file.
+ */
+extern lfCompression _lf_compression_of_name (const char *filename);
+
+/**
+ * @brief Check whether the library was built with support for a compression.
+ * @param type
+ *     The compression.
+ */
+extern bool _lf_compression_supported (lfCompression type);
+
+/**
+ * @brief Write all of a buffer to a file descriptor.
+ * @return
+ *     0, or the errno value of the failure.
+ */
+extern int _lf_write_all (int fd, const char *data, size_t size);
+
+/**
+ * @brief Decompresses a buffer piece by piece.
+ */
+class lfDecoder
+{
+    lfCompression Type;
+    void *Stream;
+    /// The input which has not been used yet
+    const char *In;
+    size_t InSize;
+    bool Finished;
+
+public:
+    /**
+     * @brief Create a decoder for compressed data.
+     * @param type
+     *     The compression, as found by _lf_compression_of_data().
+     * @param data
+     *     The compressed data, which must stay valid while decoding.
+     * @param size
+     *     The size of the compressed data in bytes.
+     */
+    lfDecoder (lfCompression type, const char *data, size_t size);
+    ~lfDecoder ();
+
+    /**
+     * @brief Decompress the next piece of the data.
+     * @param buf
+     *     Where to store the decompressed data.
+     * @param size
+     *     The room in @a buf; less than that is returned only at the end.
+     * @param error
+     *     Set if -1 is returned.
+     * @return
+     *     The number of bytes stored, 0 at the end of the data, or -1 if
+     *     the data is damaged or the compression is not supported.
+     */
+    gssize Read (char *buf, size_t size, GError **error);
+};
+
+/**
+ * @brief Compresses data and writes it to a file descriptor.
+ */
+class lfEncoder
+{
+    lfCompression Type;
+    int Fd;
+    void *Stream;
+    char *Out;
+
+public:
+    /**
+     * @brief Create an encoder.
+     * @param type
+     *     The compression, other than LF_COMPRESSION_NONE.
+     * @param fd
+     *     The file descriptor to write to.
+     */
+    lfEncoder (lfCompression type, int fd);
+    ~lfEncoder ();
+
+    /**
+     * @brief Compress data and write what is ready.
+     * @param data
+     *     The data.
+     * @param size
+     *     The size of the data in bytes.
+     * @param finish
+     *     End the compressed stream after the data.
+     * @return
+     *     0, or an errno value.
+     */
+    int Write (const char *data, size_t size, bool finish);
+};
+
+/**
+ * @brief A buffered writer for the XML of the database files.
+ *
+ * Output is collected in a buffer which is written to a file descriptor
+ * whenever it grows beyond LF_XML_WRITE_CHUNK bytes; without a file
+ * descriptor the whole document stays in memory.  Text is escaped while
+ * it is copied into the buffer, and numbers are formatted independently
+ * of the current locale.
+ */
+class lfXmlWriter
+{
+    int Fd;
+    lfEncoder *Encoder;
+
+public:
+    /**
+     * @brief Create a writer.
+     * @param fd
+     *     The file descriptor to write to, or -1 to keep the output in
+     *     memory.
+     * @param compression
+     *     How to compress the output written to @a fd.
+     */
+    lfXmlWriter (int fd = -1, lfCompression compression = LF_COMPRESSION_NONE);
+    ~lfXmlWriter ();
+
+    /// Append raw bytes
+    void Write (const char *str, size_t len);
+    /// Append a zero-terminated string without escaping it
+    void Write (const char *str)
+    { Write (str, strlen (str)); }
+    /// Append a zero-terminated string, escaping markup characters
+    void Text (const char *str);
+    /// Append a number formatted as with "%g" in the C locale
+    void Number (double value);
+
+    /**
+     * @brief Append an attribute followed by a space, e.g. 'k1="0.01" '.
+     */
+    void Attr (const char *name, double value);
+    void Attr (const char *name, const char *value);
+
+    /**
+     * @brief Append a line with a text-only element.
+     * @param prefix
+     *     The indentation.
+     * @param element
+     *     The name of the element.
+     * @param value
+     *     The contents of the element.
+     */
+    void Element (const char *prefix, const char *element, const char *value);
+    void Element (const char *prefix, const char *element, double value);
+
+    /**
+     * @brief Append a multi-language string as one element per language.
+     *
+     * Outputs a number of lines which looks like:
+     *
+     * \Verbatim
+     * ${prefix}<${element}>${val}</${element}>
+     * ${prefix}<${element} lang="xxx">${val[xxx]}</${element}>
+     * ...
+     * \EndVerbatim
+     */
+    void MLstr (const char *prefix, const char *element, lfMLstr val);
+
+    /**
+     * @brief Write the buffer to the file descriptor.
+     * @return
+     *     false if this or an earlier write failed; Error is set then.
+     */
+    bool Flush ();
+
+    /**
+     * @brief Write the rest of the buffer and end the compressed stream.
+     * @return
+     *     false if this or an earlier write failed; Error is set then.
+     */
+    bool Finish ();
+
+    /**
+     * @brief Take the output of a writer without a file descriptor.
+     * @return
+     *     The document, to be freed with g_free().
+     */
+    char *Steal ();
+
+    /// The output which has not been written yet
+    GString *Buffer;
+    /// The errno of the first failed write, or 0
+    int Error;
+};
+
+/// Where to find the unparsed calibration data of a lens, see LF_LOAD_LAZY_CALIBRATIONS
+struct lfLazyCalibrations
+{
+    /// The arena of the database the lens belongs to
+    lfArena *Arena;
+    /// The absolute name of the file the lens was loaded from, or the error
+    /// context of lfDatabase::Load if Data is set
+    const char *ErrContext;
+    /// The <calibration> element, or NULL if it must be read from the file.
+    /// It is either a copy in the arena or part of the embedded database.
+    const char *Data;
+    /// Position and size of the <calibration> element
+    gsize Offset, Size;
+    /// Checksum of the element in the file, to detect a file which changed
+    /// after loading
+    guint64 Checksum;
+    /// Focal length and aperture ranges of the data, for lfLens::GuessParameters
+    float MinFocal, MaxFocal, MinAperture, MaxAperture;
+};
+
+/**
+ * @brief Parse the calibration data of a lens loaded with
+ * LF_LOAD_LAZY_CALIBRATIONS.
+ *
+ * Lenses are const for their users, but this fills their calibration
+ * lists in place.  It is thread-safe.
+ * @param lens
+ *     The lens.  Nothing happens if its calibration data has been parsed
+ *     already.
+ */
+extern void _lf_lens_load_calibrations (const lfLens *lens);
+
+/**
+ * @brief Make sure the calibration lists of a lens are available.
+ * @param lens
+ *     The lens.
+ */
+static inline void _lf_lens_need_calibrations (const lfLens *lens)
+{
+    if (g_atomic_pointer_get (&lens->LazyCalibrations))
+        _lf_lens_load_calibrations (lens);
+}
+
+/**
+ * @brief Create an empty table of the words of a database, see lfArena::GetTokens.
+ */
+extern lfTokenTable *_lf_tokens_new ();
+
+/**
+ * @brief Free a table created with _lf_tokens_new().
  */
-extern guint _lf_detect_cpu_features ();
+extern void _lf_tokens_free (lfTokenTable *table);
+
+/**
+ * @brief Split a multi-language string into tokens for lfFuzzyStrCmp.
+ *
+ * Every word is casefolded and interned into the table of the database,
+ * so that words are compared as integers afterwards.  This is done once
+ * for every camera and lens of the database when it is added.
+ * @param table
+ *     The words of the database, from lfArena::GetTokens.
+ * @param str
+ *     The multi-language string, e.g. the model name of a lens.
+ * @param arena
+ *     If not NULL, the list is allocated in this arena.
+ * @return
+ *     For every translation, the number of words followed by their sorted
+ *     token IDs; the list ends with -1.  NULL if @a str is NULL.  Release
+ *     with g_free() unless it was allocated in @a arena.
+ */
+extern int *_lf_tokenize_mlstr (lfTokenTable *table, const lfMLstr str,
+                                lfArena *arena = NULL);
 
 /**
  * @brief Google-in-your-pocket: a fuzzy string comparator.
@@ -388,10 +1011,13 @@ class lfFuzzyStrCmp
 {
     GPtrArray *pattern_words;
     GPtrArray *match_words;
+    /// Number of pattern words followed by their sorted token IDs
+    int *pattern_ids;
     bool match_all_words;
 
     void Split (const char *str, GPtrArray *dest);
     void Free (GPtrArray *dest);
+    int CompareTokens (const int *match_ids);
 
 public:
     /**
@@ -402,8 +1028,11 @@ public:
      *     If true, all words of the pattern must be present in the
      *     target string. If not, a looser result will be accepted,
      *     although this will be reflected in the match score.
+     * @param tokens
+     *     The words of the database which is searched, from
+     *     lfArena::GetTokens.
      */
-    lfFuzzyStrCmp (const char *pattern, bool allwords);
+    lfFuzzyStrCmp (const char *pattern, bool allwords, lfTokenTable *tokens);
     ~lfFuzzyStrCmp ();
 
     /**
@@ -438,6 +1067,21 @@ public:
      *     in match.
      */
     int Compare (const lfMLstr match);
+
+    /**
+     * @brief Compares the pattern with a pre-tokenized multi-language string.
+     *
+     * This is equivalent to Compare (const lfMLstr) but only merges lists
+     * of integers, without any memory allocation.
+     * @param match
+     *     The multi-language string to match against.
+     * @param tokens
+     *     The tokens of @a match from _lf_tokenize_mlstr().  If NULL, @a
+     *     match is split into words instead.
+     * @return
+     *     Returns the maximal score in range 0-100, see Compare (const lfMLstr).
+     */
+    int Compare (const lfMLstr match, const int *tokens);
 };
 
 /// Subpixel distortion callback
@@ -458,12 +1102,449 @@ struct lfColorCallbackData : public lfCallbackData
     lfModifyColorFunc callback;
 };
 
-// `dvector`, `matrix`, and `svg` are declared here to be able to test `svd` in
-// unit tests.
+/// Counters of one callback, see lfModifierStatsData
+struct lfStatsCounters
+{
+    guint64 Pixels;
+    guint64 Nanoseconds;
+};
+
+/// The callback lists of a lfModifier, see lfModifierStatsData
+enum lfStatsList
+{
+    LF_STATS_COORD,
+    LF_STATS_SUBPIXEL,
+    LF_STATS_COLOR
+};
+
+/**
+ * @brief The performance counters of a lfModifier.
+ *
+ * They are only allocated if the library is built with MODIFIER_STATS.  All
+ * counters are updated with _lf_stats_count() because the Apply... methods
+ * may be called from several threads at once.  The callback counters are indexed by
+ * lfStatsList and by the position of the callback in its list.
+ */
+struct lfModifierStatsData
+{
+    /// Whether the counters are being collected
+    int Enabled;
+    lfStatsCounters Callbacks [3][LF_STATS_MAX_CALLBACKS];
+    guint64 TablePixels;
+    guint64 NewtonSteps [LF_STATS_NEWTON_BINS];
+    guint64 OutOfRange;
+    guint64 NotFinite;
+};
+
+// g_atomic_pointer_add() covers the 64-bit counters only if pointers have 64
+// bits; elsewhere the counters are protected by a lock in mod-stats.cpp.
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,30,0) && GLIB_SIZEOF_VOID_P == 8
+#define LF_STATS_ATOMIC
+#endif
+
+/**
+ * @brief Add to a performance counter.
+ * @param counter
+ *     The counter in a lfModifierStatsData.
+ * @param value
+ *     The amount to add.
+ */
+#ifdef LF_STATS_ATOMIC
+static inline void _lf_stats_count (guint64 *counter, guint64 value)
+{
+    g_atomic_pointer_add ((gsize *)counter, (gssize)value);
+}
+#else
+extern void _lf_stats_count (guint64 *counter, guint64 value);
+#endif
+
+/**
+ * @brief Read a performance counter.
+ * @param counter
+ *     The counter in a lfModifierStatsData.
+ * @return
+ *     The value of the counter.
+ */
+#ifdef LF_STATS_ATOMIC
+static inline guint64 _lf_stats_read (const guint64 *counter)
+{
+    return (gsize)g_atomic_pointer_get ((gsize *)counter);
+}
+#else
+extern guint64 _lf_stats_read (const guint64 *counter);
+#endif
 
-typedef std::vector<double> dvector;
-typedef std::vector<dvector> matrix;
+/**
+ * @brief Get a monotonic time stamp for the performance counters.
+ * @return
+ *     The time in nanoseconds since an arbitrary point in the past.
+ */
+extern gint64 _lf_stats_clock ();
+
+/**
+ * @brief Count the resulting coordinates which are not finite or outside the
+ * image.
+ * @param stats
+ *     The performance counters.
+ * @param coord
+ *     The coordinates in pixels.
+ * @param count
+ *     The number of coordinate pairs.
+ * @param width
+ *     The largest valid x coordinate.
+ * @param height
+ *     The largest valid y coordinate.
+ */
+extern void _lf_stats_count_coords (
+    lfModifierStatsData *stats, const float *coord, int count,
+    double width, double height);
 
-dvector svd (matrix M);
+/**
+ * @brief Get the performance counters if they are being collected.
+ *
+ * Without MODIFIER_STATS this is always NULL, so that the compiler drops all
+ * counting code behind it.
+ * @param stats
+ *     The Stats member of the lfModifier.
+ * @return
+ *     The counters, or NULL if nothing is to be counted.
+ */
+static inline lfModifierStatsData *_lf_stats_active (void *stats)
+{
+#ifdef MODIFIER_STATS
+    lfModifierStatsData *s = (lfModifierStatsData *)stats;
+    return s && g_atomic_int_get (&s->Enabled) ? s : NULL;
+#else
+    (void)stats;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Start timing a callback.
+ * @param stats
+ *     The active counters, or NULL.
+ * @return
+ *     The time stamp to be passed to _lf_stats_add().
+ */
+static inline gint64 _lf_stats_start (const lfModifierStatsData *stats)
+{
+    return stats ? _lf_stats_clock () : 0;
+}
+
+/**
+ * @brief Add a call of a callback to its counters.
+ * @param stats
+ *     The active counters, or NULL.
+ * @param list
+ *     The callback list.
+ * @param index
+ *     The position of the callback in its list.
+ * @param pixels
+ *     The number of pixels the callback has processed.
+ * @param start
+ *     The time stamp from _lf_stats_start().
+ */
+static inline void _lf_stats_add (
+    lfModifierStatsData *stats, lfStatsList list, int index, int pixels,
+    gint64 start)
+{
+    if (!stats || index >= LF_STATS_MAX_CALLBACKS)
+        return;
+    lfStatsCounters &counters = stats->Callbacks [list][index];
+    _lf_stats_count (&counters.Pixels, pixels);
+    _lf_stats_count (&counters.Nanoseconds, _lf_stats_clock () - start);
+}
+
+/**
+ * @brief Add a solution of the radial inverse to the Newton histogram.
+ * @param stats
+ *     The active counters.
+ * @param steps
+ *     The number of Newton steps, or -1 if the solver did not converge.
+ */
+static inline void _lf_stats_newton (lfModifierStatsData *stats, int steps)
+{
+    if (steps < 0)
+        steps = LF_STATS_NEWTON_BINS - 1;
+    else if (steps > LF_STATS_NEWTON_BINS - 2)
+        steps = LF_STATS_NEWTON_BINS - 2;
+    _lf_stats_count (&stats->NewtonSteps [steps], 1);
+}
+
+/// Number of entries in the table of a lfRadialInverse
+#define LF_RADIAL_INVERSE_SIZE 129
+
+/**
+ * @brief A tabulated inverse ru(rd) of a radial distortion function.
+ *
+ * The undistortion callbacks have to invert rd(ru) numerically for every
+ * pixel.  The table is sampled once when the callback is added, and the
+ * linear interpolation between its entries is used as the start value of
+ * Newton's method.  This way, most pixels converge without a single Newton
+ * step.  The table ends where the distortion function ceases to be
+ * monotonic; beyond it, the old start value ru = rd is used.
+ */
+struct lfRadialInverse
+{
+    /// Distance in rd between two table entries, and its reciprocal
+    float Step, InvStep;
+    /// Number of valid entries in Ru
+    int Size;
+    /// Counter of non-converging pixels; it belongs to the lfModifier
+    guint64 *Failures;
+    /// The performance counters of the lfModifier, or NULL
+    lfModifierStatsData *Stats;
+    /// The undistorted radius for the distorted radius i * Step
+    float Ru [LF_RADIAL_INVERSE_SIZE];
+
+    /**
+     * @brief Get the start value for Newton's method.
+     * @param rd
+     *     The distorted radius.
+     * @return
+     *     The approximated undistorted radius.
+     */
+    double Seed (double rd) const
+    {
+        double t = rd * InvStep;
+        if (!(t < Size - 1))
+            return rd;
+        int i = (int)t;
+        t -= i;
+        return Ru [i] + t * (Ru [i + 1] - Ru [i]);
+    }
+};
+
+/**
+ * @brief Solve f(ru) = 0 for ru with Newton's method.
+ * @param f
+ *     A functor with the signature double (double ru, double rd, double
+ *     &prime) which returns the residual and sets @a prime to its derivative.
+ * @param rd
+ *     The distorted radius.
+ * @param ru
+ *     The start value on input, the solution on output.
+ * @param max_steps
+ *     The maximal number of Newton steps.
+ * @param steps
+ *     If not NULL, receives the number of Newton steps taken.
+ * @return
+ *     true if the residual dropped below NEWTON_EPS.
+ */
+template<typename F> static inline bool _lf_newton_radial (
+    const F &f, double rd, double &ru, int max_steps, int *steps = NULL)
+{
+    for (int step = 0; ; step++)
+    {
+        double prime;
+        double fru = f (ru, rd, prime);
+        if (steps)
+            *steps = step;
+        if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
+            return true;
+        if (step >= max_steps)
+            return false;
+        ru -= fru / prime;
+    }
+}
+
+/**
+ * @brief Find the undistorted radius for a distorted radius.
+ *
+ * Newton's method is started from the tabulated inverse.  If this does not
+ * converge, it is retried from ru = rd, which was the only start value before
+ * the tables were introduced.  Only if this fails, too, the pixel is counted
+ * as non-converging.
+ * @param f
+ *     The residual functor, see _lf_newton_radial().
+ * @param inverse
+ *     The tabulated inverse of @a f.
+ * @param rd
+ *     The distorted radius.
+ * @param ru
+ *     Receives the undistorted radius.
+ * @return
+ *     true if a solution was found.
+ */
+template<typename F> static inline bool _lf_solve_radial (
+    const F &f, const lfRadialInverse &inverse, double rd, double &ru)
+{
+    lfModifierStatsData *stats = _lf_stats_active (inverse.Stats);
+    int steps, retry_steps;
+    ru = inverse.Seed (rd);
+    if (_lf_newton_radial (f, rd, ru, 6, stats ? &steps : NULL))
+    {
+        if (stats)
+            _lf_stats_newton (stats, steps);
+        return true;
+    }
+    ru = rd;
+    if (_lf_newton_radial (f, rd, ru, 6, stats ? &retry_steps : NULL))
+    {
+        if (stats)
+            _lf_stats_newton (stats, steps + retry_steps);
+        return true;
+    }
+    if (stats)
+        _lf_stats_newton (stats, -1);
+    if (inverse.Failures)
+        _lf_stats_count (inverse.Failures, 1);
+    return false;
+}
+
+/**
+ * @brief Tabulate the inverse of a radial distortion function.
+ * @param f
+ *     The residual functor, see _lf_newton_radial().
+ * @param rd_max
+ *     The largest distorted radius which is expected to occur.
+ * @param failures
+ *     The counter of non-converging pixels.
+ * @param stats
+ *     The performance counters of the lfModifier, or NULL.
+ * @param inverse
+ *     The table to be filled.
+ */
+template<typename F> static void _lf_build_radial_inverse (
+    const F &f, double rd_max, unsigned long long *failures, void *stats,
+    lfRadialInverse &inverse)
+{
+    inverse.Step = rd_max / (LF_RADIAL_INVERSE_SIZE - 1);
+    inverse.InvStep = 1.0 / inverse.Step;
+    inverse.Failures = (guint64 *)failures;
+    inverse.Stats = (lfModifierStatsData *)stats;
+    inverse.Ru [0] = 0.0;
+    inverse.Size = 1;
+
+    // Every entry is started from its predecessor, so that we follow the
+    // branch of the inverse which passes through the origin.
+    double ru = 0.0;
+    for (int i = 1; i < LF_RADIAL_INVERSE_SIZE; i++)
+    {
+        double rd = i * inverse.Step;
+        double ru_previous = ru;
+        ru += inverse.Step;
+        if (!_lf_newton_radial (f, rd, ru, 50) || !(ru > ru_previous))
+            break;
+        inverse.Ru [i] = ru;
+        inverse.Size = i + 1;
+    }
+}
+
+/// Callback data of lfModifier::ModifyCoord_UnDist_Poly3
+struct lfUnDistPoly3Data
+{
+    float inv_k1_;
+    lfRadialInverse inverse;
+};
+
+/// Callback data of lfModifier::ModifyCoord_UnDist_Poly5
+struct lfUnDistPoly5Data
+{
+    float k1, k2;
+    lfRadialInverse inverse;
+};
+
+/// Callback data of lfModifier::ModifyCoord_UnDist_PTLens and its SSE variant
+struct lfUnDistPTLensData
+{
+    float a_, b_, c_;
+    lfRadialInverse inverse;
+};
+
+/// Callback data of lfModifier::ModifyCoord_UnTCA_Poly3
+struct lfUnTCAPoly3Data
+{
+    /// The six terms of lfLensCalibTCA
+    float terms [6];
+    lfRadialInverse inverse_r, inverse_b;
+};
+
+/// Number of entries of a lfRadialTable per channel
+#define LF_RADIAL_TABLE_SIZE 4097
+
+/**
+ * @brief A tabulated purely radial chain of coordinate callbacks.
+ *
+ * If all callbacks of an lfModifier only move pixels along the line through
+ * the image centre (scaling, the polynomial distortion models, and the
+ * radial TCA models), the whole chain reduces to (x, y) -> f(r²) * (x, y).
+ * f is sampled once at equidistant r² and linearly interpolated afterwards,
+ * so that the per-pixel work is a table lookup and a multiplication.
+ */
+struct lfRadialTable
+{
+    /// Table entries per unit of r², in normalized coordinates
+    float InvStep;
+    /// The factors of the coordinate callbacks
+    float Coord [LF_RADIAL_TABLE_SIZE];
+    /// The red, green, and blue factors of the coordinate callbacks followed
+    /// by the subpixel callbacks, interleaved; only valid if HasSubpixel
+    float Subpixel [LF_RADIAL_TABLE_SIZE * 3];
+    /// Whether also the subpixel callbacks are radial and tabulated
+    bool HasSubpixel;
+
+    /**
+     * @brief Find the position of r² in the table.
+     * @param r2
+     *     The squared distance from the image centre.
+     * @param i
+     *     Receives the index of the table entry left of r².
+     * @param t
+     *     Receives the fractional position between entries i and i + 1.
+     * @return
+     *     false if r² lies outside the table.
+     */
+    bool Locate (float r2, int &i, float &t) const
+    {
+        t = r2 * InvStep;
+        if (!(t < LF_RADIAL_TABLE_SIZE - 1))
+            return false;
+        i = (int)t;
+        t -= i;
+        return true;
+    }
+
+    /**
+     * @brief Find the mirror symmetry of a row or column of samples.
+     *
+     * A radial chain maps (-x, y) and (x, -y) to the mirror images of
+     * (x, y).  If the lens centre is the image centre, the sample grid is
+     * symmetric, too, and half of the samples can be mirrored instead of
+     * computed.
+     * @param start
+     *     The first sample position, in normalized coordinates.
+     * @param step
+     *     The distance between two samples.
+     * @return
+     *     The index sum i + i' of two samples which mirror each other, or -1
+     *     if the samples are not symmetric about the centre.
+     */
+    static int MirrorSum (double start, double step)
+    {
+        double m = -2.0 * start / step;
+        int n = (int)floor (m + 0.5);
+        return n > 0 && fabs (m - n) < 0.001 ? n : -1;
+    }
+};
+
+// `svd` is declared here to be able to test it in unit tests.
+
+/// Number of columns of the matrices passed to svd()
+#define LF_SVD_COLUMNS 6
+
+/**
+ * @brief Find the right singular vector of the smallest singular value.
+ * @param M
+ *     The matrix; missing rows up to LF_SVD_COLUMNS are taken as zero.
+ * @param rows
+ *     The number of rows of @a M, at most LF_SVD_COLUMNS.
+ * @param result
+ *     Receives the singular vector.
+ * @return
+ *     false if the iterations did not converge.
+ */
+bool svd (const double M [][LF_SVD_COLUMNS], int rows, double result [LF_SVD_COLUMNS]);
 
 #endif /* __LENSFUNPRV_H__ */
@@ -0,0 +1,361 @@
+/*
+    Database which can be reloaded while it is in use
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <glib/gstdio.h>
+#include <string.h>
+#include <time.h>
+
+/* A parsed database file */
+struct lfLiveFile
+{
+    lfDatabase *DB;
+    /* Modification time and size before the file was read */
+    gint64 MTime;
+    gint64 Size;
+    /* The second in which the file was read */
+    gint64 ReadTime;
+    /* Checksum of the contents */
+    gchar *Checksum;
+};
+
+/* A published database with the number of its users; the lfLiveDatabase
+   itself holds a reference to the current one */
+struct lfLiveSnapshot
+{
+    lfDatabase *DB;
+    int Refs;
+};
+
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+typedef GMutex lfLiveMutex;
+#define LIVE_MUTEX_INIT(lock) g_mutex_init (&(lock))
+#define LIVE_MUTEX_CLEAR(lock) g_mutex_clear (&(lock))
+#define LIVE_LOCK(data) g_mutex_lock (&(data)->LiveLock)
+#define LIVE_UNLOCK(data) g_mutex_unlock (&(data)->LiveLock)
+#define RELOAD_LOCK(data) g_mutex_lock (&(data)->ReloadLock)
+#define RELOAD_UNLOCK(data) g_mutex_unlock (&(data)->ReloadLock)
+#else
+typedef GStaticMutex lfLiveMutex;
+#define LIVE_MUTEX_INIT(lock) g_static_mutex_init (&(lock))
+#define LIVE_MUTEX_CLEAR(lock) g_static_mutex_free (&(lock))
+#define LIVE_LOCK(data) g_static_mutex_lock (&(data)->LiveLock)
+#define LIVE_UNLOCK(data) g_static_mutex_unlock (&(data)->LiveLock)
+#define RELOAD_LOCK(data) g_static_mutex_lock (&(data)->ReloadLock)
+#define RELOAD_UNLOCK(data) g_static_mutex_unlock (&(data)->ReloadLock)
+#endif
+
+struct lfLiveDatabaseData
+{
+    /* Locations added by the application, in load order */
+    GPtrArray *Locations;
+    /* Parsed files by path */
+    GHashTable *Files;
+    /* The paths of the files in the current snapshot, in load order */
+    GPtrArray *Order;
+    /* The current snapshot */
+    lfLiveSnapshot *Current;
+    /* All snapshots which are still in use, including the current one */
+    GPtrArray *Snapshots;
+    /* Protects Current, Snapshots and the reference counts; only held for
+       a few pointer operations, never while parsing */
+    lfLiveMutex LiveLock;
+    /* Serializes Reload and AddLocation */
+    lfLiveMutex ReloadLock;
+};
+
+static void _lf_live_file_free (gpointer data)
+{
+    lfLiveFile *file = (lfLiveFile *)data;
+    delete file->DB;
+    g_free (file->Checksum);
+    g_free (file);
+}
+
+lfLiveDatabase::lfLiveDatabase ()
+{
+    lfLiveDatabaseData *data = g_new0 (lfLiveDatabaseData, 1);
+    data->Locations = g_ptr_array_new ();
+    data->Files = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, _lf_live_file_free);
+    data->Order = g_ptr_array_new ();
+    data->Snapshots = g_ptr_array_new ();
+    LIVE_MUTEX_INIT (data->LiveLock);
+    LIVE_MUTEX_INIT (data->ReloadLock);
+    Data = data;
+}
+
+lfLiveDatabase::~lfLiveDatabase ()
+{
+    lfLiveDatabaseData *data = (lfLiveDatabaseData *)Data;
+
+    if (data->Current)
+        Release (data->Current->DB);
+    if (data->Snapshots->len)
+        g_warning ("[Lensfun] %d database snapshots were not released",
+                   data->Snapshots->len);
+    g_ptr_array_free (data->Snapshots, TRUE);
+
+    for (guint i = 0; i < data->Locations->len; i++)
+        g_free (g_ptr_array_index (data->Locations, i));
+    g_ptr_array_free (data->Locations, TRUE);
+    for (guint i = 0; i < data->Order->len; i++)
+        g_free (g_ptr_array_index (data->Order, i));
+    g_ptr_array_free (data->Order, TRUE);
+    g_hash_table_destroy (data->Files);
+    LIVE_MUTEX_CLEAR (data->LiveLock);
+    LIVE_MUTEX_CLEAR (data->ReloadLock);
+    g_free (data);
+}
+
+void lfLiveDatabase::AddLocation (const char *pathname)
+{
+    lfLiveDatabaseData *data = (lfLiveDatabaseData *)Data;
+    RELOAD_LOCK (data);
+    g_ptr_array_add (data->Locations, g_strdup (pathname));
+    RELOAD_UNLOCK (data);
+}
+
+/* Parse a file again if it changed; returns true if the file has to go
+   into the next snapshot differently than into the current one */
+static bool _lf_live_update_file (GHashTable *files, const char *path)
+{
+    GStatBuf st;
+    if (g_stat (path, &st))
+        return false;
+
+    // The time stamp has a resolution of one second or worse, so a file
+    // which was written again in the second in which it was read may look
+    // unchanged.  Only files modified before that second are skipped, all
+    // others are compared by their contents.
+    lfLiveFile *file = (lfLiveFile *)g_hash_table_lookup (files, path);
+    if (file && file->MTime == (gint64)st.st_mtime &&
+        file->Size == (gint64)st.st_size && file->MTime < file->ReadTime)
+        return false;
+
+    gint64 read_time = time (NULL);
+    gchar *contents;
+    gsize length;
+    if (!g_file_get_contents (path, &contents, &length, NULL))
+        return false;
+    gchar *checksum = g_compute_checksum_for_data (
+        G_CHECKSUM_SHA1, (const guchar *)contents, length);
+
+    lfDatabase *db = NULL;
+    if (!file || strcmp (file->Checksum, checksum))
+    {
+        db = new lfDatabase ();
+        if (db->Load (path, contents, length) != LF_NO_ERROR)
+        {
+            // Possibly being written right now; keep what we have and try
+            // again next time
+            g_warning ("[Lensfun] %s: cannot reload, keeping the previous contents",
+                       path);
+            delete db;
+            g_free (checksum);
+            g_free (contents);
+            return false;
+        }
+    }
+    g_free (contents);
+
+    if (!file)
+    {
+        file = g_new0 (lfLiveFile, 1);
+        g_hash_table_insert (files, g_strdup (path), file);
+    }
+    file->MTime = st.st_mtime;
+    file->Size = st.st_size;
+    file->ReadTime = read_time;
+    g_free (file->Checksum);
+    file->Checksum = checksum;
+    if (!db)
+        return false;
+
+    delete file->DB;
+    file->DB = db;
+    return true;
+}
+
+lfError lfLiveDatabase::Reload (bool *changed)
+{
+    lfLiveDatabaseData *data = (lfLiveDatabaseData *)Data;
+
+    RELOAD_LOCK (data);
+
+    GPtrArray *order = g_ptr_array_new ();
+    if (data->Locations->len)
+        for (guint i = 0; i < data->Locations->len; i++)
+            _lf_list_database_files (
+                order, (const char *)g_ptr_array_index (data->Locations, i));
+    else
+    {
+        _lf_list_database_files (order, _lf_db_main_location (lfDatabase::UserUpdatesLocation));
+        _lf_list_database_files (order, lfDatabase::UserLocation);
+    }
+
+    // Parse new and changed files, and drop files which cannot be read at
+    // all from the list
+    bool dirty = !data->Current || order->len != data->Order->len;
+    guint n = 0;
+    for (guint i = 0; i < order->len; i++)
+    {
+        char *path = (char *)g_ptr_array_index (order, i);
+        if (_lf_live_update_file (data->Files, path))
+            dirty = true;
+        if (!g_hash_table_lookup (data->Files, path))
+        {
+            g_free (path);
+            continue;
+        }
+        if (n >= data->Order->len ||
+            strcmp (path, (const char *)g_ptr_array_index (data->Order, n)))
+            dirty = true;
+        g_ptr_array_index (order, n++) = path;
+    }
+    g_ptr_array_set_size (order, n);
+    if (n != data->Order->len)
+        dirty = true;
+
+    if (dirty)
+    {
+        lfLiveSnapshot *snapshot = g_new (lfLiveSnapshot, 1);
+        snapshot->DB = new lfDatabase ();
+        snapshot->Refs = 1;
+        for (guint i = 0; i < order->len; i++)
+        {
+            lfLiveFile *file = (lfLiveFile *)g_hash_table_lookup (
+                data->Files, g_ptr_array_index (order, i));
+            snapshot->DB->Merge (file->DB);
+        }
+        snapshot->DB->SortObjects ();
+
+        // Forget files which are gone
+        for (guint i = 0; i < data->Order->len; i++)
+        {
+            char *path = (char *)g_ptr_array_index (data->Order, i);
+            guint j;
+            for (j = 0; j < order->len; j++)
+                if (!strcmp (path, (const char *)g_ptr_array_index (order, j)))
+                    break;
+            if (j == order->len)
+                g_hash_table_remove (data->Files, path);
+            g_free (path);
+        }
+        g_ptr_array_free (data->Order, TRUE);
+        data->Order = order;
+
+        LIVE_LOCK (data);
+        lfLiveSnapshot *old = data->Current;
+        data->Current = snapshot;
+        g_ptr_array_add (data->Snapshots, snapshot);
+        LIVE_UNLOCK (data);
+
+        if (old)
+            Release (old->DB);
+    }
+    else
+    {
+        for (guint i = 0; i < order->len; i++)
+            g_free (g_ptr_array_index (order, i));
+        g_ptr_array_free (order, TRUE);
+    }
+
+    lfError e = data->Order->len ? LF_NO_ERROR : LF_NO_DATABASE;
+
+    RELOAD_UNLOCK (data);
+
+    if (changed)
+        *changed = dirty;
+    return e;
+}
+
+const lfDatabase *lfLiveDatabase::Acquire ()
+{
+    lfLiveDatabaseData *data = (lfLiveDatabaseData *)Data;
+    const lfDatabase *db = NULL;
+
+    LIVE_LOCK (data);
+    if (data->Current)
+    {
+        data->Current->Refs++;
+        db = data->Current->DB;
+    }
+    LIVE_UNLOCK (data);
+
+    return db;
+}
+
+void lfLiveDatabase::Release (const lfDatabase *db)
+{
+    lfLiveDatabaseData *data = (lfLiveDatabaseData *)Data;
+    lfLiveSnapshot *unused = NULL;
+
+    if (!db)
+        return;
+
+    LIVE_LOCK (data);
+    for (guint i = 0; i < data->Snapshots->len; i++)
+    {
+        lfLiveSnapshot *snapshot =
+            (lfLiveSnapshot *)g_ptr_array_index (data->Snapshots, i);
+        if (snapshot->DB == db)
+        {
+            if (!--snapshot->Refs)
+            {
+                g_ptr_array_remove_index_fast (data->Snapshots, i);
+                if (data->Current == snapshot)
+                    data->Current = NULL;
+                unused = snapshot;
+            }
+            break;
+        }
+    }
+    LIVE_UNLOCK (data);
+
+    // Destroy it outside of the lock, so that other threads go on
+    if (unused)
+    {
+        delete unused->DB;
+        g_free (unused);
+    }
+}
+
+//---------------------------// The C interface //---------------------------//
+
+lfLiveDatabase *lf_live_db_new (void)
+{
+    return new lfLiveDatabase ();
+}
+
+void lf_live_db_destroy (lfLiveDatabase *live)
+{
+    delete live;
+}
+
+void lf_live_db_add_location (lfLiveDatabase *live, const char *pathname)
+{
+    live->AddLocation (pathname);
+}
+
+lfError lf_live_db_reload (lfLiveDatabase *live, cbool *changed)
+{
+    bool ch;
+    lfError e = live->Reload (&ch);
+    if (changed)
+        *changed = ch;
+    return e;
+}
+
+const lfDatabase *lf_live_db_acquire (lfLiveDatabase *live)
+{
+    return live->Acquire ();
+}
+
+void lf_live_db_release (lfLiveDatabase *live, const lfDatabase *db)
+{
+    live->Release (db);
+}
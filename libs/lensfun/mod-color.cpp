@@ -134,13 +134,17 @@ bool lfModifier::ApplyColorModification (
     x = x * NormScale - CenterX;
     y = y * NormScale - CenterY;
 
+    lfModifierStatsData *stats = _lf_stats_active (Stats);
+
     for (; height; y += NormScale, height--)
     {
         for (int i = 0; i < (int)((GPtrArray *)ColorCallbacks)->len; i++)
         {
             lfColorCallbackData *cd =
                 (lfColorCallbackData *)g_ptr_array_index ((GPtrArray *)ColorCallbacks, i);
+            gint64 start = _lf_stats_start (stats);
             cd->callback (cd->data, x, y, pixels, comp_role, width);
+            _lf_stats_add (stats, LF_STATS_COLOR, i, width, start);
         }
         pixels = ((char *)pixels) + row_stride;
     }
@@ -328,6 +332,35 @@ template<typename T> void lfModifier::ModifyColor_DeVignetting_PA (
     }
 }
 
+const char *lfModifier::GetColorCallbackName (lfModifyColorFunc callback)
+{
+#define CALLBACK_NAME(func, type) \
+    if (callback == (lfModifyColorFunc)(void (*)(void *, float, float, type *, int, int)) \
+        lfModifier::func) \
+        return #func;
+
+#define CALLBACK_NAMES(func) \
+    CALLBACK_NAME (func, lf_u8) \
+    CALLBACK_NAME (func, lf_u16) \
+    CALLBACK_NAME (func, lf_u32) \
+    CALLBACK_NAME (func, lf_f32) \
+    CALLBACK_NAME (func, lf_f64)
+
+    CALLBACK_NAMES (ModifyColor_Vignetting_PA)
+    CALLBACK_NAMES (ModifyColor_DeVignetting_PA)
+#ifdef VECTORIZATION_SSE
+    CALLBACK_NAME (ModifyColor_DeVignetting_PA_SSE, lf_f32)
+#endif
+#ifdef VECTORIZATION_SSE2
+    CALLBACK_NAME (ModifyColor_DeVignetting_PA_SSE2, lf_u16)
+#endif
+
+#undef CALLBACK_NAMES
+#undef CALLBACK_NAME
+
+    return "user";
+}
+
 //---------------------------// The C interface //---------------------------//
 
 void lf_modifier_add_color_callback (
@@ -15,6 +15,14 @@
 #include "lensfunprv.h"
 #include <xmmintrin.h>
 
+#if defined (_MSC_VER)
+#define PREFIX_ALIGN __declspec(align(16))
+#define SUFFIX_ALIGN
+#else
+#define PREFIX_ALIGN
+#define SUFFIX_ALIGN __attribute__ ((aligned (16)))
+#endif
+
 #if defined (_MSC_VER)
 typedef size_t uintptr_t;
 #else
@@ -32,13 +40,22 @@ void lfModifier::ModifyCoord_UnDist_PTLens_SSE (void *data, float *iocoord, int
     return ModifyCoord_UnDist_PTLens(data, iocoord, count);
   }
 
-  float *param = (float *)data;
+  const lfUnDistPTLensData *param = (lfUnDistPTLensData *)data;
 
-  __m128 a_ = _mm_set_ps1 (param [0]);
-  __m128 b_ = _mm_set_ps1 (param [1]);
-  __m128 c_ = _mm_set_ps1 (param [2]);
+  __m128 a_ = _mm_set_ps1 (param->a_);
+  __m128 b_ = _mm_set_ps1 (param->b_);
+  __m128 c_ = _mm_set_ps1 (param->c_);
   __m128 very_small = _mm_set_ps1 (1e-15);
   __m128 one = _mm_set_ps1 (1.0f);
+  __m128 eps = _mm_set_ps1 (NEWTON_EPS);
+  __m128 sign_mask = _mm_set_ps1 (-0.0f);
+
+  // This is most likely faster than loading form L1 cache
+  __m128 two = _mm_add_ps (one, one);
+  __m128 three = _mm_add_ps (one, two);
+  __m128 four = _mm_add_ps (two, two);
+
+  lfModifierStatsData *stats = _lf_stats_active (param->inverse.Stats);
 
   // SSE Loop processes 4 pixels/loop
   int loop_count = count / 4;
@@ -52,21 +69,25 @@ void lfModifier::ModifyCoord_UnDist_PTLens_SSE (void *data, float *iocoord, int
     __m128 rd = _mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y));
 
     // We don't check for zero, but set it to a very small value instead
-    rd = _mm_max_ps (rd, very_small);
-    rd = _mm_rcp_ps (_mm_rsqrt_ps (rd));
-    __m128 ru = rd;
-    for (int step = 0; step < 4; step++)
+    rd = _mm_sqrt_ps (_mm_max_ps (rd, very_small));
+
+    // Start values from the tabulated inverse, see lfRadialInverse
+    PREFIX_ALIGN float seed [4] SUFFIX_ALIGN;
+    _mm_store_ps (seed, rd);
+    for (int j = 0; j < 4; j++)
+      seed [j] = param->inverse.Seed (seed [j]);
+    __m128 ru = _mm_load_ps (seed);
+
+    __m128 fru;
+    for (int step = 0; ; step++)
     {
       // fru = ru * (a_ * ru^2 * ru + b_ * ru^2 + c_ * ru + 1) - rd
       __m128 ru_sq =  _mm_mul_ps (ru, ru);
-      __m128 fru = _mm_mul_ps (_mm_mul_ps (a_, ru), ru_sq);
+      fru = _mm_mul_ps (_mm_mul_ps (a_, ru), ru_sq);
       __m128 t = _mm_add_ps (_mm_mul_ps (b_, ru_sq), _mm_add_ps (one, _mm_mul_ps (c_, ru)));
       fru = _mm_sub_ps (_mm_mul_ps (_mm_add_ps (t, fru), ru), rd);
-
-      // This is most likely faster than loading form L1 cache
-      __m128 two = _mm_add_ps (one, one);
-      __m128 three = _mm_add_ps (one, two);
-      __m128 four = _mm_add_ps (two, two);
+      if (step == 2)
+        break;
 
       // corr =  4 * a * ru * ru^2 + 3 * b * ru^2 + 2 * c * ru + d
       __m128 corr = _mm_mul_ps (c_, ru);
@@ -78,15 +99,37 @@ void lfModifier::ModifyCoord_UnDist_PTLens_SSE (void *data, float *iocoord, int
       // ru -= fru * corr
       ru = _mm_sub_ps (ru, _mm_mul_ps (fru, corr));
     }
-    // We don't check for zero, but set it to a very small value instead
-    ru = _mm_max_ps (ru, very_small);
-
-    // ru /= rd
-    ru = _mm_mul_ps (ru, _mm_rcp_ps(rd));
-    c0 = _mm_mul_ps (c0, ru);
-    c1 = _mm_mul_ps (c1, ru);
-    _mm_store_ps (&iocoord [8 * i], c0);
-    _mm_store_ps (&iocoord [8 * i + 4], c1);
+    // Pixels which are not converged after two steps, or which have a
+    // non-positive radius, are left to the scalar code with its fallback.
+    int failed = _mm_movemask_ps (_mm_or_ps (
+      _mm_cmpge_ps (_mm_andnot_ps (sign_mask, fru), eps),
+      _mm_cmple_ps (ru, very_small)));
+
+    // The vectorized pixels all take two steps; the scalar code counts the
+    // failed ones itself.
+    if (stats)
+      _lf_stats_count (&stats->NewtonSteps [2],
+                       4 - ((failed & 1) + (failed >> 1 & 1) +
+                            (failed >> 2 & 1) + (failed >> 3 & 1)));
+
+    // ru /= rd; ru holds one factor per pixel, c0 and c1 hold (x, y) pairs
+    ru = _mm_div_ps (ru, rd);
+    _mm_store_ps (&iocoord [8 * i], _mm_mul_ps (c0, _mm_shuffle_ps (ru, ru, _MM_SHUFFLE (1, 1, 0, 0))));
+    _mm_store_ps (&iocoord [8 * i + 4], _mm_mul_ps (c1, _mm_shuffle_ps (ru, ru, _MM_SHUFFLE (3, 3, 2, 2))));
+
+    if (failed)
+    {
+      PREFIX_ALIGN float original [8] SUFFIX_ALIGN;
+      _mm_store_ps (original, c0);
+      _mm_store_ps (original + 4, c1);
+      for (int j = 0; j < 4; j++)
+        if (failed & (1 << j))
+        {
+          iocoord [8 * i + 2 * j] = original [2 * j];
+          iocoord [8 * i + 2 * j + 1] = original [2 * j + 1];
+          ModifyCoord_UnDist_PTLens (data, &iocoord [8 * i + 2 * j], 1);
+        }
+    }
   }
 
   loop_count *= 4;
@@ -130,8 +173,9 @@ void lfModifier::ModifyCoord_Dist_PTLens_SSE (void *data, float *iocoord, int co
     __m128 poly3 = _mm_mul_ps (_mm_mul_ps (a_, ru2), ru);
     t = _mm_add_ps (t, _mm_mul_ps (ru, c_));
     poly3 = _mm_add_ps (t, _mm_add_ps (poly3, one));
-    _mm_store_ps (&iocoord [8 * i], _mm_mul_ps (poly3, c0));
-    _mm_store_ps (&iocoord [8 * i + 4], _mm_mul_ps (poly3, c1));
+    // poly3 holds one factor per pixel, c0 and c1 hold (x, y) pairs
+    _mm_store_ps (&iocoord [8 * i], _mm_mul_ps (_mm_shuffle_ps (poly3, poly3, _MM_SHUFFLE (1, 1, 0, 0)), c0));
+    _mm_store_ps (&iocoord [8 * i + 4], _mm_mul_ps (_mm_shuffle_ps (poly3, poly3, _MM_SHUFFLE (3, 3, 2, 2)), c1));
   }
 
   loop_count *= 4;
@@ -168,8 +212,9 @@ void lfModifier::ModifyCoord_Dist_Poly3_SSE (void *data, float *iocoord, int cou
 
     // Calculate poly3 = k1_ * ru * ru + 1;
     __m128 poly3 = _mm_add_ps (_mm_mul_ps (_mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y)), k1_), one);
-    _mm_store_ps (&iocoord [8 * i], _mm_mul_ps (poly3, c0));
-    _mm_store_ps (&iocoord [8 * i + 4], _mm_mul_ps (poly3, c1));
+    // poly3 holds one factor per pixel, c0 and c1 hold (x, y) pairs
+    _mm_store_ps (&iocoord [8 * i], _mm_mul_ps (_mm_shuffle_ps (poly3, poly3, _MM_SHUFFLE (1, 1, 0, 0)), c0));
+    _mm_store_ps (&iocoord [8 * i + 4], _mm_mul_ps (_mm_shuffle_ps (poly3, poly3, _MM_SHUFFLE (3, 3, 2, 2)), c1));
   }
 
   loop_count *= 4;
@@ -178,4 +223,65 @@ void lfModifier::ModifyCoord_Dist_Poly3_SSE (void *data, float *iocoord, int cou
     ModifyCoord_Dist_Poly3 (data, &iocoord [loop_count * 2], remain);
 }
 
+void lfModifier::ModifyCoord_Perspective_Correction_SSE (void *data, float *iocoord, int count)
+{
+  /*
+   * If buffer is not aligned, fall back to plain code
+   */
+  if((uintptr_t)(iocoord) & 0xf)
+  {
+    return ModifyCoord_Perspective_Correction(data, iocoord, count);
+  }
+
+  float *param = (float *)data;
+
+  // The projective transform is linear in x and y up to the final division
+  // by z_, so numerators and denominator are plain multiply-adds.
+  __m128 A11 = _mm_set_ps1 (param [0]);
+  __m128 A12 = _mm_set_ps1 (param [1]);
+  __m128 A13 = _mm_set_ps1 (param [2]);
+  __m128 A21 = _mm_set_ps1 (param [3]);
+  __m128 A22 = _mm_set_ps1 (param [4]);
+  __m128 A23 = _mm_set_ps1 (param [5]);
+  __m128 A31 = _mm_set_ps1 (param [6]);
+  __m128 A32 = _mm_set_ps1 (param [7]);
+  __m128 A33 = _mm_set_ps1 (param [8]);
+  __m128 Delta_a = _mm_set_ps1 (param [9]);
+  __m128 Delta_b = _mm_set_ps1 (param [10]);
+  __m128 two = _mm_set_ps1 (2.0f);
+  __m128 zero = _mm_setzero_ps ();
+  __m128 far_away = _mm_set_ps1 (1.6e16F);
+
+  // SSE Loop processes 4 pixels/loop
+  int loop_count = count / 4;
+  for (int i = 0; i < loop_count ; i++)
+  {
+    __m128 c0 = _mm_load_ps (&iocoord [8 * i]);
+    __m128 c1 = _mm_load_ps (&iocoord [8 * i + 4]);
+    __m128 x = _mm_add_ps (_mm_shuffle_ps (c0, c1, _MM_SHUFFLE (2, 0, 2, 0)), Delta_a);
+    __m128 y = _mm_add_ps (_mm_shuffle_ps (c0, c1, _MM_SHUFFLE (3, 1, 3, 1)), Delta_b);
+
+    __m128 z_ = _mm_add_ps (_mm_add_ps (_mm_mul_ps (A31, x), _mm_mul_ps (A32, y)), A33);
+    __m128 u = _mm_add_ps (_mm_add_ps (_mm_mul_ps (A11, x), _mm_mul_ps (A12, y)), A13);
+    __m128 v = _mm_add_ps (_mm_add_ps (_mm_mul_ps (A21, x), _mm_mul_ps (A22, y)), A23);
+
+    // Approximated reciprocal, refined by one Newton step: r = r * (2 - z_ * r)
+    __m128 r = _mm_rcp_ps (z_);
+    r = _mm_mul_ps (r, _mm_sub_ps (two, _mm_mul_ps (z_, r)));
+
+    // Points behind the camera are moved far away, without branching
+    __m128 visible = _mm_cmpgt_ps (z_, zero);
+    u = _mm_or_ps (_mm_and_ps (visible, _mm_mul_ps (u, r)), _mm_andnot_ps (visible, far_away));
+    v = _mm_or_ps (_mm_and_ps (visible, _mm_mul_ps (v, r)), _mm_andnot_ps (visible, far_away));
+
+    _mm_store_ps (&iocoord [8 * i], _mm_unpacklo_ps (u, v));
+    _mm_store_ps (&iocoord [8 * i + 4], _mm_unpackhi_ps (u, v));
+  }
+
+  loop_count *= 4;
+  int remain = count - loop_count;
+  if (remain)
+    ModifyCoord_Perspective_Correction (data, &iocoord [loop_count * 2], remain);
+}
+
 #endif
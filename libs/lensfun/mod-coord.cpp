@@ -29,8 +29,54 @@
 #include "lensfun.h"
 #include "lensfunprv.h"
 #include <math.h>
+#include <map>
+#include <string>
+#include <vector>
 #include "windows/mathconstants.h"
 
+/*
+  Residual functors for the Newton iterations of the undistortion callbacks,
+  see _lf_newton_radial().  They are evaluated in double precision.
+*/
+
+struct lfPoly3Residual
+{
+    double inv_k1_;
+
+    // Original function: Rd = k1_ * Ru^3 + Ru
+    // Target function:   k1_ * Ru^3 + Ru - Rd = 0
+    // Divide by k1_:     Ru^3 + Ru/k1_ - Rd/k1_ = 0
+    // Derivative:        3 * Ru^2 + 1/k1_
+    double operator () (double ru, double rd, double &prime) const
+    {
+        prime = 3 * ru * ru + inv_k1_;
+        return ru * ru * ru + (ru - rd) * inv_k1_;
+    }
+};
+
+struct lfPoly5Residual
+{
+    double k1, k2;
+
+    double operator () (double ru, double rd, double &prime) const
+    {
+        double ru2 = ru * ru;
+        prime = 1.0 + 3 * k1 * ru2 + 5 * k2 * ru2 * ru2;
+        return ru * (1.0 + k1 * ru2 + k2 * ru2 * ru2) - rd;
+    }
+};
+
+struct lfPTLensResidual
+{
+    double a_, b_, c_;
+
+    double operator () (double ru, double rd, double &prime) const
+    {
+        prime = 4 * a_ * ru * ru * ru + 3 * b_ * ru * ru + 2 * c_ * ru + 1;
+        return ru * (a_ * ru * ru * ru + b_ * ru * ru + c_ * ru + 1) - rd;
+    }
+};
+
 void lfModifier::AddCoordCallback (
     lfModifyCoordFunc callback, int priority, void *data, size_t data_size)
 {
@@ -44,39 +90,58 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
     float tmp [7];
 
     if (reverse)
+    {
+        // The largest distorted radius to be tabulated for the Newton start
+        // values.  The margin accounts for decentered lenses and for
+        // callbacks which are applied before this one.
+        const double rd_max = 1.5 * sqrt (MaxX * MaxX + MaxY * MaxY);
+
         switch (model.Model)
         {
             case LF_DIST_MODEL_POLY3:
+            {
                 if (!model.Terms [0])
                     return false;
                 // See "Note about PT-based distortion models" at the top of
                 // this file.
-                tmp [0] = pow (1 - model.Terms [0], 3) / model.Terms [0];
-                AddCoordCallback (ModifyCoord_UnDist_Poly3, 250,
-                                  tmp, sizeof (float));
+                lfUnDistPoly3Data d;
+                d.inv_k1_ = pow (1 - model.Terms [0], 3) / model.Terms [0];
+                const lfPoly3Residual f = { d.inv_k1_ };
+                _lf_build_radial_inverse (f, rd_max, &NonConvergedCount, Stats, d.inverse);
+                AddCoordCallback (ModifyCoord_UnDist_Poly3, 250, &d, sizeof (d));
                 break;
+            }
 
             case LF_DIST_MODEL_POLY5:
-                AddCoordCallback (ModifyCoord_UnDist_Poly5, 250,
-                                  model.Terms, sizeof (float) * 2);
+            {
+                lfUnDistPoly5Data d;
+                d.k1 = model.Terms [0];
+                d.k2 = model.Terms [1];
+                const lfPoly5Residual f = { d.k1, d.k2 };
+                _lf_build_radial_inverse (f, rd_max, &NonConvergedCount, Stats, d.inverse);
+                AddCoordCallback (ModifyCoord_UnDist_Poly5, 250, &d, sizeof (d));
                 break;
+            }
 
             case LF_DIST_MODEL_PTLENS:
             {
                 // See "Note about PT-based distortion models" at the top of
                 // this file.
-                float d = 1 - model.Terms [0] - model.Terms [1] - model.Terms [2];
-                tmp [0] = model.Terms [0] / pow (d, 4);
-                tmp [1] = model.Terms [1] / pow (d, 3);
-                tmp [2] = model.Terms [2] / pow (d, 2);
+                lfUnDistPTLensData d;
+                float d_ = 1 - model.Terms [0] - model.Terms [1] - model.Terms [2];
+                d.a_ = model.Terms [0] / pow (d_, 4);
+                d.b_ = model.Terms [1] / pow (d_, 3);
+                d.c_ = model.Terms [2] / pow (d_, 2);
+                const lfPTLensResidual f = { d.a_, d.b_, d.c_ };
+                _lf_build_radial_inverse (f, rd_max, &NonConvergedCount, Stats, d.inverse);
 #ifdef VECTORIZATION_SSE
                 if (_lf_detect_cpu_features () & LF_CPU_FLAG_SSE)
                     AddCoordCallback (ModifyCoord_UnDist_PTLens_SSE, 250,
-                                      tmp, sizeof (float) * 3);
+                                      &d, sizeof (d));
                 else
 #endif
                 AddCoordCallback (ModifyCoord_UnDist_PTLens, 250,
-                                  tmp, sizeof (float) * 3);
+                                  &d, sizeof (d));
                 break;
             }
             case LF_DIST_MODEL_ACM:
@@ -87,6 +152,7 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
             default:
                 return false;
         }
+    }
     else
         switch (model.Model)
         {
@@ -153,65 +219,147 @@ double lfModifier::AutoscaleResidualDistance (float *coord) const
     return intermediate > result ? intermediate : result;
 }
 
-float lfModifier::GetTransformedDistance (lfPoint point) const
+void lfModifier::GetTransformedDistances (
+    const lfPoint *points, int count, float *distances) const
 {
-    double dist = point.dist;
-    double sa = sin (point.angle);
-    double ca = cos (point.angle);
-
-    // We have to find the radius ru in the direction of the given point which
-    // distorts to the original (distorted) image edge.  We will use Newton's
-    // method for minimizing the distance between the distorted point at ru and
-    // the original edge.
-    float ru = dist; // Initial approximation
-    float dx = 0.0001F;
-    for (int countdown = 50; ; countdown--)
+    // We have to find the radius ru in the direction of every point which
+    // distorts to the original (distorted) image edge.  We use the secant
+    // method for minimizing the distance between the distorted point at ru
+    // and the original edge.  It needs only one evaluation of the callbacks
+    // per step instead of two for Newton's method with a numerical
+    // derivative, and all points are evaluated in a single batch.
+    //
+    // Strongly distorting lenses like circular fisheyes cross the edge
+    // several times along a ray, and the nearest crossing is the one we
+    // want.  Once the search has points on both sides of the edge, it never
+    // leaves the interval between them, see below.
+    double sa [8], ca [8], ru [8], ru_prev [8], rd_prev [8], dx [8];
+    double ru_inside [8], ru_outside [8];
+    bool active [8], have_prev [8];
+    int index [8];
+    float res [16];
+
+    for (int i = 0; i < count; i++)
     {
-        float res [2];
+        sa [i] = sin (points [i].angle);
+        ca [i] = cos (points [i].angle);
+        ru [i] = points [i].dist; // Initial approximation
+        dx [i] = 0.0001;
+        ru_inside [i] = ru_outside [i] = -1.0;
+        active [i] = true;
+        have_prev [i] = false;
+    }
 
-        res [0] = ca * ru; res [1] = sa * ru;
-        for (int j = 0; j < (int)((GPtrArray *)CoordCallbacks)->len; j++)
-        {
-            lfCoordCallbackData *cd =
-                (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, j);
-            cd->callback (cd->data, res, 1);
-        }
-        double rd = AutoscaleResidualDistance (res);
-        if (rd > -NEWTON_EPS * 100 && rd < NEWTON_EPS * 100)
+    for (int countdown = 100; ; countdown--)
+    {
+        int n = 0;
+        for (int i = 0; i < count; i++)
+            if (active [i])
+            {
+                res [n * 2] = ca [i] * ru [i];
+                res [n * 2 + 1] = sa [i] * ru [i];
+                index [n++] = i;
+            }
+        if (!n)
             break;
 
-        if (!countdown)
-            // e.g. for some ultrawide fisheyes corners extend to infinity
-            // so function never converge ...
-            return -1;
-
-        // Compute approximative function prime in (x,y)
-        res [0] = ca * (ru + dx); res [1] = sa * (ru + dx);
         for (int j = 0; j < (int)((GPtrArray *)CoordCallbacks)->len; j++)
         {
             lfCoordCallbackData *cd =
                 (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, j);
-            cd->callback (cd->data, res, 1);
+            cd->callback (cd->data, res, n);
         }
-        double rd1 = AutoscaleResidualDistance (res);
 
-        // If rd1 is very close to rd, this means our delta is too small
-        // and we can hit the precision limit of the float format...
-        if (absolute (rd1 - rd) < 0.00001)
+        for (int j = 0; j < n; j++)
         {
-            dx *= 2;
-            continue;
-        }
+            int i = index [j];
+            double rd = AutoscaleResidualDistance (res + j * 2);
+            if (rd > -NEWTON_EPS * 100 && rd < NEWTON_EPS * 100)
+            {
+                distances [i] = ru [i];
+                active [i] = false;
+                continue;
+            }
 
-        // dy/dx;
-        double prime = (rd1 - rd) / dx;
+            if (!countdown)
+            {
+                // e.g. for some ultrawide fisheyes corners extend to infinity
+                // so function never converge ...
+                distances [i] = -1;
+                active [i] = false;
+                continue;
+            }
 
-        ru -= rd / prime;
+            if (rd < 0)
+                ru_inside [i] = ru [i];
+            else
+                ru_outside [i] = ru [i];
+
+            double step;
+            // If rd is very close to the previous value, the secant is
+            // useless because we hit the precision limit of the float
+            // format.  Then, and for the very first step, we probe with a
+            // forward difference which is widened every time.
+            if (have_prev [i] && absolute (rd - rd_prev [i]) >= 0.00001)
+                step = -rd * (ru [i] - ru_prev [i]) / (rd - rd_prev [i]);
+            else
+            {
+                if (have_prev [i])
+                    dx [i] *= 2;
+                step = dx [i];
+            }
+            ru_prev [i] = ru [i];
+            rd_prev [i] = rd;
+            have_prev [i] = true;
+            // A secant through a steep part may overshoot to the opposite
+            // direction, where another root can be found; stay on this side.
+            // Likewise, bisect rather than leave a bracket of the crossing.
+            double next = ru [i] + step > 0.0 ? ru [i] + step : ru [i] * 0.5;
+            if (ru_inside [i] >= 0 && ru_outside [i] >= 0)
+            {
+                double low = ru_inside [i], high = ru_outside [i];
+                if (low > high)
+                    low = ru_outside [i], high = ru_inside [i];
+                if (!(next > low && next < high))
+                    next = 0.5 * (low + high);
+            }
+            ru [i] = next;
+        }
     }
+}
 
-    return ru;
+size_t lfModifier::GetCallbackKeySize (lfModifyCoordFunc callback, size_t data_size)
+{
+    // Only the float parameters in front of the tabulated inverse count.  The
+    // table follows from them and from MaxX, MaxY, and it points to the
+    // counter of the modifier.
+    if (callback == ModifyCoord_UnDist_Poly3)
+        return 1 * sizeof (float);
+    if (callback == ModifyCoord_UnDist_Poly5)
+        return 2 * sizeof (float);
+    if (callback == ModifyCoord_UnDist_PTLens)
+        return 3 * sizeof (float);
+#ifdef VECTORIZATION_SSE
+    if (callback == ModifyCoord_UnDist_PTLens_SSE)
+        return 3 * sizeof (float);
+#endif
+    return data_size;
 }
 
+// Process-wide cache of the results of lfModifier::GetAutoScale
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+static GMutex autoscale_cache_lock;
+#define AUTOSCALE_CACHE_LOCK() g_mutex_lock (&autoscale_cache_lock)
+#define AUTOSCALE_CACHE_UNLOCK() g_mutex_unlock (&autoscale_cache_lock)
+#else
+static GStaticMutex autoscale_cache_lock = G_STATIC_MUTEX_INIT;
+#define AUTOSCALE_CACHE_LOCK() g_static_mutex_lock (&autoscale_cache_lock)
+#define AUTOSCALE_CACHE_UNLOCK() g_static_mutex_unlock (&autoscale_cache_lock)
+#endif
+static std::map<std::string, float> autoscale_cache;
+// The cache is emptied when it grows beyond this number of entries
+#define AUTOSCALE_CACHE_SIZE 1024
+
 float lfModifier::GetAutoScale (bool reverse)
 {
     // Compute the scale factor automatically
@@ -220,6 +368,35 @@ float lfModifier::GetAutoScale (bool reverse)
     if (((GPtrArray *)CoordCallbacks)->len == 0)
         return subpixel_scale;
 
+    // The cache key consists of everything the result depends on: the image
+    // geometry and the parameters of all coordinate callbacks.  Callbacks
+    // whose data belongs to the caller may change it at any time, so they
+    // prevent caching.
+    const double geometry [] =
+        { Width, Height, NormScale, MaxX, MaxY, subpixel_scale, reverse ? 1.0 : 0.0 };
+    std::string key ((const char *)geometry, sizeof (geometry));
+    bool cacheable = true;
+    for (int i = 0; i < (int)((GPtrArray *)CoordCallbacks)->len && cacheable; i++)
+    {
+        lfCoordCallbackData *cd =
+            (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, i);
+        key.append ((const char *)&cd->callback, sizeof (cd->callback));
+        key.append ((const char *)&cd->priority, sizeof (cd->priority));
+        key.append ((const char *)cd->data, GetCallbackKeySize (cd->callback, cd->data_size));
+        cacheable = cd->data_size != 0;
+    }
+
+    if (cacheable)
+    {
+        AUTOSCALE_CACHE_LOCK ();
+        std::map<std::string, float>::const_iterator it = autoscale_cache.find (key);
+        bool found = it != autoscale_cache.end ();
+        float scale = found ? it->second : 0.0;
+        AUTOSCALE_CACHE_UNLOCK ();
+        if (found)
+            return scale;
+    }
+
     // 3 2 1
     // 4   0
     // 5 6 7
@@ -240,11 +417,13 @@ float lfModifier::GetAutoScale (bool reverse)
     point [0].dist = point [4].dist = Width * 0.5 * NormScale;
     point [2].dist = point [6].dist = Height * 0.5 * NormScale;
 
+    float transformed_distance [8];
+    GetTransformedDistances (point, 8, transformed_distance);
+
     float scale = 0.01F;
     for (int i = 0; i < 8; i++)
     {
-        float transformed_distance = GetTransformedDistance (point [i]);
-        float point_scale = point [i].dist / transformed_distance;
+        float point_scale = point [i].dist / transformed_distance [i];
         if (point_scale > scale)
             scale = point_scale;
     }
@@ -254,6 +433,295 @@ float lfModifier::GetAutoScale (bool reverse)
     scale *= 1.001;
     scale *= subpixel_scale;
 
+    float result = reverse ? 1.0 / scale : scale;
+
+    if (cacheable)
+    {
+        AUTOSCALE_CACHE_LOCK ();
+        if (autoscale_cache.size () >= AUTOSCALE_CACHE_SIZE)
+            autoscale_cache.clear ();
+        autoscale_cache [key] = result;
+        AUTOSCALE_CACHE_UNLOCK ();
+    }
+
+    return result;
+}
+
+/*
+  Apply the coordinate callbacks to a batch of points and check which of them
+  land within the original image frame, given by its left, right, top, and
+  bottom edge.  NaNs count as outside.
+*/
+static void _lf_check_frame (GPtrArray *callbacks, const double *frame,
+                             float *coord, int count, char *inside)
+{
+    for (unsigned j = 0; j < callbacks->len; j++)
+    {
+        lfCoordCallbackData *cd =
+            (lfCoordCallbackData *)g_ptr_array_index (callbacks, j);
+        cd->callback (cd->data, coord, count);
+    }
+    for (int i = 0; i < count; i++)
+        inside [i] = coord [i * 2] >= frame [0] && coord [i * 2] <= frame [1] &&
+            coord [i * 2 + 1] >= frame [2] && coord [i * 2 + 1] <= frame [3];
+}
+
+/// Number of grid cells per axis for lfModifier::GetAutoCrop
+#define AUTOCROP_GRID 128
+/// Number of bisection steps for the border of the valid area
+#define AUTOCROP_BISECTIONS 10
+
+/*
+  Scaling happens about the optical centre, so the side of a rectangle which
+  first reaches the frame limits the scale, and whatever lies beyond the
+  frame at that scale is lost.  Try the scale of each side in turn, clip the
+  rectangle to the frame, and return the part with the largest area in the
+  scaled image together with that area.  Magnification beyond 1 adds no
+  detail, so it is not counted.
+*/
+static double _lf_autocrop_clip (const double *side, const double *frame,
+                                 double *clipped)
+{
+    double best = 0.0;
+    for (int k = 0; k < 4; k++)
+    {
+        double scale = side [k] * frame [k] > 0.0 ? frame [k] / side [k] : 1.0;
+        if (scale > 1.0)
+            scale = 1.0;
+        double rect [4];
+        for (int l = 0; l < 4; l++)
+        {
+            double limit = frame [l] / scale;
+            rect [l] = l & 1 ? (side [l] < limit ? side [l] : limit) :
+                (side [l] > limit ? side [l] : limit);
+        }
+        if (rect [0] >= rect [1] || rect [2] >= rect [3])
+            continue;
+        double area = (rect [1] - rect [0]) * (rect [3] - rect [2]) * scale * scale;
+        if (area > best)
+        {
+            best = area;
+            memcpy (clipped, rect, sizeof (rect));
+        }
+    }
+    return best;
+}
+
+/*
+  Check the whole outline of a rectangle, given by its edges in pixel
+  coordinates, against the original image frame.  This goes through
+  ApplyGeometryDistortion pixel by pixel, so that it sees exactly what the
+  caller will see.
+*/
+static bool _lf_autocrop_check (const lfModifier *modifier, const double *rect,
+                                double width, double height, std::vector<float> &buffer)
+{
+    for (int k = 0; k < 4; k++)
+    {
+        // The left, right, top, and bottom side in turn.  All whole pixel
+        // steps from the start of a side are done in one go, and its end,
+        // which is generally no whole number of pixels away, separately.
+        const bool horizontal = k >= 2;
+        const double start = horizontal ? rect [0] : rect [2];
+        const double end = horizontal ? rect [1] : rect [3];
+        const double x = horizontal ? rect [0] : rect [k];
+        const double y = horizontal ? rect [k] : rect [2];
+        int count = (int)ceil (end - start) + 1;
+        if (count < 2)
+            count = 2;
+        if ((int)buffer.size () < count * 2)
+            buffer.resize (count * 2);
+        float *res = &buffer [0];
+        // Without any callbacks, every pixel stays where it is
+        if (!modifier->ApplyGeometryDistortion (x, y, horizontal ? count - 1 : 1,
+                                                horizontal ? 1 : count - 1, res))
+            return true;
+        modifier->ApplyGeometryDistortion (horizontal ? end : x, horizontal ? y : end,
+                                           1, 1, res + (count - 1) * 2);
+        for (int i = 0; i < count; i++)
+            if (!(res [i * 2] >= 0.0 && res [i * 2] <= width &&
+                  res [i * 2 + 1] >= 0.0 && res [i * 2 + 1] <= height))
+                return false;
+    }
+    return true;
+}
+
+float lfModifier::GetAutoCrop (bool reverse, float *crop)
+{
+    GPtrArray *callbacks = (GPtrArray *)CoordCallbacks;
+    const float subpixel_scale = ((GPtrArray *)SubpixelCallbacks)->len == 0 ? 1.0 : 1.001;
+
+    // The lens centre may be off the image centre, so the frame need not be
+    // symmetric about the origin.
+    const double frame [4] = { -CenterX, Width * NormScale - CenterX,
+                               -CenterY, Height * NormScale - CenterY };
+
+    // The grid covers twice the frame in both directions, because
+    // pincushion correction makes the valid area larger than the image.
+    const int n = AUTOCROP_GRID;
+    const double x_min = 2 * frame [0], dx = 2 * (frame [1] - frame [0]) / n;
+    const double y_min = 2 * frame [2], dy = 2 * (frame [3] - frame [2]) / n;
+
+    std::vector<float> coord ((n + 1) * 2);
+    std::vector<char> node ((n + 1) * (n + 1));
+    for (int j = 0; j <= n; j++)
+    {
+        for (int i = 0; i <= n; i++)
+        {
+            coord [i * 2] = x_min + i * dx;
+            coord [i * 2 + 1] = y_min + j * dy;
+        }
+        _lf_check_frame (callbacks, frame, &coord [0], n + 1, &node [j * (n + 1)]);
+    }
+
+    // Find the rectangle of cells with all corners valid that keeps most of
+    // the scaled image, see _lf_autocrop_clip.  Every row of cells is treated
+    // as a histogram of the number of valid cells above, and its maximal
+    // rectangles are found with a stack.
+    std::vector<int> height (n + 1, 0), stack (n + 1);
+    double best_area = 0.0, side [4], clipped [4];
+    int left = 0, right = 0, top = 0, bottom = 0;
+    for (int j = 0; j < n; j++)
+    {
+        const char *upper = &node [j * (n + 1)], *lower = upper + n + 1;
+        for (int i = 0; i < n; i++)
+            height [i] = upper [i] && upper [i + 1] && lower [i] && lower [i + 1] ?
+                height [i] + 1 : 0;
+        height [n] = 0;
+
+        int depth = 0;
+        for (int i = 0; i <= n; i++)
+        {
+            while (depth && height [stack [depth - 1]] >= height [i])
+            {
+                int h = height [stack [--depth]];
+                int start = depth ? stack [depth - 1] + 1 : 0;
+                if (!h)
+                    continue;
+                side [0] = x_min + start * dx;
+                side [1] = x_min + i * dx;
+                side [2] = y_min + (j + 1 - h) * dy;
+                side [3] = y_min + (j + 1) * dy;
+                double area = _lf_autocrop_clip (side, frame, clipped);
+                if (area > best_area)
+                {
+                    best_area = area;
+                    left = start;
+                    right = i;
+                    top = j + 1 - h;
+                    bottom = j + 1;
+                }
+            }
+            stack [depth++] = i;
+        }
+    }
+    if (best_area == 0.0)
+        return 0.0;
+
+    // Sample the border of the valid area: every grid edge between a valid
+    // and an invalid node is bisected, and the last valid point is kept.
+    std::vector<double> good, bad;
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++)
+        {
+            const char *here = &node [j * (n + 1) + i];
+            for (int k = 0; k < 2; k++)
+            {
+                if (k ? j == n : i == n)
+                    continue;
+                char there = k ? here [n + 1] : here [1];
+                if (*here == there)
+                    continue;
+                double x = x_min + i * dx, y = y_min + j * dy;
+                double x2 = k ? x : x + dx, y2 = k ? y + dy : y;
+                good.push_back (*here ? x : x2);
+                good.push_back (*here ? y : y2);
+                bad.push_back (*here ? x2 : x);
+                bad.push_back (*here ? y2 : y);
+            }
+        }
+    const int border = good.size () / 2;
+    if ((int)coord.size () < border * 2)
+        coord.resize (border * 2);
+    std::vector<char> inside (border);
+    for (int step = 0; step < AUTOCROP_BISECTIONS; step++)
+    {
+        for (int i = 0; i < border * 2; i++)
+            coord [i] = 0.5 * (good [i] + bad [i]);
+        _lf_check_frame (callbacks, frame, &coord [0], border, &inside [0]);
+        for (int i = 0; i < border; i++)
+        {
+            double *target = inside [i] ? &good [i * 2] : &bad [i * 2];
+            target [0] = 0.5 * (good [i * 2] + bad [i * 2]);
+            target [1] = 0.5 * (good [i * 2 + 1] + bad [i * 2 + 1]);
+        }
+    }
+
+    // Push every side of the rectangle outwards up to the next grid line,
+    // but not past any border point within its span.  The rectangle never
+    // contains a border point, no matter where the valid area lies.
+    side [0] = x_min + left * dx;
+    side [1] = x_min + right * dx;
+    side [2] = y_min + top * dy;
+    side [3] = y_min + bottom * dy;
+    for (int k = 0; k < 4; k++)
+    {
+        const int along = k < 2 ? 0 : 1, across = 1 - along;
+        const double sign = k & 1 ? 1.0 : -1.0;
+        double limit = side [k] + sign * (k < 2 ? dx : dy);
+        for (int i = 0; i < border; i++)
+        {
+            double p = good [i * 2 + along], q = good [i * 2 + across];
+            if (q > side [across * 2] && q < side [across * 2 + 1] &&
+                sign * (p - side [k]) > 0 && sign * (p - limit) < 0)
+                limit = p;
+        }
+        side [k] = limit;
+    }
+    _lf_autocrop_clip (side, frame, clipped);
+
+    // Between the border points the valid area may still bulge into the
+    // rectangle, in particular near the corners of the frame.  If the outline
+    // leaves the image, shrink the rectangle about the optical centre; this
+    // raises the scale but leaves the crop in the scaled image as it is.
+    const double centre [2] = { CenterX, CenterY };
+    double low = 0.0, high = 1.0, t = 1.0, rect [4];
+    for (int step = 0; step <= 2 * AUTOCROP_BISECTIONS; step++)
+    {
+        for (int k = 0; k < 4; k++)
+            rect [k] = (t * clipped [k] + centre [k / 2]) * NormUnScale;
+        if (_lf_autocrop_check (this, rect, Width, Height, coord))
+        {
+            low = t;
+            if (!step)
+                break;
+        }
+        else
+            high = t;
+        t = 0.5 * (low + high);
+    }
+    if (low == 0.0)
+        return 0.0;
+    for (int k = 0; k < 4; k++)
+        clipped [k] *= low;
+
+    // The side which first reaches the frame determines the scale.
+    double scale = 0.0;
+    for (int k = 0; k < 4; k++)
+        if (clipped [k] * frame [k] > 0.0 &&
+            (scale == 0.0 || frame [k] / clipped [k] < scale))
+            scale = frame [k] / clipped [k];
+    if (scale == 0.0)
+        return 0.0;
+    scale *= subpixel_scale;
+
+    const double limits [4] = { 0.0, Width, 0.0, Height };
+    for (int k = 0; k < 4; k++)
+    {
+        double c = (clipped [k] * scale + centre [k / 2]) * NormUnScale;
+        crop [k] = k & 1 ? (c < limits [k] ? c : limits [k]) : (c > limits [k] ? c : limits [k]);
+    }
+
     return reverse ? 1.0 / scale : scale;
 }
 
@@ -481,10 +949,78 @@ bool lfModifier::ApplyGeometryDistortion (
     xu = xu * NormScale - CenterX;
     yu = yu * NormScale - CenterY;
 
-    for (float y = yu; height; y += NormScale, height--)
+    NeedRadialTable ();
+    const lfRadialTable *table = (const lfRadialTable *)RadialTable;
+    lfModifierStatsData *stats = _lf_stats_active (Stats);
+    float *const out = res;
+    const int rows = height;
+
+    // For a centred radial chain, samples which mirror each other are only
+    // computed once, see lfRadialTable::MirrorSum.
+    const int mirror_cols = table ? lfRadialTable::MirrorSum (xu, NormScale) : -1;
+    const int mirror_rows = table ? lfRadialTable::MirrorSum (yu, NormScale) : -1;
+    const float mirror_x = 2 * CenterX * NormUnScale;
+    const float mirror_y = 2 * CenterY * NormUnScale;
+    int row = 0;
+
+    for (float y = yu; height; y += NormScale, height--, row++)
     {
         int i;
         float x = xu;
+
+        if (table)
+        {
+            if (stats)
+                _lf_stats_count (&stats->TablePixels, width);
+
+            int mirror = mirror_rows - row;
+            if (mirror >= 0 && mirror < row)
+            {
+                const float *src = res - (row - mirror) * width * 2;
+                for (i = 0; i < width; i++, src += 2, res += 2)
+                {
+                    res [0] = src [0];
+                    res [1] = mirror_y - src [1];
+                }
+                continue;
+            }
+
+            // A purely radial chain: scale every pixel by the tabulated
+            // factor, and only resort to the callbacks outside the table.
+            for (i = 0; i < width; i++, x += NormScale, res += 2)
+            {
+                mirror = mirror_cols - i;
+                if (mirror >= 0 && mirror < i)
+                {
+                    const float *src = res - (i - mirror) * 2;
+                    res [0] = mirror_x - src [0];
+                    res [1] = src [1];
+                    continue;
+                }
+
+                int j;
+                float t;
+                res [0] = x;
+                res [1] = y;
+                if (table->Locate (x * x + y * y, j, t))
+                {
+                    float f = table->Coord [j] + t * (table->Coord [j + 1] - table->Coord [j]);
+                    res [0] *= f;
+                    res [1] *= f;
+                }
+                else
+                    for (int k = 0; k < (int)((GPtrArray *)CoordCallbacks)->len; k++)
+                    {
+                        lfCoordCallbackData *cd =
+                            (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, k);
+                        cd->callback (cd->data, res, 1);
+                    }
+                res [0] = (res [0] + CenterX) * NormUnScale;
+                res [1] = (res [1] + CenterY) * NormUnScale;
+            }
+            continue;
+        }
+
         for (i = 0; i < width; i++, x += NormScale)
         {
             res [i * 2] = x;
@@ -495,7 +1031,9 @@ bool lfModifier::ApplyGeometryDistortion (
         {
             lfCoordCallbackData *cd =
                 (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, i);
+            gint64 start = _lf_stats_start (stats);
             cd->callback (cd->data, res, width);
+            _lf_stats_add (stats, LF_STATS_COORD, i, width, start);
         }
 
         // Convert normalized coordinates back into natural coordiates
@@ -507,6 +1045,9 @@ bool lfModifier::ApplyGeometryDistortion (
         }
     }
 
+    if (stats)
+        _lf_stats_count_coords (stats, out, width * rows, Width, Height);
+
     return true;
 }
 
@@ -524,7 +1065,8 @@ void lfModifier::ModifyCoord_Scale (void *data, float *iocoord, int count)
 void lfModifier::ModifyCoord_UnDist_Poly3 (void *data, float *iocoord, int count)
 {
     // See "Note about PT-based distortion models" at the top of this file.
-    const float inv_k1_ = *(float *)data;
+    const lfUnDistPoly3Data *param = (lfUnDistPoly3Data *)data;
+    const lfPoly3Residual f = { param->inv_k1_ };
 
     for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
     {
@@ -534,38 +1076,19 @@ void lfModifier::ModifyCoord_UnDist_Poly3 (void *data, float *iocoord, int count
         if (rd == 0.0)
             continue;
 
-        float rd_div_k1_ = rd * inv_k1_;
-
         // Use Newton's method to avoid dealing with complex numbers
         // When carefully tuned this works almost as fast as Cardano's
         // method (and we don't use complex numbers in it, which is
         // required for a full solution!)
-        //
-        // Original function: Rd = k1_ * Ru^3 + Ru
-        // Target function:   k1_ * Ru^3 + Ru - Rd = 0
-        // Divide by k1_:     Ru^3 + Ru/k1_ - Rd/k1_ = 0
-        // Derivative:        3 * Ru^2 + 1/k1_
-        double ru = rd;
-        for (int step = 0; ; step++)
-        {
-            double fru = ru * ru * ru + ru * inv_k1_ - rd_div_k1_;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_pixel;
-
-            ru -= fru / (3 * ru * ru + inv_k1_);
-        }
+        double ru;
+        if (!_lf_solve_radial (f, param->inverse, rd, ru))
+            continue; // Does not converge, no real solution in this area?
         if (ru < 0.0)
             continue; // Negative radius does not make sense at all
 
         ru /= rd;
         iocoord [0] = x * ru;
         iocoord [1] = y * ru;
-
-    next_pixel:
-        ;
     }
 }
 
@@ -588,9 +1111,8 @@ void lfModifier::ModifyCoord_Dist_Poly3 (void *data, float *iocoord, int count)
 
 void lfModifier::ModifyCoord_UnDist_Poly5 (void *data, float *iocoord, int count)
 {
-    float *param = (float *)data;
-    float k1 = param [0];
-    float k2 = param [1];
+    const lfUnDistPoly5Data *param = (lfUnDistPoly5Data *)data;
+    const lfPoly5Residual f = { param->k1, param->k2 };
 
     for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
     {
@@ -601,28 +1123,15 @@ void lfModifier::ModifyCoord_UnDist_Poly5 (void *data, float *iocoord, int count
             continue;
 
         // Use Newton's method
-        double ru = rd;
-        for (int step = 0; ; step++)
-        {
-            double ru2 = ru * ru;
-            double fru = ru * (1.0 + k1 * ru2 + k2 * ru2 * ru2) - rd;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_pixel;
-
-            ru -= fru / (1.0 + 3 * k1 * ru2 + 5 * k2 * ru2 * ru2);
-        }
+        double ru;
+        if (!_lf_solve_radial (f, param->inverse, rd, ru))
+            continue; // Does not converge, no real solution in this area?
         if (ru < 0.0)
             continue; // Negative radius does not make sense at all
 
         ru /= rd;
         iocoord [0] = x * ru;
         iocoord [1] = y * ru;
-
-    next_pixel:
-        ;
     }
 }
 
@@ -648,10 +1157,8 @@ void lfModifier::ModifyCoord_Dist_Poly5 (void *data, float *iocoord, int count)
 void lfModifier::ModifyCoord_UnDist_PTLens (void *data, float *iocoord, int count)
 {
     // See "Note about PT-based distortion models" at the top of this file.
-    float *param = (float *)data;
-    float a_ = param [0];
-    float b_ = param [1];
-    float c_ = param [2];
+    const lfUnDistPTLensData *param = (lfUnDistPTLensData *)data;
+    const lfPTLensResidual f = { param->a_, param->b_, param->c_ };
 
     for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
     {
@@ -662,27 +1169,15 @@ void lfModifier::ModifyCoord_UnDist_PTLens (void *data, float *iocoord, int coun
             continue;
 
         // Use Newton's method
-        double ru = rd;
-        for (int step = 0; ; step++)
-        {
-            double fru = ru * (a_ * ru * ru * ru + b_ * ru * ru + c_ * ru + 1) - rd;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_pixel;
-
-            ru -= fru / (4 * a_ * ru * ru * ru + 3 * b_ * ru * ru + 2 * c_ * ru + 1);
-        }
+        double ru;
+        if (!_lf_solve_radial (f, param->inverse, rd, ru))
+            continue; // Does not converge, no real solution in this area?
         if (ru < 0.0)
             continue; // Negative radius does not make sense at all
 
         ru /= rd;
         iocoord [0] = x * ru;
         iocoord [1] = y * ru;
-
-    next_pixel:
-        ;
     }
 }
 
@@ -1252,6 +1747,11 @@ float lf_modifier_get_auto_scale (lfModifier *modifier, cbool reverse)
     return modifier->GetAutoScale (reverse);
 }
 
+float lf_modifier_get_auto_crop (lfModifier *modifier, cbool reverse, float *crop)
+{
+    return modifier->GetAutoCrop (reverse, crop);
+}
+
 cbool lf_modifier_apply_geometry_distortion (
     lfModifier *modifier, float xu, float yu, int width, int height, float *res)
 {
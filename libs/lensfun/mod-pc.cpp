@@ -57,9 +57,7 @@
 #include "lensfun.h"
 #include "lensfunprv.h"
 #include <cmath>
-#include <vector>
 #include <numeric>
-#include <stdexcept>
 #include "windows/mathconstants.h"
 
 using std::acos;
@@ -74,38 +72,34 @@ using std::sin;
 using std::sqrt;
 using std::isnan;
 
-dvector normalize (double x, double y)
+void normalize (double x, double y, double result [2])
 {
     double norm = sqrt (pow (x, 2) + pow (y, 2));
-    double temp[] = {x / norm, y / norm};
-    return dvector (temp, temp + 2);
+    result [0] = x / norm;
+    result [1] = y / norm;
 }
 
 /* Projects the coordinates on an x-y plane with the distance `plane_distance`
  * from the origin.  The centre of the projection is the origin.
  */
-void central_projection (dvector coordinates, double plane_distance, double &x, double &y)
+void central_projection (const double coordinates [3], double plane_distance, double &x, double &y)
 {
     double stretch_factor = plane_distance / coordinates [2];
     x = coordinates [0] * stretch_factor;
     y = coordinates [1] * stretch_factor;
 }
 
-
-class svd_no_convergence: public std::runtime_error
-{
-public:
-    svd_no_convergence() : std::runtime_error ("SVD: Iterations did not converge") {}
-};
-
 /* The following SVD implementation is a modified version of an SVD
  * implementation published in “Evaluation of gaussian processes and other
  * methods for non-linear regression”, Carl Edward Rasmussen, 1996.
+ *
+ * All matrices live on the stack, so that perspective correction can be set
+ * up interactively without touching the heap.
  */
-dvector svd (matrix M)
+bool svd (const double M_ [][LF_SVD_COLUMNS], int rows, double result [LF_SVD_COLUMNS])
 {
-    const int n = M [0].size();
-    dvector S2 (n);
+    const int n = LF_SVD_COLUMNS;
+    double S2 [n];
     int  i, j, k, estimated_column_rank = n, counter = n, iterations = 0,
         max_cycles = (n < 120) ? 60 : n / 2;
     double epsilon = std::numeric_limits<double>::epsilon(),
@@ -113,10 +107,16 @@ dvector svd (matrix M)
         threshold = 0.2 * epsilon,
         vt, p, x0, y0, q, r, c0, s0, d1, d2;
 
-    M.resize (2 * n, dvector (n));
+    // The matrix, padded with zero rows to be square, followed by the unit
+    // matrix which accumulates the rotations
+    double M [2 * n][n];
+    memset (M, 0, sizeof (M));
+    memset (S2, 0, sizeof (S2));
+    for (i = 0; i < rows && i < n; i++)
+        for (j = 0; j < n; j++)
+            M [i][j] = M_ [i][j];
     for (i = 0; i < n; i++)
         M [n + i][i] = 1;
-
     while (counter != 0 && iterations++ <= max_cycles)
     {
         counter = estimated_column_rank * (estimated_column_rank - 1) / 2;
@@ -177,27 +177,31 @@ dvector svd (matrix M)
             estimated_column_rank--;
     }
     if (iterations > max_cycles)
-        throw svd_no_convergence();
+        return false;
 
-    dvector result;
-    for (matrix::iterator it = M.begin() + n; it != M.end(); ++it)
-        result.push_back ((*it) [n - 1]);
-    return result;
+    for (i = 0; i < n; i++)
+        result [i] = M [n + i][n - 1];
+    return true;
 }
 
-void ellipse_analysis (dvector x, dvector y, double f_normalized, double &x_v, double &y_v,
-                       double &center_x, double &center_y)
+bool ellipse_analysis (const double *x, const double *y, double f_normalized,
+                       double &x_v, double &y_v, double &center_x, double &center_y)
 {
-    matrix M;
+    double M [5][LF_SVD_COLUMNS], parameters [LF_SVD_COLUMNS];
     double a, b, c, d, f, g, _D, x0, y0, phi, _N, _S, _R, a_, b_, radius_vertex;
 
     // Taken from http://math.stackexchange.com/a/767126/248694
     for (int i = 0; i < 5; i++)
     {
-        double temp[] = {pow (x [i], 2), x [i] * y [i], pow (y [i], 2), x [i], y [i], 1};
-        M.push_back (dvector (temp, temp + 6));
+        M [i][0] = pow (x [i], 2);
+        M [i][1] = x [i] * y [i];
+        M [i][2] = pow (y [i], 2);
+        M [i][3] = x [i];
+        M [i][4] = y [i];
+        M [i][5] = 1;
     }
-    dvector parameters = svd (M);
+    if (!svd (M, 5, parameters))
+        return false;
     /* Taken from http://mathworld.wolfram.com/Ellipse.html, equation (15)
        onwards. */
     a = parameters [0];
@@ -243,13 +247,14 @@ void ellipse_analysis (dvector x, dvector y, double f_normalized, double &x_v, d
     y_v = radius_vertex * cos (phi);
     center_x = x0;
     center_y = y0;
+    return true;
 }
 
 /* Returns the coordinates of the intersection of the lines defined by `x` and
  * `y`.  Both parameters need to be exactly 4 items long.  The first two items
  * defines the one line, the last two the other.
  */
-void intersection (dvector x, dvector y, double &x_i, double &y_i)
+void intersection (const double *x, const double *y, double &x_i, double &y_i)
 {
     double A, B, C, numerator_x, numerator_y;
 
@@ -281,7 +286,8 @@ void intersection (dvector x, dvector y, double &x_i, double &y_i)
            ⎝   0         0    1 ⎠
 */
 
-dvector rotate_rho_delta (double rho, double delta, double x, double y, double z)
+void rotate_rho_delta (double rho, double delta, double x, double y, double z,
+                       double result [3])
 {
     // This matrix is: Rₓ(δ) · R_y(ρ)
     double A11, A12, A13, A21, A22, A23, A31, A32, A33;
@@ -295,15 +301,13 @@ dvector rotate_rho_delta (double rho, double delta, double x, double y, double z
     A32 = sin (delta);
     A33 = cos (rho) * cos (delta);
 
-    dvector result (3);
     result [0] = A11 * x + A12 * y + A13 * z;
     result [1] = A21 * x + A22 * y + A23 * z;
     result [2] = A31 * x + A32 * y + A33 * z;
-    return result;
 }
 
-dvector rotate_rho_delta_rho_h (double rho, double delta, double rho_h,
-                                double x, double y, double z)
+void rotate_rho_delta_rho_h (double rho, double delta, double rho_h,
+                             double x, double y, double z, double result [3])
 {
     // This matrix is: R_y(ρₕ) · Rₓ(δ) · R_y(ρ)
     double A11, A12, A13, A21, A22, A23, A31, A32, A33;
@@ -317,19 +321,17 @@ dvector rotate_rho_delta_rho_h (double rho, double delta, double rho_h,
     A32 = sin (delta) * cos (rho_h);
     A33 = - sin (rho) * sin (rho_h) + cos (rho) * cos (delta) * cos (rho_h);
 
-    dvector result (3);
     result [0] = A11 * x + A12 * y + A13 * z;
     result [1] = A21 * x + A22 * y + A23 * z;
     result [2] = A31 * x + A32 * y + A33 * z;
-    return result;
 }
 
-double determine_rho_h (double rho, double delta, dvector x, dvector y,
+double determine_rho_h (double rho, double delta, const double *x, const double *y,
                         double f_normalized, double center_x, double center_y)
 {
-    dvector p0, p1;
-    p0 = rotate_rho_delta (rho, delta, x [0], y [0], f_normalized);
-    p1 = rotate_rho_delta (rho, delta, x [1], y [1], f_normalized);
+    double p0 [3], p1 [3];
+    rotate_rho_delta (rho, delta, x [0], y [0], f_normalized, p0);
+    rotate_rho_delta (rho, delta, x [1], y [1], f_normalized, p1);
     double x_0 = p0 [0], y_0 = p0 [1], z_0 = p0 [2];
     double x_1 = p1 [0], y_1 = p1 [1], z_1 = p1 [2];
     if (y_0 == y_1)
@@ -338,55 +340,54 @@ double determine_rho_h (double rho, double delta, dvector x, dvector y,
     {
         double Delta_x, Delta_z, x_h, z_h, rho_h;
         double temp[] = {x_1 - x_0, z_1 - z_0, y_1 - y_0};
-        central_projection (dvector (temp, temp + 3), - y_0, Delta_x, Delta_z);
+        central_projection (temp, - y_0, Delta_x, Delta_z);
         x_h = x_0 + Delta_x;
         z_h = z_0 + Delta_z;
         if (z_h == 0)
             rho_h = x_h > 0 ? 0 : M_PI;
         else
             rho_h = M_PI_2 - atan (x_h / z_h);
-        if (rotate_rho_delta_rho_h (rho, delta, rho_h, center_x, center_y, f_normalized) [2] < 0)
+        double center [3];
+        rotate_rho_delta_rho_h (rho, delta, rho_h, center_x, center_y, f_normalized, center);
+        if (center [2] < 0)
             rho_h -= M_PI;
         return rho_h;
     }
 }
 
-void calculate_angles (dvector x, dvector y, double &f_normalized,
+bool calculate_angles (const double *x, const double *y, int number_of_control_points,
+                       double &f_normalized,
                        double &rho, double &delta, double &rho_h, double &alpha,
                        double &center_of_control_points_x, double &center_of_control_points_y)
 {
-    const int number_of_control_points = x.size();
-
     double center_x, center_y;
     if (number_of_control_points == 6)
     {
-        center_x = std::accumulate (x.begin(), x.begin() + 4, 0.) / 4;
-        center_y = std::accumulate (y.begin(), y.begin() + 4, 0.) / 4;
+        center_x = std::accumulate (x, x + 4, 0.) / 4;
+        center_y = std::accumulate (y, y + 4, 0.) / 4;
     }
     else
     {
-        center_x = std::accumulate (x.begin(), x.end(), 0.) / number_of_control_points;
-        center_y = std::accumulate (y.begin(), y.end(), 0.) / number_of_control_points;
+        center_x = std::accumulate (x, x + number_of_control_points, 0.) / number_of_control_points;
+        center_y = std::accumulate (y, y + number_of_control_points, 0.) / number_of_control_points;
     }
 
     double x_v, y_v;
     if (number_of_control_points == 5 || number_of_control_points == 7)
-        ellipse_analysis (dvector (x.begin(), x.begin() + 5), dvector (y.begin(), y.begin() + 5),
-                          f_normalized, x_v, y_v, center_x, center_y);
+    {
+        if (!ellipse_analysis (x, y, f_normalized, x_v, y_v, center_x, center_y))
+            return false;
+    }
     else
     {
-        intersection (dvector (x.begin(), x.begin() + 4),
-                      dvector (y.begin(), y.begin() + 4),
-                      x_v, y_v);
+        intersection (x, y, x_v, y_v);
         if (number_of_control_points == 8)
         {
             /* The problem is over-determined.  I prefer the fourth line over
                the focal length.  Maybe this is useful in cases where the focal
                length is not known. */
             double x_h, y_h;
-            intersection (dvector (x.begin() + 4, x.begin() + 8),
-                          dvector (y.begin() + 4, y.begin() + 8),
-                          x_h, y_h);
+            intersection (x + 4, y + 4, x_h, y_h);
             double radicand = - x_h * x_v - y_h * y_v;
             if (radicand >= 0)
                 f_normalized = sqrt (radicand);
@@ -395,20 +396,23 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
 
     rho = atan (- x_v / f_normalized);
     delta = M_PI_2 - atan (- y_v / sqrt (pow (x_v, 2) + pow (f_normalized, 2)));
-    if (rotate_rho_delta (rho, delta, center_x, center_y, f_normalized) [2] < 0)
+    double center [3];
+    rotate_rho_delta (rho, delta, center_x, center_y, f_normalized, center);
+    if (center [2] < 0)
         // We have to move the vertex into the nadir instead of the zenith.
         delta -= M_PI;
 
     bool swapped_verticals_and_horizontals = false;
 
-    dvector c (2);
+    double c [2];
     switch (number_of_control_points) {
     case 4:
     case 6:
     case 8:
     {
-        dvector a = normalize (x_v - x [0], y_v - y [0]);
-        dvector b = normalize (x_v - x [2], y_v - y [2]);
+        double a [2], b [2];
+        normalize (x_v - x [0], y_v - y [0], a);
+        normalize (x_v - x [2], y_v - y [2], b);
         c [0] = a [0] + b [0];
         c [1] = a [1] + b [1];
         break;
@@ -427,10 +431,12 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
     }
     if (number_of_control_points == 7)
     {
-        double x5_, y5_;
-        central_projection (rotate_rho_delta (rho, delta, x [5], y [5], f_normalized), f_normalized, x5_, y5_);
-        double x6_, y6_;
-        central_projection (rotate_rho_delta (rho, delta, x [6], y [6], f_normalized), f_normalized, x6_, y6_);
+        double x5_, y5_, p5 [3];
+        rotate_rho_delta (rho, delta, x [5], y [5], f_normalized, p5);
+        central_projection (p5, f_normalized, x5_, y5_);
+        double x6_, y6_, p6 [3];
+        rotate_rho_delta (rho, delta, x [6], y [6], f_normalized, p6);
+        central_projection (p6, f_normalized, x6_, y6_);
         alpha = - atan2 (y6_ - y5_, x6_ - x5_);
         if (fabs (c [0]) > fabs (c [1]))
             // Find smallest rotation into horizontal
@@ -451,7 +457,7 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
        after the vertex was moved into the zenith */
     if (number_of_control_points == 4)
     {
-        dvector x_perpendicular_line (2), y_perpendicular_line (2);
+        double x_perpendicular_line [2], y_perpendicular_line [2];
         if (swapped_verticals_and_horizontals)
         {
             x_perpendicular_line [0] = center_x;
@@ -474,24 +480,24 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
         rho_h = 0;
     else
     {
-        rho_h = determine_rho_h (rho, delta, dvector (x.begin() + 4, x.begin() + 6),
-                                 dvector (y.begin() + 4, y.begin() + 6), f_normalized, center_x, center_y);
+        rho_h = determine_rho_h (rho, delta, x + 4, y + 4, f_normalized, center_x, center_y);
         if (isnan (rho_h))
             if (number_of_control_points == 8)
-                rho_h = determine_rho_h (rho, delta, dvector (x.begin() + 6, x.begin() + 8),
-                                         dvector (y.begin() + 6, y.begin() + 8), f_normalized, center_x, center_y);
+                rho_h = determine_rho_h (rho, delta, x + 6, y + 6, f_normalized, center_x, center_y);
             else
                 rho_h = 0;
     }
     center_of_control_points_x = center_x;
     center_of_control_points_y = center_y;
+    return true;
 }
 
 /* Returns a rotation matrix which combines three rotations.  First, around the
  * y axis by ρ₁, then, around the x axis by δ, and finally, around the y axis
  * again by ρ₂.
  */
-matrix generate_rotation_matrix (double rho_1, double delta, double rho_2, double d)
+void generate_rotation_matrix (double rho_1, double delta, double rho_2, double d,
+                               double M [3][3])
 {
     double s_rho_2, c_rho_2, s_delta, c_delta, s_rho_1, c_rho_1,
         w, x, y, z, theta, s_theta;
@@ -531,7 +537,6 @@ matrix generate_rotation_matrix (double rho_1, double delta, double rho_2, doubl
     /* Convert the quaternion to a rotation matrix, see e.g.
        <https://en.wikipedia.org/wiki/Rotation_matrix#Quaternion>.  This matrix
        is (if d=0): R_y(ρ2) · Rₓ(δ) · R_y(ρ1) */
-    matrix M (3, dvector (3));
     M [0][0] = 1 - 2 * pow (y, 2) - 2 * pow (z, 2);
     M [0][1] = 2 * x * y - 2 * z * w;
     M [0][2] = 2 * x * z + 2 * y * w;
@@ -541,11 +546,19 @@ matrix generate_rotation_matrix (double rho_1, double delta, double rho_2, doubl
     M [2][0] = 2 * x * z - 2 * y * w;
     M [2][1] = 2 * y * z + 2 * x * w;
     M [2][2] = 1 - 2 * pow (x, 2) - 2 * pow (y, 2);
-    return M;
 }
 
 bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, float d)
 {
+    lfPerspectiveCorrection correction;
+    return FitPerspectiveCorrection (x, y, count, d, &correction) &&
+        AttachPerspectiveCorrection (&correction);
+}
+
+bool lfModifier::FitPerspectiveCorrection (float *x, float *y, int count, float d,
+                                           lfPerspectiveCorrection *correction) const
+{
+    correction->Valid = 0;
     if (Reverse)
     {
         g_warning ("[Lensfun] reverse perspective correction is not yet implemented\n");
@@ -559,29 +572,28 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
         d = -1;
     if (d > 1)
         d = 1;
-    dvector x_, y_;
+    double x_ [8], y_ [8];
     for (int i = 0; i < number_of_control_points; i++)
     {
-        x_.push_back (x [i] * NormScale - CenterX);
-        y_.push_back (y [i] * NormScale - CenterY);
+        x_ [i] = x [i] * NormScale - CenterX;
+        y_ [i] = y [i] * NormScale - CenterY;
     }
 
     double f_normalized = FocalLengthNormalized;
     double rho, delta, rho_h, alpha, center_of_control_points_x,
         center_of_control_points_y, z;
-    try
+    if (!calculate_angles (x_, y_, number_of_control_points, f_normalized,
+                           rho, delta, rho_h, alpha,
+                           center_of_control_points_x, center_of_control_points_y))
     {
-        calculate_angles (x_, y_, f_normalized, rho, delta, rho_h, alpha,
-                          center_of_control_points_x, center_of_control_points_y);
-    }
-    catch (svd_no_convergence &e)
-    {
-        g_warning ("[Lensfun] %s", e.what());
+        g_warning ("[Lensfun] SVD: Iterations did not converge");
         return false;
     }
 
     // Transform center point to get shift
-    z = rotate_rho_delta_rho_h (rho, delta, rho_h, 0, 0, f_normalized) [2];
+    double center [3];
+    rotate_rho_delta_rho_h (rho, delta, rho_h, 0, 0, f_normalized, center);
+    z = center [2];
     /* If the image centre is too much outside, or even at infinity, take the
        center of gravity of the control points instead. */
     enum center_type { old_image_center, control_points_center };
@@ -589,8 +601,9 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
 
     /* Generate a rotation matrix in forward direction, for getting the
        proper shift of the image center. */
-    matrix A = generate_rotation_matrix (rho, delta, rho_h, d);
-    dvector center_coords (3);
+    double A [3][3];
+    generate_rotation_matrix (rho, delta, rho_h, d, A);
+    double center_coords [3];
 
     switch (new_image_center) {
     case old_image_center:
@@ -621,7 +634,8 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
 
     // Finally, generate a rotation matrix in backward (lookup) direction
     {
-        matrix A_ = generate_rotation_matrix (- rho_h, - delta, - rho, d);
+        double A_ [3][3];
+        generate_rotation_matrix (- rho_h, - delta, - rho, d, A_);
 
         /* Now we append the final rotation by α.  This matrix is: R_y(- ρ) ·
            Rₓ(- δ) · R_y(- ρₕ) · R_z(α). */
@@ -650,7 +664,41 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
                    A [1][0] * mapping_scale, A [1][1] * mapping_scale, A [1][2] * f_normalized,
                    A [2][0] / center_coords [2], A [2][1] / center_coords [2], A [2][2],
                    Delta_a / mapping_scale, Delta_b / mapping_scale};
-    AddCoordCallback (ModifyCoord_Perspective_Correction, 300, tmp, sizeof (tmp));
+    memcpy (correction->Params, tmp, sizeof (tmp));
+    correction->Valid = 1;
+    return true;
+}
+
+int lfModifier::FitPerspectiveCorrections (float **x, float **y, const int *count,
+                                           const float *d, int n,
+                                           lfPerspectiveCorrection *corrections) const
+{
+    // The fits are independent of each other and don't touch the modifier
+    int successes = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:successes)
+    for (int i = 0; i < n; i++)
+        if (FitPerspectiveCorrection (x [i], y [i], count [i], d [i], &corrections [i]))
+            successes++;
+    return successes;
+}
+
+bool lfModifier::AttachPerspectiveCorrection (const lfPerspectiveCorrection *correction)
+{
+    if (!correction->Valid)
+        return false;
+    if (Reverse)
+    {
+        g_warning ("[Lensfun] reverse perspective correction is not yet implemented\n");
+        return false;
+    }
+#ifdef VECTORIZATION_SSE
+    if (_lf_detect_cpu_features () & LF_CPU_FLAG_SSE)
+        AddCoordCallback (ModifyCoord_Perspective_Correction_SSE, 300,
+                          (void *)correction->Params, sizeof (correction->Params));
+    else
+#endif
+    AddCoordCallback (ModifyCoord_Perspective_Correction, 300,
+                      (void *)correction->Params, sizeof (correction->Params));
     return true;
 }
 
@@ -692,3 +740,23 @@ cbool lf_modifier_enable_perspective_correction (
 {
     return modifier->EnablePerspectiveCorrection (x, y, count, d);
 }
+
+cbool lf_modifier_fit_perspective_correction (
+    const lfModifier *modifier, float *x, float *y, int count, float d,
+    lfPerspectiveCorrection *correction)
+{
+    return modifier->FitPerspectiveCorrection (x, y, count, d, correction);
+}
+
+int lf_modifier_fit_perspective_corrections (
+    const lfModifier *modifier, float **x, float **y, const int *count,
+    const float *d, int n, lfPerspectiveCorrection *corrections)
+{
+    return modifier->FitPerspectiveCorrections (x, y, count, d, n, corrections);
+}
+
+cbool lf_modifier_attach_perspective_correction (
+    lfModifier *modifier, const lfPerspectiveCorrection *correction)
+{
+    return modifier->AttachPerspectiveCorrection (correction);
+}
@@ -0,0 +1,248 @@
+/*
+    Image modifier implementation: performance counters
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <math.h>
+#include <cmath>
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using std::isfinite;
+
+#ifndef LF_STATS_ATOMIC
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+static GMutex _lf_stats_lock;
+#define STATS_LOCK() g_mutex_lock (&_lf_stats_lock)
+#define STATS_UNLOCK() g_mutex_unlock (&_lf_stats_lock)
+#else
+static GStaticMutex _lf_stats_lock = G_STATIC_MUTEX_INIT;
+#define STATS_LOCK() g_static_mutex_lock (&_lf_stats_lock)
+#define STATS_UNLOCK() g_static_mutex_unlock (&_lf_stats_lock)
+#endif
+
+void _lf_stats_count (guint64 *counter, guint64 value)
+{
+    STATS_LOCK ();
+    *counter += value;
+    STATS_UNLOCK ();
+}
+
+guint64 _lf_stats_read (const guint64 *counter)
+{
+    STATS_LOCK ();
+    guint64 value = *counter;
+    STATS_UNLOCK ();
+    return value;
+}
+#endif
+
+gint64 _lf_stats_clock ()
+{
+#ifdef PLATFORM_WINDOWS
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency (&frequency);
+    QueryPerformanceCounter (&counter);
+    return (gint64)(counter.QuadPart * (1e9 / frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void _lf_stats_count_coords (
+    lfModifierStatsData *stats, const float *coord, int count,
+    double width, double height)
+{
+    guint64 out_of_range = 0, not_finite = 0;
+    for (const float *end = coord + count * 2; coord < end; coord += 2)
+        if (!isfinite (coord [0]) || !isfinite (coord [1]))
+            not_finite++;
+        else if (coord [0] < 0 || coord [0] > width ||
+                 coord [1] < 0 || coord [1] > height)
+            out_of_range++;
+    if (out_of_range)
+        _lf_stats_count (&stats->OutOfRange, out_of_range);
+    if (not_finite)
+        _lf_stats_count (&stats->NotFinite, not_finite);
+}
+
+const char *lfModifier::GetCoordCallbackName (lfModifyCoordFunc callback)
+{
+#define CALLBACK_NAME(func) \
+    if (callback == lfModifier::func) \
+        return #func;
+
+    CALLBACK_NAME (ModifyCoord_Scale)
+    CALLBACK_NAME (ModifyCoord_UnTCA_Linear)
+    CALLBACK_NAME (ModifyCoord_TCA_Linear)
+    CALLBACK_NAME (ModifyCoord_UnTCA_Poly3)
+    CALLBACK_NAME (ModifyCoord_TCA_Poly3)
+    CALLBACK_NAME (ModifyCoord_TCA_ACM)
+    CALLBACK_NAME (ModifyCoord_UnDist_Poly3)
+    CALLBACK_NAME (ModifyCoord_Dist_Poly3)
+    CALLBACK_NAME (ModifyCoord_UnDist_Poly5)
+    CALLBACK_NAME (ModifyCoord_Dist_Poly5)
+    CALLBACK_NAME (ModifyCoord_UnDist_PTLens)
+    CALLBACK_NAME (ModifyCoord_Dist_PTLens)
+    CALLBACK_NAME (ModifyCoord_Dist_ACM)
+    CALLBACK_NAME (ModifyCoord_Geom_FishEye_Rect)
+    CALLBACK_NAME (ModifyCoord_Geom_Panoramic_Rect)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_Rect)
+    CALLBACK_NAME (ModifyCoord_Geom_Rect_FishEye)
+    CALLBACK_NAME (ModifyCoord_Geom_Panoramic_FishEye)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_FishEye)
+    CALLBACK_NAME (ModifyCoord_Geom_Rect_Panoramic)
+    CALLBACK_NAME (ModifyCoord_Geom_FishEye_Panoramic)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_Panoramic)
+    CALLBACK_NAME (ModifyCoord_Geom_Rect_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_FishEye_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_Panoramic_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_Orthographic_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_Orthographic)
+    CALLBACK_NAME (ModifyCoord_Geom_Stereographic_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_Stereographic)
+    CALLBACK_NAME (ModifyCoord_Geom_Equisolid_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_Equisolid)
+    CALLBACK_NAME (ModifyCoord_Geom_Thoby_ERect)
+    CALLBACK_NAME (ModifyCoord_Geom_ERect_Thoby)
+    CALLBACK_NAME (ModifyCoord_Perspective_Correction)
+#ifdef VECTORIZATION_SSE
+    CALLBACK_NAME (ModifyCoord_Dist_Poly3_SSE)
+    CALLBACK_NAME (ModifyCoord_UnDist_PTLens_SSE)
+    CALLBACK_NAME (ModifyCoord_Dist_PTLens_SSE)
+    CALLBACK_NAME (ModifyCoord_Perspective_Correction_SSE)
+#endif
+
+#undef CALLBACK_NAME
+
+    return "user";
+}
+
+bool lfModifier::EnableStats (bool enable)
+{
+    if (!Stats)
+        return false;
+    g_atomic_int_set (&((lfModifierStatsData *)Stats)->Enabled, enable);
+    return true;
+}
+
+// Copies the counters of one callback list into lfModifierStats
+template<typename T> static int get_callback_stats (
+    void *arr, const lfStatsCounters *counters, lfCallbackStats *stats,
+    const char *(*get_name) (T))
+{
+    GPtrArray *callbacks = (GPtrArray *)arr;
+    int n = callbacks->len < LF_STATS_MAX_CALLBACKS ?
+        callbacks->len : LF_STATS_MAX_CALLBACKS;
+    for (int i = 0; i < n; i++)
+    {
+        // All callback data structs start with lfCallbackData, followed by
+        // the function pointer.
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)g_ptr_array_index (callbacks, i);
+        stats [i].Name = get_name ((T)cd->callback);
+        stats [i].Priority = cd->priority;
+        stats [i].Pixels = _lf_stats_read (&counters [i].Pixels);
+        stats [i].Nanoseconds = _lf_stats_read (&counters [i].Nanoseconds);
+    }
+    return n;
+}
+
+bool lfModifier::GetStats (lfModifierStats *stats) const
+{
+    lfModifierStatsData *data = (lfModifierStatsData *)Stats;
+    if (!data)
+        return false;
+
+    memset (stats, 0, sizeof (*stats));
+    stats->NumCoord = get_callback_stats (
+        CoordCallbacks, data->Callbacks [LF_STATS_COORD], stats->Coord,
+        GetCoordCallbackName);
+    stats->NumSubpixel = get_callback_stats (
+        SubpixelCallbacks, data->Callbacks [LF_STATS_SUBPIXEL], stats->Subpixel,
+        GetCoordCallbackName);
+    stats->NumColor = get_callback_stats (
+        ColorCallbacks, data->Callbacks [LF_STATS_COLOR], stats->Color,
+        GetColorCallbackName);
+    stats->TablePixels = _lf_stats_read (&data->TablePixels);
+    for (int i = 0; i < LF_STATS_NEWTON_BINS; i++)
+        stats->NewtonSteps [i] = _lf_stats_read (&data->NewtonSteps [i]);
+    stats->OutOfRange = _lf_stats_read (&data->OutOfRange);
+    stats->NotFinite = _lf_stats_read (&data->NotFinite);
+    return true;
+}
+
+void lfModifier::ResetStats ()
+{
+    lfModifierStatsData *data = (lfModifierStatsData *)Stats;
+    if (!data)
+        return;
+    int enabled = g_atomic_int_get (&data->Enabled);
+    memset (data, 0, sizeof (*data));
+    g_atomic_int_set (&data->Enabled, enabled);
+}
+
+static void dump_callback_stats (
+    GString *out, const char *list, const lfCallbackStats *stats, int count)
+{
+    for (int i = 0; i < count; i++)
+        g_string_append_printf (
+            out, "%-8s %-40s %4d %14llu %10.2f\n", list, stats [i].Name,
+            stats [i].Priority, stats [i].Pixels, stats [i].Pixels ?
+            (double)stats [i].Nanoseconds / stats [i].Pixels : 0.0);
+}
+
+char *lfModifier::DumpStats () const
+{
+    lfModifierStats stats;
+    if (!GetStats (&stats))
+        return NULL;
+
+    GString *out = g_string_new (NULL);
+    g_string_append_printf (out, "%-8s %-40s %4s %14s %10s\n",
+                            "List", "Callback", "Prio", "Pixels", "ns/pixel");
+    dump_callback_stats (out, "coord", stats.Coord, stats.NumCoord);
+    dump_callback_stats (out, "subpixel", stats.Subpixel, stats.NumSubpixel);
+    dump_callback_stats (out, "color", stats.Color, stats.NumColor);
+    g_string_append_printf (out, "Pixels from the radial table: %llu\n",
+                            stats.TablePixels);
+    g_string_append (out, "Newton steps:");
+    for (int i = 0; i < LF_STATS_NEWTON_BINS - 1; i++)
+        if (stats.NewtonSteps [i])
+            g_string_append_printf (out, " %d: %llu", i, stats.NewtonSteps [i]);
+    g_string_append_printf (out, " failed: %llu\n",
+                            stats.NewtonSteps [LF_STATS_NEWTON_BINS - 1]);
+    g_string_append_printf (out, "Coordinates out of range: %llu\n", stats.OutOfRange);
+    g_string_append_printf (out, "Coordinates not finite: %llu\n", stats.NotFinite);
+    return g_string_free (out, FALSE);
+}
+
+//---------------------------// The C interface //---------------------------//
+
+cbool lf_modifier_enable_stats (lfModifier *modifier, cbool enable)
+{
+    return modifier->EnableStats (enable);
+}
+
+cbool lf_modifier_get_stats (const lfModifier *modifier, lfModifierStats *stats)
+{
+    return modifier->GetStats (stats);
+}
+
+void lf_modifier_reset_stats (lfModifier *modifier)
+{
+    modifier->ResetStats ();
+}
+
+char *lf_modifier_dump_stats (const lfModifier *modifier)
+{
+    return modifier->DumpStats ();
+}
@@ -8,6 +8,26 @@
 #include "lensfunprv.h"
 #include <math.h>
 
+/*
+  Residual functor for the Newton iterations of the TCA undistortion, see
+  _lf_newton_radial().
+
+  Original equation: Rd = b * Ru^3 + c * Ru^2 + v * Ru
+  Target function:   b * Ru^3 + c * Ru^2 + v * Ru - Rd = 0
+  Derivative:        3 * b * Ru^2 + 2 * c * Ru + v
+*/
+struct lfTCAPoly3Residual
+{
+    double b, c, v;
+
+    double operator () (double ru, double rd, double &prime) const
+    {
+        double ru2 = ru * ru;
+        prime = 3 * b * ru2 + 2 * c * ru + v;
+        return b * ru2 * ru + c * ru2 + v * ru - rd;
+    }
+};
+
 void lfModifier::AddSubpixelCallback (
     lfSubpixelCoordFunc callback, int priority, void *data, size_t data_size)
 {
@@ -38,9 +58,20 @@ bool lfModifier::AddSubpixelCallbackTCA (lfLensCalibTCA &model, bool reverse)
                 return true;
 
             case LF_TCA_MODEL_POLY3:
-                AddSubpixelCallback (ModifyCoord_UnTCA_Poly3, 500,
-                                     model.Terms, 6 * sizeof (float));
+            {
+                // See lfModifier::AddCoordCallbackDistortion
+                const double rd_max = 1.5 * sqrt (MaxX * MaxX + MaxY * MaxY);
+                lfUnTCAPoly3Data d;
+                memcpy (d.terms, model.Terms, 6 * sizeof (float));
+                const lfTCAPoly3Residual f_r = { d.terms [4], d.terms [2], d.terms [0] };
+                const lfTCAPoly3Residual f_b = { d.terms [5], d.terms [3], d.terms [1] };
+                _lf_build_radial_inverse (f_r, rd_max, &NonConvergedCount, Stats,
+                                          d.inverse_r);
+                _lf_build_radial_inverse (f_b, rd_max, &NonConvergedCount, Stats,
+                                          d.inverse_b);
+                AddSubpixelCallback (ModifyCoord_UnTCA_Poly3, 500, &d, sizeof (d));
                 return true;
+            }
 
             case LF_TCA_MODEL_ACM:
                 g_warning ("[lensfun] \"acm\" TCA model is not yet implemented "
@@ -93,6 +124,10 @@ bool lfModifier::ApplySubpixelDistortion (
     xu = xu * NormScale - CenterX;
     yu = yu * NormScale - CenterY;
 
+    lfModifierStatsData *stats = _lf_stats_active (Stats);
+    float *const first = res;
+    const int rows = height;
+
     for (float y = yu; height; y += NormScale, height--)
     {
         int i;
@@ -109,7 +144,9 @@ bool lfModifier::ApplySubpixelDistortion (
         {
             lfSubpixelCallbackData *cd =
                 (lfSubpixelCallbackData *)g_ptr_array_index ((GPtrArray *)SubpixelCallbacks, i);
+            gint64 start = _lf_stats_start (stats);
             cd->callback (cd->data, res, width);
+            _lf_stats_add (stats, LF_STATS_SUBPIXEL, i, width, start);
         }
 
         // Convert normalized coordinates back into natural coordiates
@@ -121,6 +158,9 @@ bool lfModifier::ApplySubpixelDistortion (
         }
     }
 
+    if (stats)
+        _lf_stats_count_coords (stats, first, width * rows * 3, Width, Height);
+
     return true;
 }
 
@@ -135,10 +175,98 @@ bool lfModifier::ApplySubpixelGeometryDistortion (
     xu = xu * NormScale - CenterX;
     yu = yu * NormScale - CenterY;
 
-    for (float y = yu; height; y += NormScale, height--)
+    NeedRadialTable ();
+    const lfRadialTable *table = (const lfRadialTable *)RadialTable;
+    if (table && !table->HasSubpixel)
+        table = NULL;
+    lfModifierStatsData *stats = _lf_stats_active (Stats);
+    float *const first = res;
+    const int rows = height;
+
+    // See lfModifier::ApplyGeometryDistortion
+    const int mirror_cols = table ? lfRadialTable::MirrorSum (xu, NormScale) : -1;
+    const int mirror_rows = table ? lfRadialTable::MirrorSum (yu, NormScale) : -1;
+    const float mirror_x = 2 * CenterX * NormUnScale;
+    const float mirror_y = 2 * CenterY * NormUnScale;
+    int row = 0;
+
+    for (float y = yu; height; y += NormScale, height--, row++)
     {
         int i;
         float x = xu;
+
+        if (table)
+        {
+            if (stats)
+                _lf_stats_count (&stats->TablePixels, width);
+
+            int mirror = mirror_rows - row;
+            if (mirror >= 0 && mirror < row)
+            {
+                const float *src = res - (row - mirror) * width * 6;
+                for (i = 0; i < width * 3; i++, src += 2, res += 2)
+                {
+                    res [0] = src [0];
+                    res [1] = mirror_y - src [1];
+                }
+                continue;
+            }
+
+            // A purely radial chain, see lfModifier::ApplyGeometryDistortion
+            for (i = 0; i < width; i++, x += NormScale, res += 6)
+            {
+                mirror = mirror_cols - i;
+                if (mirror >= 0 && mirror < i)
+                {
+                    const float *src = res - (i - mirror) * 6;
+                    for (int k = 0; k < 6; k += 2)
+                    {
+                        res [k] = mirror_x - src [k];
+                        res [k + 1] = src [k + 1];
+                    }
+                    continue;
+                }
+
+                int j;
+                float t;
+                res [0] = res [2] = res [4] = x;
+                res [1] = res [3] = res [5] = y;
+                if (table->Locate (x * x + y * y, j, t))
+                {
+                    const float *f0 = table->Subpixel + j * 3;
+                    const float *f1 = f0 + 3;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        float f = f0 [k] + t * (f1 [k] - f0 [k]);
+                        res [k * 2] *= f;
+                        res [k * 2 + 1] *= f;
+                    }
+                }
+                else
+                {
+                    int k;
+                    for (k = 0; k < (int)((GPtrArray *)CoordCallbacks)->len; k++)
+                    {
+                        lfCoordCallbackData *cd =
+                            (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, k);
+                        cd->callback (cd->data, res, 3);
+                    }
+                    for (k = 0; k < (int)((GPtrArray *)SubpixelCallbacks)->len; k++)
+                    {
+                        lfSubpixelCallbackData *cd =
+                            (lfSubpixelCallbackData *)g_ptr_array_index ((GPtrArray *)SubpixelCallbacks, k);
+                        cd->callback (cd->data, res, 1);
+                    }
+                }
+                for (int k = 0; k < 6; k += 2)
+                {
+                    res [k] = (res [k] + CenterX) * NormUnScale;
+                    res [k + 1] = (res [k + 1] + CenterY) * NormUnScale;
+                }
+            }
+            continue;
+        }
+
         float *out = res;
         for (i = 0; i < width; i++, x += NormScale)
         {
@@ -151,14 +279,18 @@ bool lfModifier::ApplySubpixelGeometryDistortion (
         {
             lfCoordCallbackData *cd =
                 (lfCoordCallbackData *)g_ptr_array_index ((GPtrArray *)CoordCallbacks, i);
+            gint64 start = _lf_stats_start (stats);
             cd->callback (cd->data, res, width * 3);
+            _lf_stats_add (stats, LF_STATS_COORD, i, width * 3, start);
         }
 
         for (i = 0; i < (int)((GPtrArray *)SubpixelCallbacks)->len; i++)
         {
             lfSubpixelCallbackData *cd =
                 (lfSubpixelCallbackData *)g_ptr_array_index ((GPtrArray *)SubpixelCallbacks, i);
+            gint64 start = _lf_stats_start (stats);
             cd->callback (cd->data, res, width);
+            _lf_stats_add (stats, LF_STATS_SUBPIXEL, i, width, start);
         }
 
         // Convert normalized coordinates back into natural coordiates
@@ -170,6 +302,9 @@ bool lfModifier::ApplySubpixelGeometryDistortion (
         }
     }
 
+    if (stats)
+        _lf_stats_count_coords (stats, first, width * rows * 3, Width, Height);
+
     return true;
 }
 
@@ -205,80 +340,43 @@ void lfModifier::ModifyCoord_TCA_Linear (void *data, float *iocoord, int count)
 
 void lfModifier::ModifyCoord_UnTCA_Poly3 (void *data, float *iocoord, int count)
 {
-    const float *param = (float *)data;
-    const float vr = param [0];
-    const float vb = param [1];
-    const float cr = param [2];
-    const float cb = param [3];
-    const float br = param [4];
-    const float bb = param [5];
+    const lfUnTCAPoly3Data *param = (lfUnTCAPoly3Data *)data;
+    const float vr = param->terms [0];
+    const float vb = param->terms [1];
+    const float cr = param->terms [2];
+    const float cb = param->terms [3];
+    const float br = param->terms [4];
+    const float bb = param->terms [5];
+    const lfTCAPoly3Residual f_r = { br, cr, vr };
+    const lfTCAPoly3Residual f_b = { bb, cb, vb };
 
     for (float *end = iocoord + count * 2 * 3; iocoord < end; iocoord += 6)
     {
         float x, y;
-        double rd, ru, ru2;
+        double rd, ru;
 
+        // We have Rd, need to find Ru.  We will use Newton's method, see
+        // lfTCAPoly3Residual.
         x = iocoord [0];
         y = iocoord [1];
         rd = sqrt (x * x + y * y);
-        if (rd == 0.0)
-            goto next_subpixel_r;
-
-        // Original equation: Rd = b * Ru^3 + c * Ru^2 + v * Ru
-        // We have Rd, need to find Ru. We will use Newton's method
-        // for finding the root of the equation:
-        //
-        // Target function: b * Ru^3 + c * Ru^2 + v * Ru - Rd = 0
-        // Derivative:      3 * b * Ru^2 + 2 * c * Ru + v
-        ru = rd;
-        for (int step = 0; ; step++)
-        {
-            ru2 = ru * ru;
-            double fru = br * ru2 * ru + cr * ru2 + vr * ru - rd;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_subpixel_r;
-
-            ru -= fru / (3 * br * ru2 + 2 * cr * ru + vr);
-        }
         // Negative radius does not make sense at all
-        if (ru > 0.0)
+        if (rd != 0.0 && _lf_solve_radial (f_r, param->inverse_r, rd, ru) && ru > 0.0)
         {
             ru /= rd;
             iocoord [0] = x * ru;
             iocoord [1] = y * ru;
         }
-next_subpixel_r:
 
         x = iocoord [4];
         y = iocoord [5];
         rd = sqrt (x * x + y * y);
-        if (rd == 0.0)
-            goto next_subpixel_b;
-
-        ru = rd;
-        for (int step = 0; ; step++)
-        {
-            ru2 = ru * ru;
-            double fru = bb * ru2 * ru + cb * ru2 + vb * ru - rd;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_subpixel_b;
-
-            ru -= fru / (3 * bb * ru2 + 2 * cb * ru + vb);
-        }
-        // Negative radius does not make sense at all
-        if (ru > 0.0)
+        if (rd != 0.0 && _lf_solve_radial (f_b, param->inverse_b, rd, ru) && ru > 0.0)
         {
             ru /= rd;
             iocoord [4] = x * ru;
             iocoord [5] = y * ru;
         }
-next_subpixel_b:;
     }
 }
 
@@ -7,8 +7,11 @@
 #include "lensfun.h"
 #include "lensfunprv.h"
 #include <math.h>
+#include <cmath>
 #include "windows/mathconstants.h"
 
+using std::isfinite;
+
 lfModifier *lfModifier::Create (const lfLens *lens, float crop, int width, int height)
 {
     return new lfModifier (lens, crop, width, height);
@@ -62,6 +65,8 @@ int lfModifier::Initialize (
 
     Reverse = reverse;
 
+    NeedRadialTable ();
+
     return oflags;
 }
 
@@ -232,6 +237,21 @@ lfModifier::lfModifier (const lfLens *lens, float crop, int width, int height)
     // Used for autoscaling
     MaxX = Width / 2.0 * NormScale;
     MaxY = Height / 2.0 * NormScale;
+
+    Reverse = false;
+    NonConvergedCount = 0;
+    RadialTable = NULL;
+    RadialTableDirty = 0;
+#ifdef MODIFIER_STATS
+    Stats = g_new0 (lfModifierStatsData, 1);
+#else
+    Stats = NULL;
+#endif
+}
+
+unsigned long long lfModifier::GetNonConvergedCount () const
+{
+    return _lf_stats_read ((const guint64 *)&NonConvergedCount);
 }
 
 static void free_callback_list (void *arr)
@@ -254,6 +274,8 @@ lfModifier::~lfModifier ()
     free_callback_list (SubpixelCallbacks);
     free_callback_list (ColorCallbacks);
     free_callback_list (CoordCallbacks);
+    g_free (RadialTable);
+    g_free (Stats);
 }
 
 static gint _lf_coordcb_compare (gconstpointer a, gconstpointer b)
@@ -277,6 +299,157 @@ void lfModifier::AddCallback (void *arr, lfCallbackData *d,
     else
         d->data = data;
     _lf_ptr_array_insert_sorted ((GPtrArray *)arr, d, _lf_coordcb_compare);
+
+    // The chain has changed, so the table is outdated; it is built again
+    // before the next pixels are modified
+    g_free (RadialTable);
+    RadialTable = NULL;
+    g_atomic_int_set (&RadialTableDirty, 1);
+
+    // ... and the callback counters are at the wrong positions
+    if (Stats)
+        memset (((lfModifierStatsData *)Stats)->Callbacks, 0,
+                sizeof (((lfModifierStatsData *)Stats)->Callbacks));
+}
+
+#if defined(GLIB_CHECK_VERSION) && GLIB_CHECK_VERSION(2,32,0)
+static GMutex _lf_radial_table_lock;
+#define RADIAL_TABLE_LOCK() g_mutex_lock (&_lf_radial_table_lock)
+#define RADIAL_TABLE_UNLOCK() g_mutex_unlock (&_lf_radial_table_lock)
+#else
+static GStaticMutex _lf_radial_table_lock = G_STATIC_MUTEX_INIT;
+#define RADIAL_TABLE_LOCK() g_static_mutex_lock (&_lf_radial_table_lock)
+#define RADIAL_TABLE_UNLOCK() g_static_mutex_unlock (&_lf_radial_table_lock)
+#endif
+
+void lfModifier::NeedRadialTable () const
+{
+    // The Apply methods are called from many threads at once, so only the
+    // first one rebuilds the table, like _lf_lens_need_calibrations
+    if (!g_atomic_int_get (&RadialTableDirty))
+        return;
+
+    RADIAL_TABLE_LOCK ();
+    if (RadialTableDirty)
+    {
+        lfModifier *self = const_cast<lfModifier *> (this);
+        self->UpdateRadialTable ();
+        g_atomic_int_set (&self->RadialTableDirty, 0);
+    }
+    RADIAL_TABLE_UNLOCK ();
+}
+
+void lfModifier::UpdateRadialTable ()
+{
+    g_free (RadialTable);
+    RadialTable = NULL;
+
+    GPtrArray *coord_callbacks = (GPtrArray *)CoordCallbacks;
+    GPtrArray *subpixel_callbacks = (GPtrArray *)SubpixelCallbacks;
+    if (!coord_callbacks->len && !subpixel_callbacks->len)
+        return;
+
+    static const lfModifyCoordFunc radial_coord_callbacks [] =
+    {
+        ModifyCoord_Scale,
+        ModifyCoord_UnDist_Poly3, ModifyCoord_Dist_Poly3,
+        ModifyCoord_UnDist_Poly5, ModifyCoord_Dist_Poly5,
+        ModifyCoord_UnDist_PTLens, ModifyCoord_Dist_PTLens,
+#ifdef VECTORIZATION_SSE
+        ModifyCoord_Dist_Poly3_SSE,
+        ModifyCoord_UnDist_PTLens_SSE, ModifyCoord_Dist_PTLens_SSE,
+#endif
+    };
+    static const lfSubpixelCoordFunc radial_subpixel_callbacks [] =
+    {
+        ModifyCoord_UnTCA_Linear, ModifyCoord_TCA_Linear,
+        ModifyCoord_UnTCA_Poly3, ModifyCoord_TCA_Poly3,
+    };
+    const int n_coord = ARRAY_LEN (radial_coord_callbacks);
+    const int n_subpixel = ARRAY_LEN (radial_subpixel_callbacks);
+
+    for (unsigned i = 0; i < coord_callbacks->len; i++)
+    {
+        lfCoordCallbackData *cd =
+            (lfCoordCallbackData *)g_ptr_array_index (coord_callbacks, i);
+        int j = 0;
+        while (j < n_coord && cd->callback != radial_coord_callbacks [j])
+            j++;
+        if (j == n_coord)
+            return;
+    }
+
+    bool radial_subpixel = true;
+    for (unsigned i = 0; i < subpixel_callbacks->len && radial_subpixel; i++)
+    {
+        lfSubpixelCallbackData *cd =
+            (lfSubpixelCallbackData *)g_ptr_array_index (subpixel_callbacks, i);
+        int j = 0;
+        while (j < n_subpixel && cd->callback != radial_subpixel_callbacks [j])
+            j++;
+        radial_subpixel = j < n_subpixel;
+    }
+
+    // The table must reach the farthest image corner.  The small margin
+    // keeps the last pixel off the final table entry.
+    double x0 = CenterX, x1 = Width * NormScale - CenterX;
+    double y0 = CenterY, y1 = Height * NormScale - CenterY;
+    double r2_max = 1.01 * ((x0 * x0 > x1 * x1 ? x0 * x0 : x1 * x1) +
+                            (y0 * y0 > y1 * y1 ? y0 * y0 : y1 * y1));
+    double step = r2_max / (LF_RADIAL_TABLE_SIZE - 1);
+
+    lfRadialTable *table = g_new (lfRadialTable, 1);
+    table->InvStep = 1.0 / step;
+    table->HasSubpixel = radial_subpixel;
+
+    // Sampling must not count towards the non-converged pixels; a chain
+    // which does not converge somewhere is left to the callbacks instead.
+    guint64 *non_converged = (guint64 *)&NonConvergedCount;
+    guint64 non_converged_before = _lf_stats_read (non_converged);
+    bool valid = true;
+    for (int i = 0; i < LF_RADIAL_TABLE_SIZE && valid; i++)
+    {
+        // The factor is continuous at r = 0, so sample closely next to it
+        float r = i ? sqrt (i * step) : sqrt (step) * 0.001;
+        float coord [6] = { r, 0.0F, r, 0.0F, r, 0.0F };
+
+        for (unsigned j = 0; j < coord_callbacks->len; j++)
+        {
+            lfCoordCallbackData *cd =
+                (lfCoordCallbackData *)g_ptr_array_index (coord_callbacks, j);
+            cd->callback (cd->data, coord, 3);
+        }
+        table->Coord [i] = coord [0] / r;
+        valid = isfinite (table->Coord [i]);
+
+        if (!radial_subpixel)
+            continue;
+        for (unsigned j = 0; j < subpixel_callbacks->len; j++)
+        {
+            lfSubpixelCallbackData *cd =
+                (lfSubpixelCallbackData *)g_ptr_array_index (subpixel_callbacks, j);
+            cd->callback (cd->data, coord, 1);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            table->Subpixel [i * 3 + k] = coord [k * 2] / r;
+            valid = valid && isfinite (table->Subpixel [i * 3 + k]);
+        }
+    }
+
+    // Only the failures of the samples are taken back, not those of other
+    // threads in the meantime
+    guint64 sampled = _lf_stats_read (non_converged) - non_converged_before;
+    if (sampled)
+    {
+        _lf_stats_count (non_converged, -sampled);
+        valid = false;
+    }
+
+    if (valid)
+        RadialTable = table;
+    else
+        g_free (table);
 }
 
 //---------------------------// The C interface //---------------------------//
@@ -300,3 +473,8 @@ int lf_modifier_initialize (
     return modifier->Initialize (lens, format, focal, aperture, distance,
                                  scale, targeom, flags, reverse);
 }
+
+unsigned long long lf_modifier_get_non_converged_count (const lfModifier *modifier)
+{
+    return modifier->GetNonConvergedCount ();
+}
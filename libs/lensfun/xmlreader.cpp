@@ -0,0 +1,447 @@
+/*
+    In-place pull parser for the XML of the database files
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+
+static inline bool _lf_xml_space (char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool _lf_xml_name_start (char c)
+{
+    return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') ||
+        c == '_' || c == ':' || (guchar)c >= 0x80;
+}
+
+static inline bool _lf_xml_name_char (char c)
+{
+    return _lf_xml_name_start (c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+/* Return the first byte which is not part of valid UTF-8 or is zero, or
+   NULL; the database is almost all ASCII, which is checked a word at a
+   time */
+static const char *_lf_xml_check_utf8 (const char *pos, const char *end)
+{
+    const guint64 ones = G_GUINT64_CONSTANT (0x0101010101010101);
+    while (pos < end)
+    {
+        guint64 word;
+        if (end - pos >= 8)
+        {
+            memcpy (&word, pos, 8);
+            // High bits set, or zero bytes
+            if (!((word | ((word - ones) & ~word)) & (ones << 7)))
+            {
+                pos += 8;
+                continue;
+            }
+        }
+
+        size_t len = MIN (end - pos, 4);
+        const char *valid_end;
+        if (g_utf8_validate (pos, len, &valid_end))
+            pos += len;
+        else if (valid_end > pos)
+            pos = valid_end;
+        else
+            return pos;
+    }
+    return NULL;
+}
+
+static inline bool _lf_xml_starts (const char *pos, const char *end, const char *str)
+{
+    size_t len = strlen (str);
+    return (size_t)(end - pos) >= len && !memcmp (pos, str, len);
+}
+
+/* Find a string between pos and end */
+static char *_lf_xml_find (char *pos, char *end, const char *str)
+{
+    size_t len = strlen (str);
+    while ((pos = (char *)memchr (pos, str [0], end - pos)))
+    {
+        if ((size_t)(end - pos) < len)
+            break;
+        if (!memcmp (pos, str, len))
+            return pos;
+        pos++;
+    }
+    return NULL;
+}
+
+lfXmlReader::lfXmlReader (char *data, size_t size)
+{
+    Base = Pos = data;
+    Limit = End = data + size;
+    Restore = NULL;
+    RestoreChar = 0;
+    Invalid = NULL;
+    SelfClosed = false;
+    Depth = 0;
+    Names [0] = Values [0] = NULL;
+    Name = NULL;
+    AttrNames = Names;
+    AttrValues = Values;
+    Text = NULL;
+    TextLen = 0;
+}
+
+void lfXmlReader::SetRange (char *pos, char *end)
+{
+    if (Restore)
+    {
+        *Restore = RestoreChar;
+        Restore = NULL;
+    }
+
+    Pos = pos;
+    End = end;
+    Invalid = _lf_xml_check_utf8 (pos, end);
+}
+
+void lfXmlReader::GetPosition (int &line, int &col) const
+{
+    const char *line_start = Base;
+    line = 1;
+    for (const char *c = Base; c < Pos; c++)
+        if (*c == '\n')
+        {
+            line++;
+            line_start = c + 1;
+        }
+    col = int (Pos - line_start) + 1;
+}
+
+void lfXmlReader::Move (char *data, size_t size)
+{
+    Pos = data + (Pos - Base);
+    End = data + (End - Base);
+    if (Restore)
+        Restore = data + (Restore - Base);
+    if (Invalid)
+        Invalid = data + (Invalid - Base);
+    for (int i = 0; i < Depth; i++)
+        Stack [i] = data + (Stack [i] - Base);
+    Base = data;
+    Limit = data + size;
+}
+
+lfXmlToken lfXmlReader::Fail (GError **error, const char *format, ...)
+{
+    va_list args;
+    va_start (args, format);
+    gchar *message = g_strdup_vprintf (format, args);
+    va_end (args);
+    g_set_error_literal (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE, message);
+    g_free (message);
+    return LF_XML_ERROR;
+}
+
+/* Replace the entities between str and end by the characters they stand
+   for; the result is never longer, so it is done in place */
+bool lfXmlReader::Decode (char *str, char *&end, GError **error)
+{
+    char *in = (char *)memchr (str, '&', end - str);
+    if (!in)
+        return true;
+
+    char *out = in;
+    while (in < end)
+    {
+        if (*in != '&')
+        {
+            *out++ = *in++;
+            continue;
+        }
+
+        char *name = in + 1;
+        char *semi = (char *)memchr (name, ';', end - name);
+        if (!semi)
+        {
+            Fail (error, "Entity '%.*s' does not end with a semicolon",
+                  int (MIN (end - in, 10)), in);
+            return false;
+        }
+
+        size_t len = semi - name;
+        if (len == 2 && !memcmp (name, "lt", 2))
+            *out++ = '<';
+        else if (len == 2 && !memcmp (name, "gt", 2))
+            *out++ = '>';
+        else if (len == 3 && !memcmp (name, "amp", 3))
+            *out++ = '&';
+        else if (len == 4 && !memcmp (name, "quot", 4))
+            *out++ = '"';
+        else if (len == 4 && !memcmp (name, "apos", 4))
+            *out++ = '\'';
+        else if (len >= 2 && name [0] == '#')
+        {
+            bool hex = name [1] == 'x';
+            const char *digit = name + (hex ? 2 : 1);
+            gunichar c = 0;
+            bool ok = digit < semi;
+            for (; ok && digit < semi; digit++)
+            {
+                int value = hex ? g_ascii_xdigit_value (*digit) :
+                    g_ascii_digit_value (*digit);
+                if (value < 0 || c > 0x10FFFF)
+                    ok = false;
+                c = c * (hex ? 16 : 10) + value;
+            }
+            if (!ok || !c || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+            {
+                Fail (error, "Character reference '&%.*s;' is not valid",
+                      int (len), name);
+                return false;
+            }
+            // The UTF-8 sequence is never longer than the reference
+            out += g_unichar_to_utf8 (c, out);
+        }
+        else
+        {
+            Fail (error, "Entity name '%.*s' is not known", int (len), name);
+            return false;
+        }
+        in = semi + 1;
+    }
+
+    end = out;
+    return true;
+}
+
+lfXmlToken lfXmlReader::Next (GError **error)
+{
+    if (Restore)
+    {
+        *Restore = RestoreChar;
+        Restore = NULL;
+    }
+
+    if (Invalid)
+    {
+        Pos = (char *)Invalid;
+        return Fail (error, "Invalid UTF-8 encoded text");
+    }
+
+    if (SelfClosed)
+    {
+        SelfClosed = false;
+        Name = Stack [--Depth];
+        return LF_XML_END;
+    }
+
+    while (Pos < End)
+    {
+        if (*Pos != '<')
+        {
+            char *text = Pos;
+            char *stop = (char *)memchr (Pos, '<', End - Pos);
+            if (!stop)
+                stop = End;
+
+            if (!Depth)
+            {
+                for (; Pos < stop; Pos++)
+                    if (!_lf_xml_space (*Pos))
+                        return Fail (error, "Text is not allowed outside of the root element");
+                continue;
+            }
+
+            Pos = stop;
+            // The document ends within an element; the caller will notice
+            if (stop == Limit)
+                break;
+
+            char *text_end = stop;
+            if (!Decode (text, text_end, error))
+                return LF_XML_ERROR;
+            if (text_end == stop)
+            {
+                Restore = stop;
+                RestoreChar = *stop;
+            }
+            *text_end = 0;
+            Text = text;
+            TextLen = text_end - text;
+            return LF_XML_TEXT;
+        }
+
+        // Most tags are start or end tags, so look at the second byte first
+        char next = Pos + 1 < End ? Pos [1] : 0;
+
+        if (next == '!' && _lf_xml_starts (Pos, End, "<!--"))
+        {
+            char *end = _lf_xml_find (Pos + 4, End, "-->");
+            if (!end)
+                return Fail (error, "Comment is not terminated");
+            Pos = end + 3;
+            continue;
+        }
+
+        if (next == '?')
+        {
+            char *end = _lf_xml_find (Pos + 2, End, "?>");
+            if (!end)
+                return Fail (error, "Processing instruction is not terminated");
+            Pos = end + 2;
+            continue;
+        }
+
+        if (next == '!' && _lf_xml_starts (Pos, End, "<![CDATA["))
+        {
+            char *text = Pos + 9;
+            char *end = _lf_xml_find (text, End, "]]>");
+            if (!end)
+                return Fail (error, "CDATA section is not terminated");
+            if (!Depth)
+                return Fail (error, "Text is not allowed outside of the root element");
+            Pos = end + 3;
+            *end = 0;
+            Text = text;
+            TextLen = end - text;
+            return LF_XML_TEXT;
+        }
+
+        if (next == '!')
+        {
+            // <!DOCTYPE ...>, possibly with an internal subset in brackets
+            int brackets = 0;
+            char quote = 0;
+            for (Pos += 2; Pos < End; Pos++)
+                if (quote)
+                    quote = *Pos == quote ? 0 : quote;
+                else if (*Pos == '"' || *Pos == '\'')
+                    quote = *Pos;
+                else if (*Pos == '[')
+                    brackets++;
+                else if (*Pos == ']')
+                    brackets--;
+                else if (*Pos == '>' && brackets <= 0)
+                    break;
+            if (Pos >= End)
+                return Fail (error, "Document type declaration is not terminated");
+            Pos++;
+            continue;
+        }
+
+        if (next == '/')
+        {
+            char *name = Pos + 2;
+            char *c = name;
+            while (c < End && _lf_xml_name_char (*c))
+                c++;
+            char *name_end = c;
+            while (c < End && _lf_xml_space (*c))
+                c++;
+            if (name_end == name || c >= End || *c != '>')
+                return Fail (error, "Invalid end tag '%.*s'",
+                             int (MIN (c - Pos, 40)), Pos);
+            Pos = c + 1;
+            *name_end = 0;
+
+            if (!Depth)
+                return Fail (error, "Element '%s' was closed, but no element was open",
+                             name);
+            if (strcmp (name, Stack [Depth - 1]))
+                return Fail (error, "Element '%s' was closed, but the currently "
+                             "open element is '%s'", name, Stack [Depth - 1]);
+            Name = Stack [--Depth];
+            return LF_XML_END;
+        }
+
+        // A start tag
+        char *name = Pos + 1;
+        if (name >= End || !_lf_xml_name_start (*name))
+            return Fail (error, "'<' is not followed by an element name");
+        char *c = name;
+        while (c < End && _lf_xml_name_char (*c))
+            c++;
+
+        // The names are terminated once the whole tag is read, as their
+        // ends are the separators looked at here
+        char *name_ends [LF_XML_MAX_ATTRS + 1];
+        name_ends [0] = c;
+        int n = 0;
+        for (;;)
+        {
+            bool space = false;
+            while (c < End && _lf_xml_space (*c))
+                c++, space = true;
+            if (c >= End)
+                return Fail (error, "Element '%.*s' is not terminated",
+                             int (name_ends [0] - name), name);
+            if (*c == '>')
+                break;
+            if (*c == '/')
+            {
+                if (c + 1 >= End || c [1] != '>')
+                    return Fail (error, "'/' must be followed by '>' in element '%.*s'",
+                                 int (name_ends [0] - name), name);
+                SelfClosed = true;
+                c++;
+                break;
+            }
+            if (!space || !_lf_xml_name_start (*c))
+                return Fail (error, "'%c' is not valid in element '%.*s'",
+                             *c, int (name_ends [0] - name), name);
+            if (n >= LF_XML_MAX_ATTRS)
+                return Fail (error, "Element '%.*s' has too many attributes",
+                             int (name_ends [0] - name), name);
+
+            Names [n] = c;
+            while (c < End && _lf_xml_name_char (*c))
+                c++;
+            name_ends [n + 1] = c;
+            while (c < End && _lf_xml_space (*c))
+                c++;
+            if (c >= End || *c != '=')
+                return Fail (error, "Attribute '%.*s' of element '%.*s' has no value",
+                             int (name_ends [n + 1] - Names [n]), Names [n],
+                             int (name_ends [0] - name), name);
+            c++;
+            while (c < End && _lf_xml_space (*c))
+                c++;
+            if (c >= End || (*c != '"' && *c != '\''))
+                return Fail (error, "Value of attribute '%.*s' is not quoted",
+                             int (name_ends [n + 1] - Names [n]), Names [n]);
+
+            char *value = c + 1;
+            char *value_end = (char *)memchr (value, *c, End - value);
+            if (!value_end)
+                return Fail (error, "Value of attribute '%.*s' is not terminated",
+                             int (name_ends [n + 1] - Names [n]), Names [n]);
+            if (memchr (value, '<', value_end - value))
+                return Fail (error, "'<' is not allowed in the value of attribute '%.*s'",
+                             int (name_ends [n + 1] - Names [n]), Names [n]);
+            c = value_end + 1;
+            if (!Decode (value, value_end, error))
+                return LF_XML_ERROR;
+            *value_end = 0;
+            Values [n++] = value;
+        }
+        Pos = c + 1;
+
+        for (int i = 0; i <= n; i++)
+            *name_ends [i] = 0;
+        Names [n] = Values [n] = NULL;
+
+        if (Depth >= LF_XML_MAX_DEPTH)
+        {
+            SelfClosed = false;
+            return Fail (error, "Element '%s' is nested too deeply", name);
+        }
+        Stack [Depth++] = name;
+        Name = name;
+        AttrNames = Names;
+        AttrValues = Values;
+        return LF_XML_START;
+    }
+
+    return LF_XML_EOF;
+}
@@ -0,0 +1,189 @@
+/*
+    Buffered writer for the XML of the database files
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+
+lfXmlWriter::lfXmlWriter (int fd, lfCompression compression)
+{
+    Fd = fd;
+    Encoder = fd >= 0 && compression != LF_COMPRESSION_NONE ?
+        new lfEncoder (compression, fd) : NULL;
+    Buffer = g_string_sized_new (fd >= 0 ? LF_XML_WRITE_CHUNK + 1024 : 1024);
+    Error = 0;
+}
+
+lfXmlWriter::~lfXmlWriter ()
+{
+    if (Buffer)
+        g_string_free (Buffer, TRUE);
+    delete Encoder;
+}
+
+void lfXmlWriter::Write (const char *str, size_t len)
+{
+    g_string_append_len (Buffer, str, len);
+    if (Fd >= 0 && Buffer->len >= LF_XML_WRITE_CHUNK)
+        Flush ();
+}
+
+void lfXmlWriter::Text (const char *str)
+{
+    // Same escapes as g_markup_escape_text(), but without a copy of the
+    // string for the common case of nothing to escape
+    const char *start = str;
+    for (;; str++)
+    {
+        guchar c = *str;
+        const char *entity;
+        char ref [8];
+
+        if (c >= 0x20 && c != '&' && c != '<' && c != '>' &&
+            c != '\'' && c != '"' && c != 0x7f && c != 0xc2)
+            continue;
+
+        switch (c)
+        {
+            case 0:
+                g_string_append_len (Buffer, start, str - start);
+                if (Fd >= 0 && Buffer->len >= LF_XML_WRITE_CHUNK)
+                    Flush ();
+                return;
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '\'': entity = "&apos;"; break;
+            case '"': entity = "&quot;"; break;
+            case '\t': case '\n': case '\r':
+                continue;
+            case 0xc2:
+                // C1 control characters except NEL
+                c = str [1];
+                if (c < 0x80 || c > 0x9f || c == 0x85)
+                    continue;
+                g_string_append_len (Buffer, start, str - start);
+                str++;
+                start = str + 1;
+                g_snprintf (ref, sizeof (ref), "&#x%x;", c);
+                g_string_append (Buffer, ref);
+                continue;
+            default:
+                g_snprintf (ref, sizeof (ref), "&#x%x;", c);
+                entity = ref;
+                break;
+        }
+
+        g_string_append_len (Buffer, start, str - start);
+        g_string_append (Buffer, entity);
+        start = str + 1;
+    }
+}
+
+void lfXmlWriter::Number (double value)
+{
+    char buf [G_ASCII_DTOSTR_BUF_SIZE];
+    g_ascii_formatd (buf, sizeof (buf), "%g", value);
+    g_string_append (Buffer, buf);
+}
+
+void lfXmlWriter::Attr (const char *name, double value)
+{
+    g_string_append (Buffer, name);
+    g_string_append_len (Buffer, "=\"", 2);
+    Number (value);
+    g_string_append_len (Buffer, "\" ", 2);
+}
+
+void lfXmlWriter::Attr (const char *name, const char *value)
+{
+    g_string_append (Buffer, name);
+    g_string_append_len (Buffer, "=\"", 2);
+    Text (value);
+    g_string_append_len (Buffer, "\" ", 2);
+}
+
+void lfXmlWriter::Element (const char *prefix, const char *element, const char *value)
+{
+    g_string_append (Buffer, prefix);
+    g_string_append_c (Buffer, '<');
+    g_string_append (Buffer, element);
+    g_string_append_c (Buffer, '>');
+    Text (value);
+    g_string_append_len (Buffer, "</", 2);
+    g_string_append (Buffer, element);
+    Write (">\n", 2);
+}
+
+void lfXmlWriter::Element (const char *prefix, const char *element, double value)
+{
+    g_string_append (Buffer, prefix);
+    g_string_append_c (Buffer, '<');
+    g_string_append (Buffer, element);
+    g_string_append_c (Buffer, '>');
+    Number (value);
+    g_string_append_len (Buffer, "</", 2);
+    g_string_append (Buffer, element);
+    Write (">\n", 2);
+}
+
+void lfXmlWriter::MLstr (const char *prefix, const char *element, lfMLstr val)
+{
+    if (!val)
+        return;
+
+    Element (prefix, element, val);
+
+    for (const char *cur = val;;)
+    {
+        cur = strchr (cur, 0) + 1;
+        if (!*cur)
+            break;
+        const char *lang = cur;
+        cur = strchr (cur, 0) + 1;
+
+        g_string_append (Buffer, prefix);
+        g_string_append_c (Buffer, '<');
+        g_string_append (Buffer, element);
+        g_string_append_c (Buffer, ' ');
+        Attr ("lang", lang);
+        // Attr() leaves a space for the next attribute
+        Buffer->str [Buffer->len - 1] = '>';
+        Text (cur);
+        g_string_append_len (Buffer, "</", 2);
+        g_string_append (Buffer, element);
+        Write (">\n", 2);
+    }
+}
+
+bool lfXmlWriter::Flush ()
+{
+    if (Fd < 0 || Error)
+        return !Error;
+
+    if (Encoder)
+        Error = Encoder->Write (Buffer->str, Buffer->len, false);
+    else
+        Error = _lf_write_all (Fd, Buffer->str, Buffer->len);
+
+    g_string_truncate (Buffer, 0);
+    return !Error;
+}
+
+bool lfXmlWriter::Finish ()
+{
+    if (!Encoder || Error)
+        return Flush ();
+
+    Error = Encoder->Write (Buffer->str, Buffer->len, true);
+    g_string_truncate (Buffer, 0);
+    return !Error;
+}
+
+char *lfXmlWriter::Steal ()
+{
+    char *output = g_string_free (Buffer, FALSE);
+    Buffer = NULL;
+    return output;
+}
@@ -1,5 +1,9 @@
 #include <glib.h>
+#include <errno.h>
 #include <locale.h>
+#include <string.h>
+#include <strings.h>
+#include <glib/gstdio.h>
 #include "lensfun.h"
 
 typedef struct {
@@ -73,6 +77,629 @@ void test_DB_cam_search(lfFixture* lfFix, gconstpointer data)
 
 }
 
+// test replacing loaded entries, both by loading again and by hand
+void test_DB_reload(lfFixture* lfFix, gconstpointer data)
+{
+    int lenses, cameras;
+    for (lenses = 0; lfFix->db->GetLenses () [lenses]; lenses++)
+        ;
+    for (cameras = 0; lfFix->db->GetCameras () [cameras]; cameras++)
+        ;
+
+    lfFix->db->Load("data/db");
+    int count;
+    for (count = 0; lfFix->db->GetLenses () [count]; count++)
+        ;
+    g_assert_cmpint(count, ==, lenses);
+    for (count = 0; lfFix->db->GetCameras () [count]; count++)
+        ;
+    g_assert_cmpint(count, ==, cameras);
+
+    const lfLens **found = lfFix->db->FindLenses (NULL, NULL, "smc Pentax-FA 28mm f/2.8 AL");
+    g_assert_nonnull(found);
+    lfLens *lens = new lfLens (*found [0]);
+    lf_free (found);
+    lens->CenterX = 0.01;
+    lfFix->db->AddLens (lens);
+
+    bool replaced = false;
+    for (count = 0; lfFix->db->GetLenses () [count]; count++)
+        if (lfFix->db->GetLenses () [count] == lens)
+            replaced = true;
+    g_assert_true(replaced);
+    g_assert_cmpint(count, ==, lenses);
+
+    // Of equal lenses in one load, the last one wins as well
+    gchar *xml = g_strdup_printf (
+        "<lensdatabase version=\"2\">\n"
+        "<lens><maker>%s</maker><model>%s</model><mount>%s</mount>"
+        "<cropfactor>%g</cropfactor><aspect-ratio>4:3</aspect-ratio></lens>\n"
+        "<lens><maker>%s</maker><model>%s</model><mount>%s</mount>"
+        "<cropfactor>%g</cropfactor><aspect-ratio>16:9</aspect-ratio></lens>\n"
+        "</lensdatabase>\n",
+        lens->Maker, lens->Model, lens->Mounts [0], lens->CropFactor,
+        lens->Maker, lens->Model, lens->Mounts [0], lens->CropFactor);
+    g_assert_cmpint(lfFix->db->Load ("reload.xml", xml, strlen (xml)), ==, LF_NO_ERROR);
+    g_free (xml);
+    for (count = 0; lfFix->db->GetLenses () [count]; count++)
+        ;
+    g_assert_cmpint(count, ==, lenses);
+    found = lfFix->db->FindLenses (NULL, NULL, "smc Pentax-FA 28mm f/2.8 AL");
+    g_assert_nonnull(found);
+    g_assert_cmpfloat(found [0]->AspectRatio, ==, 16.0f / 9.0f);
+    lf_free (found);
+}
+
+// test copying and editing the calibration data of a lens
+void test_DB_lens_calibrations(lfFixture* lfFix, gconstpointer data)
+{
+    const lfLens **lenses = lfFix->db->FindLenses (NULL, NULL, "smc Pentax-DA 50-200mm f/4-5.6 DA ED");
+    g_assert_nonnull(lenses);
+    const lfLens *original = lenses [0];
+    lf_free (lenses);
+    g_assert_nonnull(original->CalibDistortion);
+
+    lfLens lens (*original);
+    int count;
+    for (count = 0; original->CalibDistortion [count]; count++)
+    {
+        g_assert_true(lens.CalibDistortion [count] != original->CalibDistortion [count]);
+        g_assert_cmpfloat(lens.CalibDistortion [count]->Focal, ==,
+                          original->CalibDistortion [count]->Focal);
+        g_assert_cmpfloat(lens.CalibDistortion [count]->Terms [0], ==,
+                          original->CalibDistortion [count]->Terms [0]);
+    }
+    g_assert_null(lens.CalibDistortion [count]);
+
+    // Replace the first entry, add a new one, and remove the first one
+    lfLensCalibDistortion dc = *original->CalibDistortion [0];
+    dc.Terms [0] = 0.5;
+    lens.AddCalibDistortion (&dc);
+    g_assert_cmpfloat(lens.CalibDistortion [0]->Terms [0], ==, 0.5);
+    dc.Focal = 1000;
+    for (int i = 0; i < 10; i++, dc.Focal++)
+        lens.AddCalibDistortion (&dc);
+    g_assert_cmpfloat(lens.CalibDistortion [count + 9]->Focal, ==, 1009);
+    g_assert_null(lens.CalibDistortion [count + 10]);
+    g_assert_true(lens.RemoveCalibDistortion (0));
+    g_assert_cmpfloat(lens.CalibDistortion [0]->Focal, ==,
+                      count > 1 ? original->CalibDistortion [1]->Focal : 1000);
+    g_assert_cmpfloat(lens.CalibDistortion [count + 8]->Focal, ==, 1009);
+    g_assert_null(lens.CalibDistortion [count + 9]);
+    g_assert_false(lens.RemoveCalibDistortion (count + 9));
+
+    lfLens copy;
+    copy = lens;
+    for (int i = 0; i < count + 9; i++)
+        g_assert_cmpfloat(copy.CalibDistortion [i]->Focal, ==, lens.CalibDistortion [i]->Focal);
+    g_assert_null(copy.CalibDistortion [count + 9]);
+
+    // Remove from the front across the capacity boundaries at 16, 8 and 4
+    lfLens shrink;
+    dc.Focal = 10;
+    for (int i = 0; i < 17; i++, dc.Focal++)
+        shrink.AddCalibDistortion (&dc);
+    for (int removed = 1; removed < 17; removed++)
+    {
+        g_assert_true(shrink.RemoveCalibDistortion (0));
+        int i;
+        for (i = 0; shrink.CalibDistortion [i]; i++)
+            g_assert_cmpfloat(shrink.CalibDistortion [i]->Focal, ==, 10 + removed + i);
+        g_assert_cmpint(i, ==, 17 - removed);
+        // Adding works on the shorter list as well
+        lfLens grown (shrink);
+        grown.AddCalibDistortion (&dc);
+        g_assert_cmpfloat(grown.CalibDistortion [i]->Focal, ==, dc.Focal);
+        g_assert_cmpfloat(grown.CalibDistortion [0]->Focal, ==, 10 + removed);
+    }
+    g_assert_true(shrink.RemoveCalibDistortion (0));
+    g_assert_null(shrink.CalibDistortion);
+}
+
+// test that calibration data loaded on demand matches the eager load
+void test_DB_lazy_calibrations(lfFixture* lfFix, gconstpointer data)
+{
+    lfDatabase lazy;
+    lazy.SetLoadFlags (LF_LOAD_LAZY_CALIBRATIONS);
+    lazy.Load ("data/db");
+
+    // The files are read again after the relative path became invalid
+    gchar *cwd = g_get_current_dir ();
+    g_assert_cmpint(g_chdir (g_get_tmp_dir ()), ==, 0);
+
+    const lfLens *const *eager_lenses = lfFix->db->GetLenses ();
+    const lfLens *const *lazy_lenses = lazy.GetLenses ();
+    int count;
+    for (count = 0; eager_lenses [count]; count++)
+    {
+        const lfLens *eager = eager_lenses [count];
+        const lfLens *lens = lazy_lenses [count];
+        g_assert_nonnull(lens);
+        g_assert_cmpstr(lens->Model, ==, eager->Model);
+        g_assert_cmpfloat(lens->MinFocal, ==, eager->MinFocal);
+        g_assert_cmpfloat(lens->MaxFocal, ==, eager->MaxFocal);
+        g_assert_cmpfloat(lens->MinAperture, ==, eager->MinAperture);
+        g_assert_cmpfloat(lens->MaxAperture, ==, eager->MaxAperture);
+
+        lfLensCalibDistortion eager_dc, lazy_dc;
+        bool found = eager->InterpolateDistortion (eager->MinFocal, eager_dc);
+        g_assert_true(lens->InterpolateDistortion (lens->MinFocal, lazy_dc) == found);
+        if (found)
+            g_assert_cmpfloat(lazy_dc.Terms [0], ==, eager_dc.Terms [0]);
+
+        int n = 0;
+        if (eager->CalibVignetting)
+            for (; eager->CalibVignetting [n]; n++)
+                g_assert_cmpfloat(lens->CalibVignetting [n]->Terms [1], ==,
+                                  eager->CalibVignetting [n]->Terms [1]);
+        g_assert_true(!lens->CalibVignetting || !lens->CalibVignetting [n]);
+    }
+    g_assert_null(lazy_lenses [count]);
+    g_assert_cmpint(g_chdir (cwd), ==, 0);
+    g_free (cwd);
+
+    // The calibration text must be kept when loading from memory
+    gchar *contents;
+    gsize length;
+    g_assert_true(g_file_get_contents ("data/db/slr-pentax.xml", &contents, &length, NULL));
+    lfDatabase memory;
+    memory.SetLoadFlags (LF_LOAD_LAZY_CALIBRATIONS);
+    g_assert_cmpint(memory.Load ("slr-pentax.xml", contents, length), ==, LF_NO_ERROR);
+    memset (contents, ' ', length);
+    g_free (contents);
+
+    const lfLens **lenses = memory.FindLenses (NULL, NULL, "smc Pentax-DA 50-200mm f/4-5.6 DA ED");
+    g_assert_nonnull(lenses);
+    g_assert_null(lenses [0]->CalibDistortion);
+    lfLensCalibDistortion dc;
+    g_assert_true(lenses [0]->InterpolateDistortion (100, dc));
+    g_assert_nonnull(lenses [0]->CalibDistortion);
+    lf_free (lenses);
+
+    // Calibration data of a file which changed after loading is refused
+    gchar *dir = g_build_filename (g_get_tmp_dir (), "lensfun-test-XXXXXX", NULL);
+    g_assert_nonnull(g_mkdtemp (dir));
+    gchar *path = g_build_filename (dir, "pentax.xml", NULL);
+    g_assert_true(g_file_get_contents ("data/db/slr-pentax.xml", &contents, &length, NULL));
+    g_assert_true(g_file_set_contents (path, contents, length, NULL));
+    lfDatabase changed;
+    changed.SetLoadFlags (LF_LOAD_LAZY_CALIBRATIONS);
+    g_assert_cmpint(changed.Load (path), ==, LF_NO_ERROR);
+    char *k1 = strstr (contents, "k1=\"-0.004038\"");
+    g_assert_nonnull(k1);
+    memcpy (k1, "k1=\"-0.004039\"", 14);
+    g_assert_true(g_file_set_contents (path, contents, length, NULL));
+    g_free (contents);
+
+    lenses = changed.FindLenses (NULL, NULL, "smc Pentax-DA 50-200mm f/4-5.6 DA ED");
+    g_assert_nonnull(lenses);
+    g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*the file has changed*");
+    g_assert_false(lenses [0]->InterpolateDistortion (100, dc));
+    g_test_assert_expected_messages ();
+    lf_free (lenses);
+
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (path);
+    g_free (dir);
+}
+
+// Every thread walks all lenses, starting at a different one, so that the
+// lazily loaded calibrations are stored in the arena by competing threads
+struct lfLazyThread
+{
+    const lfLens **Lenses;
+    int Count;
+    int Start;
+    float *Terms;
+};
+
+static gpointer lazy_thread (gpointer data)
+{
+    lfLazyThread *thread = (lfLazyThread *)data;
+    for (int i = 0; i < thread->Count; i++)
+    {
+        int n = (thread->Start + i) % thread->Count;
+        const lfLens *lens = thread->Lenses [n];
+        lfLensCalibDistortion dc;
+        thread->Terms [n] = lens->InterpolateDistortion (lens->MinFocal, dc) ?
+            dc.Terms [0] : -1000;
+    }
+    return NULL;
+}
+
+// Adding lenses checks whether they are in the arena at the same time
+static gpointer add_thread (gpointer data)
+{
+    lfDatabase *db = (lfDatabase *)data;
+    for (int i = 0; i < 200; i++)
+    {
+        lfLens *lens = new lfLens ();
+        gchar *model = g_strdup_printf ("Thread test lens %d", i);
+        lens->SetMaker ("Thread");
+        lens->SetModel (model);
+        lens->AddMount ("M42");
+        g_free (model);
+        db->AddLens (lens);
+    }
+    return NULL;
+}
+
+// test loading calibrations on demand from several threads at once
+void test_DB_lazy_threads(lfFixture* lfFix, gconstpointer data)
+{
+    lfDatabase lazy;
+    lazy.SetLoadFlags (LF_LOAD_LAZY_CALIBRATIONS);
+    g_assert_cmpint(lazy.Load ("data/db"), ==, LF_NO_ERROR);
+
+    // The list of lenses changes while adding lenses
+    const lfLens *const *eager_lenses = lfFix->db->GetLenses ();
+    int count = 0;
+    while (eager_lenses [count])
+        count++;
+    const lfLens **lazy_lenses = g_new (const lfLens *, count);
+    memcpy (lazy_lenses, lazy.GetLenses (), count * sizeof (lfLens *));
+
+    const int nthreads = 8;
+    lfLazyThread threads [nthreads];
+    GThread *handles [nthreads];
+    GThread *adder = g_thread_new ("add", add_thread, &lazy);
+    for (int t = 0; t < nthreads; t++)
+    {
+        threads [t].Lenses = lazy_lenses;
+        threads [t].Count = count;
+        threads [t].Start = t * count / nthreads;
+        threads [t].Terms = g_new (float, count);
+        handles [t] = g_thread_new ("lazy", lazy_thread, &threads [t]);
+    }
+    for (int t = 0; t < nthreads; t++)
+        g_thread_join (handles [t]);
+    g_thread_join (adder);
+
+    for (int n = 0; n < count; n++)
+    {
+        const lfLens *eager = eager_lenses [n];
+        lfLensCalibDistortion dc;
+        float expected = eager->InterpolateDistortion (eager->MinFocal, dc) ?
+            dc.Terms [0] : -1000;
+        for (int t = 0; t < nthreads; t++)
+            g_assert_cmpfloat(threads [t].Terms [n], ==, expected);
+    }
+    for (int t = 0; t < nthreads; t++)
+        g_free (threads [t].Terms);
+    g_free (lazy_lenses);
+}
+
+static const lfLens *find_lens (const lfDatabase *db, const char *model)
+{
+    const lfLens **lenses = db->FindLenses (NULL, NULL, model);
+    const lfLens *lens = lenses ? lenses [0] : NULL;
+    lf_free (lenses);
+    return lens;
+}
+
+// test publishing new snapshots while old ones are still in use
+void test_DB_live_reload(lfFixture* lfFix, gconstpointer data)
+{
+    gchar *dir = g_build_filename (g_get_tmp_dir (), "lensfun-test-XXXXXX", NULL);
+    g_assert_nonnull(g_mkdtemp (dir));
+    gchar *pentax = g_build_filename (dir, "pentax.xml", NULL);
+    gchar *extra = g_build_filename (dir, "extra.xml", NULL);
+    gchar *contents;
+    gsize length;
+    g_assert_true(g_file_get_contents ("data/db/slr-pentax.xml", &contents, &length, NULL));
+    g_assert_true(g_file_set_contents (pentax, contents, length, NULL));
+    g_free (contents);
+
+    lfLiveDatabase live;
+    live.AddLocation (dir);
+    g_assert_null(live.Acquire ());
+    bool changed;
+    g_assert_cmpint(live.Reload (&changed), ==, LF_NO_ERROR);
+    g_assert_true(changed);
+    const lfDatabase *first = live.Acquire ();
+    g_assert_nonnull(first);
+    g_assert_nonnull(find_lens (first, "smc Pentax-DA 50-200mm f/4-5.6 DA ED"));
+
+    // Nothing changed, so the snapshot stays the same
+    g_assert_cmpint(live.Reload (&changed), ==, LF_NO_ERROR);
+    g_assert_false(changed);
+    const lfDatabase *db = live.Acquire ();
+    g_assert_true(db == first);
+    live.Release (db);
+
+    // A new file is picked up, and the old snapshot is still usable
+    const char *xml =
+        "<lensdatabase version=\"2\">\n"
+        "    <lens>\n"
+        "        <maker>Pentax</maker>\n"
+        "        <model>smc Pentax-DA 99mm f/9 Live</model>\n"
+        "        <mount>Pentax KAF</mount>\n"
+        "        <cropfactor>1.5</cropfactor>\n"
+        "    </lens>\n"
+        "</lensdatabase>\n";
+    g_assert_true(g_file_set_contents (extra, xml, -1, NULL));
+    g_assert_cmpint(live.Reload (&changed), ==, LF_NO_ERROR);
+    g_assert_true(changed);
+    const lfDatabase *second = live.Acquire ();
+    g_assert_true(second != first);
+    g_assert_nonnull(find_lens (second, "smc Pentax-DA 99mm f/9 Live"));
+    g_assert_nonnull(find_lens (second, "smc Pentax-DA 50-200mm f/4-5.6 DA ED"));
+    const lfLens *lens = find_lens (first, "smc Pentax-DA 99mm f/9 Live");
+    g_assert_true(!lens || strcmp (lens->Model, "smc Pentax-DA 99mm f/9 Live"));
+    live.Release (first);
+
+    // Writing the file again right away keeps its size and usually its time
+    // stamp, but the new contents are picked up
+    gchar *changed_xml = g_strdup (xml);
+    memcpy (strstr (changed_xml, "99mm"), "98mm", 4);
+    g_assert_true(g_file_set_contents (extra, changed_xml, -1, NULL));
+    g_assert_cmpint(live.Reload (&changed), ==, LF_NO_ERROR);
+    g_assert_true(changed);
+    db = live.Acquire ();
+    lens = find_lens (db, "smc Pentax-DA 98mm f/9 Live");
+    g_assert_nonnull(lens);
+    g_assert_cmpstr(lens->Model, ==, "smc Pentax-DA 98mm f/9 Live");
+    g_assert_nonnull(find_lens (db, "smc Pentax-DA 50-200mm f/4-5.6 DA ED"));
+    live.Release (db);
+
+    // The same contents once more are no change
+    g_assert_true(g_file_set_contents (extra, changed_xml, -1, NULL));
+    g_assert_cmpint(live.Reload (&changed), ==, LF_NO_ERROR);
+    g_assert_false(changed);
+    g_free (changed_xml);
+
+    // Removed files go away again
+    g_unlink (extra);
+    g_assert_cmpint(live.Reload (&changed), ==, LF_NO_ERROR);
+    g_assert_true(changed);
+    db = live.Acquire ();
+    lens = find_lens (db, "smc Pentax-DA 99mm f/9 Live");
+    g_assert_true(!lens || strcmp (lens->Model, "smc Pentax-DA 99mm f/9 Live"));
+    live.Release (db);
+    g_assert_nonnull(find_lens (second, "smc Pentax-DA 99mm f/9 Live"));
+    live.Release (second);
+
+    g_unlink (pentax);
+    g_rmdir (dir);
+    g_free (pentax);
+    g_free (extra);
+    g_free (dir);
+}
+
+static bool has_mount (const char *const *mounts, const char *mount)
+{
+    for (int i = 0; mounts [i]; i++)
+        if (!strcasecmp (mounts [i], mount))
+            return true;
+    return false;
+}
+
+// test loading only the cameras and lenses of some makers
+void test_DB_load_filter(lfFixture* lfFix, gconstpointer data)
+{
+    static const char *const makers [] = { "Canon", "Sony", NULL };
+    lfDatabase db;
+    db.SetLoadFilter (makers, NULL);
+    g_assert_cmpint(db.Load ("data/db"), ==, LF_NO_ERROR);
+
+    int count, all;
+    for (count = 0; db.GetMounts () [count]; count++)
+        ;
+    for (all = 0; lfFix->db->GetMounts () [all]; all++)
+        ;
+    g_assert_cmpint(count, ==, all);
+
+    // The mounts which lenses must fit
+    GPtrArray *wanted = g_ptr_array_new ();
+    int cameras = 0;
+    for (const lfCamera *const *camera = db.GetCameras (); *camera; camera++, cameras++)
+    {
+        g_assert_true(!strcasecmp ((*camera)->Maker, "Canon") ||
+                      !strcasecmp ((*camera)->Maker, "Sony"));
+        const lfMount *mount = db.FindMount ((*camera)->Mount);
+        g_ptr_array_add (wanted, (gpointer)(*camera)->Mount);
+        if (mount && mount->Compat)
+            for (int i = 0; mount->Compat [i]; i++)
+                g_ptr_array_add (wanted, mount->Compat [i]);
+    }
+    g_assert_cmpint(cameras, >, 0);
+    g_ptr_array_add (wanted, NULL);
+
+    int expected = 0;
+    for (const lfLens *const *lens = lfFix->db->GetLenses (); *lens; lens++)
+    {
+        bool fits = !strcasecmp ((*lens)->Maker, "Canon") ||
+            !strcasecmp ((*lens)->Maker, "Sony");
+        for (int i = 0; !fits && (*lens)->Mounts [i]; i++)
+            fits = has_mount ((const char *const *)wanted->pdata, (*lens)->Mounts [i]);
+        if (fits)
+            expected++;
+    }
+    for (count = 0; db.GetLenses () [count]; count++)
+        ;
+    for (all = 0; lfFix->db->GetLenses () [all]; all++)
+        ;
+    g_assert_cmpint(count, ==, expected);
+    g_assert_cmpint(count, <, all);
+    g_ptr_array_free (wanted, TRUE);
+
+    g_assert_nonnull(find_lens (&db, "Canon EF 50mm f/1.8 II"));
+    const lfLens *lens = find_lens (&db, "smc Pentax-DA 50-200mm f/4-5.6 DA ED");
+    g_assert_true(!lens || strcmp (lens->Model, "smc Pentax-DA 50-200mm f/4-5.6 DA ED"));
+}
+
+// test the parts of XML which the database files may use
+void test_DB_xml_syntax(lfFixture* lfFix, gconstpointer data)
+{
+    static const char xml [] =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<!DOCTYPE lensdatabase [ <!ENTITY x \"<y>\"> ]>\n"
+        "<!-- <lens> in a comment -->\n"
+        "<lensdatabase version=\"2\">\n"
+        "    <mount>\n"
+        "        <name>Test &amp; Mount</name>\n"
+        "        <compat>M&#52;2</compat>\n"
+        "    </mount>\n"
+        "    <lens>\n"
+        "        <maker>T&#xe9;st</maker>\n"
+        "        <model><![CDATA[Lens <1> & co]]></model>\n"
+        "        <mount>Test &amp; Mount</mount>\n"
+        "        <cropfactor>1.5</cropfactor>\n"
+        "        <calibration>\n"
+        "            <distortion model = \"ptlens\" focal=\"50\" a=\"0.01\" b='-0.02' c=\"0.03\"/>\n"
+        "        </calibration>\n"
+        "    </lens>\n"
+        "</lensdatabase>\n";
+
+    lfDatabase db;
+    g_assert_cmpint(db.Load ("syntax.xml", xml, sizeof (xml) - 1), ==, LF_NO_ERROR);
+
+    const lfMount *mount = db.GetMounts () [0];
+    g_assert_nonnull(mount);
+    g_assert_cmpstr(mount->Name, ==, "Test & Mount");
+    g_assert_cmpstr(mount->Compat [0], ==, "M42");
+
+    const lfLens *lens = db.GetLenses () [0];
+    g_assert_nonnull(lens);
+    g_assert_cmpstr(lens->Maker, ==, "T\xc3\xa9st");
+    g_assert_cmpstr(lens->Model, ==, "Lens <1> & co");
+    g_assert_cmpstr(lens->Mounts [0], ==, "Test & Mount");
+    g_assert_nonnull(lens->CalibDistortion);
+    g_assert_cmpfloat(lens->CalibDistortion [0]->Terms [1], ==, -0.02f);
+    g_assert_null(lens->CalibDistortion [1]);
+}
+
+// test that saved databases load back to the same contents
+void test_DB_save(lfFixture* lfFix, gconstpointer data)
+{
+    const lfMount *const *mounts = lfFix->db->GetMounts ();
+    const lfCamera *const *cameras = lfFix->db->GetCameras ();
+    const lfLens *const *lenses = lfFix->db->GetLenses ();
+    char *output = lfDatabase::Save (mounts, cameras, lenses);
+    g_assert_nonnull(output);
+
+    gchar *dir = g_build_filename (g_get_tmp_dir (), "lensfun-test-XXXXXX", NULL);
+    g_assert_nonnull(g_mkdtemp (dir));
+    gchar *path = g_build_filename (dir, "saved.xml", NULL);
+    g_assert_cmpint(lfFix->db->Save (path), ==, LF_NO_ERROR);
+    gchar *contents;
+    g_assert_true(g_file_get_contents (path, &contents, NULL, NULL));
+    g_assert_cmpstr(contents, ==, output);
+    g_free (contents);
+
+    lfDatabase db;
+    g_assert_cmpint(db.Load (path), ==, LF_NO_ERROR);
+    int i;
+    for (i = 0; lenses [i]; i++)
+        g_assert_nonnull(db.GetLenses () [i]);
+    g_assert_null(db.GetLenses () [i]);
+    char *again = lfDatabase::Save (db.GetMounts (), db.GetCameras (), db.GetLenses ());
+    g_assert_cmpstr(again, ==, output);
+    lf_free (again);
+    lf_free (output);
+
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (path);
+    g_free (dir);
+}
+
+void test_DB_compressed(lfFixture* lfFix, gconstpointer data)
+{
+    char *output = lfDatabase::Save (lfFix->db->GetMounts (), lfFix->db->GetCameras (),
+                                     lfFix->db->GetLenses ());
+    gchar *dir = g_build_filename (g_get_tmp_dir (), "lensfun-test-XXXXXX", NULL);
+    g_assert_nonnull(g_mkdtemp (dir));
+
+    static const char *const names [] = { "saved.xml.gz", "saved.xml.zst" };
+    for (size_t i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        gchar *path = g_build_filename (dir, names [i], NULL);
+        lfError err = lfFix->db->Save (path);
+        // Built without support for this format
+        if (err == -ENOTSUP)
+        {
+            g_free (path);
+            continue;
+        }
+        g_assert_cmpint(err, ==, LF_NO_ERROR);
+
+        // Loading through a directory exercises the streaming decoder
+        lfDatabase db;
+        g_assert_cmpint(db.Load (dir), ==, LF_NO_ERROR);
+        char *again = lfDatabase::Save (db.GetMounts (), db.GetCameras (), db.GetLenses ());
+        g_assert_cmpstr(again, ==, output);
+        lf_free (again);
+
+        g_unlink (path);
+        g_free (path);
+    }
+
+    lf_free (output);
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+void test_DB_mlstr_get(lfFixture* lfFix, gconstpointer data)
+{
+    const lfLens *lens = NULL;
+    for (const lfLens *const *l = lfFix->db->GetLenses (); *l; l++)
+        if (!strcmp ((*l)->Model, "HD2 & compatibles"))
+            lens = *l;
+    g_assert_nonnull(lens);
+
+    lfFix->db->SetLanguage ("de");
+    g_assert_cmpstr(lfFix->db->MLstrGet (lens->Model), ==, "festes Objektiv");
+    g_assert_cmpstr(lfFix->db->MLstrGet (lens->Maker), ==, "GoPro");
+    g_assert_null(lfFix->db->MLstrGet (NULL));
+
+    // Strings which are not in the database are translated as well
+    lfMLstr str = lf_mlstr_add (NULL, NULL, "lens");
+    str = lf_mlstr_add (str, "de", "Objektiv");
+    g_assert_cmpstr(lfFix->db->MLstrGet (str), ==, "Objektiv");
+
+    // Unknown languages fall back to English
+    lfFix->db->SetLanguage ("xx");
+    g_assert_cmpstr(lfFix->db->MLstrGet (lens->Model), ==, "fixed lens");
+    g_assert_cmpstr(lfFix->db->MLstrGet (str), ==, "lens");
+
+    lfFix->db->SetLanguage (NULL);
+    g_assert_cmpstr(lfFix->db->MLstrGet (lens->Model), ==, lf_mlstr_get (lens->Model));
+    lf_free (str);
+}
+
+// the focal lengths and apertures given in lens names
+void test_DB_guess_parameters(lfFixture* lfFix, gconstpointer data)
+{
+    static const struct
+    {
+        const char *model;
+        float minf, maxf, mina;
+    } names [] =
+    {
+        { "Canon EF 70-200mm f/2.8L IS USM", 70, 200, 2.8F },
+        { "Olympus Zuiko Digital 14-42MM F3.5-5.6", 14, 42, 3.5F },
+        { "Nikkor 50mm 1:1.4", 50, 50, 1.4F },
+        { "Nikkor 1:2.8 24-70mm", 24, 70, 2.8F },
+        { "Zeiss Distagon T* 2.8/21", 21, 21, 2.8F },
+        { "Tamron 2.8-4/17-50", 17, 50, 2.8F },
+        // Teleconverters have no focal length of their own
+        { "Kenko Teleplus 1.4x 50mm f/2", 0, 0, 0 },
+        { "Fisheye", 0, 0, 0 },
+    };
+
+    for (size_t i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        lfLens lens;
+        lens.SetModel (names [i].model);
+        lens.GuessParameters ();
+        g_assert_cmpfloat(lens.MinFocal, ==, names [i].minf);
+        g_assert_cmpfloat(lens.MaxFocal, ==, names [i].maxf);
+        g_assert_cmpfloat(lens.MinAperture, ==, names [i].mina);
+    }
+}
+
 int main (int argc, char **argv)
 {
 
@@ -82,6 +709,17 @@ int main (int argc, char **argv)
 
     g_test_add("/database/lens search", lfFixture, NULL, db_setup, test_DB_lens_search, db_teardown);
     g_test_add("/database/camera search", lfFixture, NULL, db_setup, test_DB_cam_search, db_teardown);
+    g_test_add("/database/lens calibrations", lfFixture, NULL, db_setup, test_DB_lens_calibrations, db_teardown);
+    g_test_add("/database/reload", lfFixture, NULL, db_setup, test_DB_reload, db_teardown);
+    g_test_add("/database/live reload", lfFixture, NULL, db_setup, test_DB_live_reload, db_teardown);
+    g_test_add("/database/load filter", lfFixture, NULL, db_setup, test_DB_load_filter, db_teardown);
+    g_test_add("/database/lazy calibrations", lfFixture, NULL, db_setup, test_DB_lazy_calibrations, db_teardown);
+    g_test_add("/database/lazy calibrations in threads", lfFixture, NULL, db_setup, test_DB_lazy_threads, db_teardown);
+    g_test_add("/database/xml syntax", lfFixture, NULL, db_setup, test_DB_xml_syntax, db_teardown);
+    g_test_add("/database/save", lfFixture, NULL, db_setup, test_DB_save, db_teardown);
+    g_test_add("/database/compressed", lfFixture, NULL, db_setup, test_DB_compressed, db_teardown);
+    g_test_add("/database/mlstr get", lfFixture, NULL, db_setup, test_DB_mlstr_get, db_teardown);
+    g_test_add("/database/guess parameters", lfFixture, NULL, NULL, test_DB_guess_parameters, NULL);
 
     return g_test_run();
 }
@@ -4,6 +4,7 @@
 #define _USE_MATH_DEFINES
 #endif
 #include <cmath>
+#include <cstring>
 #include "lensfun.h"
 
 typedef struct {
@@ -123,6 +124,189 @@ void test_mod_projection_borders(lfFixture* lfFix, gconstpointer data)
     }
 }
 
+static void identity_callback (void *data, float *iocoord, int count)
+{
+}
+
+static int scale_callback_calls = 0;
+
+static void scale_callback (void *data, float *iocoord, int count)
+{
+    const float scale = *(float *)data;
+    for (int i = 0; i < count * 2; i++)
+        iocoord [i] *= scale;
+    scale_callback_calls++;
+}
+
+// a modifier with the same geometry and callbacks must take the automatic
+// scale from the cache instead of evaluating the callbacks again
+void test_mod_autoscale_cache(lfFixture* lfFix, gconstpointer data)
+{
+    float scales [] = {0.93f, 0.95f};
+    float result [3];
+    int calls [3];
+    for (int i = 0; i < 3; i++)
+    {
+        lfModifier mod (lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+        mod.AddCoordCallback(scale_callback, 500, &scales [i / 2], sizeof (float));
+        const int before = scale_callback_calls;
+        result [i] = mod.GetAutoScale(false);
+        calls [i] = scale_callback_calls - before;
+    }
+
+    g_assert_cmpint(calls[0], >, 0);
+    g_assert_cmpint(calls[1], ==, 0);
+    g_assert_cmpfloat(result[1], ==, result[0]);
+    // different callback data is a different cache entry
+    g_assert_cmpint(calls[2], >, 0);
+    g_assert_cmpfloat(result[2], !=, result[0]);
+}
+
+// check the performance counters, if they are compiled in
+void test_mod_stats(lfFixture* lfFix, gconstpointer data)
+{
+    lfFix->mod = new lfModifier (lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+    lfFix->mod->Initialize (
+        lfFix->lens, LF_PF_U8, 12.0f,
+        6.7f, 2.0f, 1.0f, LF_RECTILINEAR,
+        LF_MODIFY_DISTORTION, true);
+
+    lfModifierStats stats;
+    if (!lfFix->mod->EnableStats(true)) {
+        g_assert_false(lfFix->mod->GetStats(&stats));
+        g_assert_null(lfFix->mod->DumpStats());
+        delete lfFix->mod;
+        return;
+    }
+
+    float *res = g_new(float, lfFix->img_width * 2);
+
+    // the radial table handles this chain
+    lfFix->mod->ApplyGeometryDistortion(0, 0, lfFix->img_width, 1, res);
+    g_assert_true(lfFix->mod->GetStats(&stats));
+    g_assert_cmpuint(stats.TablePixels, ==, lfFix->img_width);
+
+    // a callback which is not radial disables the table
+    lfFix->mod->AddCoordCallback(identity_callback, 999, NULL, 0);
+    lfFix->mod->ApplyGeometryDistortion(0, 0, lfFix->img_width, 1, res);
+    g_assert_true(lfFix->mod->GetStats(&stats));
+    g_assert_cmpint(stats.NumCoord, ==, 2);
+    g_assert_cmpstr(stats.Coord[0].Name, ==, "ModifyCoord_UnDist_Poly3");
+    g_assert_cmpint(stats.Coord[0].Priority, ==, 250);
+    g_assert_cmpuint(stats.Coord[0].Pixels, ==, lfFix->img_width);
+    g_assert_cmpstr(stats.Coord[1].Name, ==, "user");
+    g_assert_cmpuint(stats.Coord[1].Pixels, ==, lfFix->img_width);
+    g_assert_cmpuint(stats.NotFinite, ==, 0);
+
+    guint64 solved = 0;
+    for (int i = 0; i < LF_STATS_NEWTON_BINS; i++)
+        solved += stats.NewtonSteps[i];
+    g_assert_cmpuint(solved, >, 0);
+
+    char *dump = lfFix->mod->DumpStats();
+    g_assert_nonnull(strstr(dump, "ModifyCoord_UnDist_Poly3"));
+    lf_free(dump);
+
+    lfFix->mod->ResetStats();
+    g_assert_true(lfFix->mod->GetStats(&stats));
+    g_assert_cmpuint(stats.Coord[0].Pixels, ==, 0);
+    g_assert_cmpuint(stats.TablePixels, ==, 0);
+
+    // nothing is counted while disabled
+    lfFix->mod->EnableStats(false);
+    lfFix->mod->ApplyGeometryDistortion(0, 0, lfFix->img_width, 1, res);
+    g_assert_true(lfFix->mod->GetStats(&stats));
+    g_assert_cmpuint(stats.Coord[0].Pixels, ==, 0);
+
+    g_free(res);
+    delete lfFix->mod;
+}
+
+// a radial callback which is added after Initialize is tabulated as well
+void test_mod_radial_table_rebuild(lfFixture* lfFix, gconstpointer data)
+{
+    lfFix->mod = new lfModifier (lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+    lfFix->mod->Initialize (
+        lfFix->lens, LF_PF_U8, 12.0f,
+        6.7f, 2.0f, 1.0f, LF_RECTILINEAR,
+        LF_MODIFY_DISTORTION, true);
+    lfFix->mod->AddCoordCallbackScale(1.1f);
+    bool stats = lfFix->mod->EnableStats(true);
+
+    // the callback which is not radial disables the table
+    lfModifier reference (lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+    reference.Initialize (
+        lfFix->lens, LF_PF_U8, 12.0f,
+        6.7f, 2.0f, 1.0f, LF_RECTILINEAR,
+        LF_MODIFY_DISTORTION, true);
+    reference.AddCoordCallbackScale(1.1f);
+    reference.AddCoordCallback(identity_callback, 999, NULL, 0);
+
+    float *res = g_new(float, lfFix->img_width * 2);
+    float *expected = g_new(float, lfFix->img_width * 2);
+    for (size_t y = 0; y < lfFix->img_height; y += 50)
+    {
+        g_assert_true(lfFix->mod->ApplyGeometryDistortion(0, y, lfFix->img_width, 1, res));
+        g_assert_true(reference.ApplyGeometryDistortion(0, y, lfFix->img_width, 1, expected));
+        for (size_t i = 0; i < lfFix->img_width * 2; i++)
+            g_assert_cmpfloat(fabs(res[i] - expected[i]), <=, 1e-2);
+    }
+
+    lfModifierStats counters;
+    if (stats)
+    {
+        g_assert_true(lfFix->mod->GetStats(&counters));
+        g_assert_cmpuint(counters.TablePixels, ==, lfFix->img_width * 7);
+    }
+
+    g_free(expected);
+    g_free(res);
+    delete lfFix->mod;
+}
+
+// for a circular fisheye, the image edge is crossed several times along some
+// directions; autoscaling must find the nearest crossing rather than shrink
+// the image to a farther one, and still keep the border of the corrected
+// image inside the original one
+void test_mod_autoscale_fisheye(lfFixture* lfFix, gconstpointer data)
+{
+    lfLens lens;
+    lens.CropFactor = 1.534f;
+    lens.AspectRatio = 1.5f;
+    lens.Type = LF_FISHEYE;
+    lfLensCalibDistortion calib =
+        {LF_DIST_MODEL_PTLENS, 4.5f, 4.53319f, true, {-0.21693f, -0.44076f, -0.47357f}};
+    lens.AddCalibDistortion(&calib);
+
+    const int width = 1200, height = 800;
+    lfModifier mod (&lens, lens.CropFactor, width, height);
+    mod.Initialize (
+        &lens, LF_PF_F32, 4.5f,
+        2.8f, 1000.0f, 0.0f, LF_FISHEYE,
+        LF_MODIFY_DISTORTION | LF_MODIFY_SCALE, false);
+
+    // the nearest crossing needs a scale of about 0.76, a farther one 0.5
+    lfModifier unscaled (&lens, lens.CropFactor, width, height);
+    unscaled.Initialize (
+        &lens, LF_PF_F32, 4.5f,
+        2.8f, 1000.0f, 1.0f, LF_FISHEYE,
+        LF_MODIFY_DISTORTION, false);
+    g_assert_cmpfloat(unscaled.GetAutoScale(false), >, 0.75);
+    g_assert_cmpfloat(unscaled.GetAutoScale(false), <, 0.77);
+
+    float res[2];
+    for (int i = 0; i < 2 * (width + height); i++)
+    {
+        if (i < 2 * width)
+            mod.ApplyGeometryDistortion(i / 2, i % 2 ? height - 1 : 0, 1, 1, res);
+        else
+            mod.ApplyGeometryDistortion(i % 2 ? width - 1 : 0, (i - 2 * width) / 2, 1, 1, res);
+        g_assert_cmpfloat(res[0], >=, -0.01);
+        g_assert_cmpfloat(res[0], <=, width - 1 + 0.01);
+        g_assert_cmpfloat(res[1], >=, -0.01);
+        g_assert_cmpfloat(res[1], <=, height - 1 + 0.01);
+    }
+}
 
 int main (int argc, char **argv)
 {
@@ -133,6 +317,10 @@ int main (int argc, char **argv)
 
     g_test_add("/modifier/projection center", lfFixture, NULL, mod_setup, test_mod_projection_center, mod_teardown);
     g_test_add("/modifier/projection borders", lfFixture, NULL, mod_setup, test_mod_projection_borders, mod_teardown);
+    g_test_add("/modifier/stats", lfFixture, NULL, mod_setup, test_mod_stats, mod_teardown);
+    g_test_add("/modifier/radial table rebuild", lfFixture, NULL, mod_setup, test_mod_radial_table_rebuild, mod_teardown);
+    g_test_add("/modifier/autoscale cache", lfFixture, NULL, mod_setup, test_mod_autoscale_cache, mod_teardown);
+    g_test_add("/modifier/autoscale fisheye", lfFixture, NULL, mod_setup, test_mod_autoscale_fisheye, mod_teardown);
 
     return g_test_run();
 }
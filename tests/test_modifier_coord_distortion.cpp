@@ -107,6 +107,171 @@ void test_mod_coord_distortion_parallel(lfFixture *lfFix, gconstpointer data)
 }
 #endif
 
+// distorting the undistorted coordinates must yield the original pixel grid
+void test_mod_coord_distortion_roundtrip(lfFixture *lfFix, gconstpointer data)
+{
+  lfTestParams *p = (lfTestParams *)data;
+
+  lfModifier forward(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+  forward.Initialize(
+    lfFix->lens, LF_PF_F32,
+    24.0f, 2.8f, 1000.0f, 1.0f, LF_RECTILINEAR,
+    LF_MODIFY_DISTORTION, !p->reverse);
+
+  for(size_t y = 0; y < lfFix->img_height; y += 7)
+  {
+    float *coordData = (float *)lfFix->coordBuff;
+
+    g_assert_true(
+      lfFix->mod->ApplyGeometryDistortion(0.0, y, lfFix->img_width, 1, coordData)
+    );
+
+    for(size_t x = 0; x < lfFix->img_width; x += 7)
+    {
+      float res[2];
+      g_assert_true(
+        forward.ApplyGeometryDistortion(coordData[2 * x], coordData[2 * x + 1], 1, 1, res)
+      );
+      g_assert_cmpfloat(fabs(res[0] - x), <=, 1e-2);
+      g_assert_cmpfloat(fabs(res[1] - y), <=, 1e-2);
+    }
+  }
+
+  g_assert_cmpuint(lfFix->mod->GetNonConvergedCount(), ==, 0);
+}
+
+void identity_callback(void *data, float *iocoord, int count)
+{
+}
+
+// the tabulated radial chain must agree with calling the callbacks per pixel,
+// both for a centred lens (mirrored quadrants) and an offset one
+void test_mod_coord_distortion_radial_table(lfFixture *lfFix, gconstpointer data)
+{
+  lfTestParams *p = (lfTestParams *)data;
+
+  const float centers[] = {0.0f, 0.0123f};
+  for(size_t c = 0; c < sizeof(centers) / sizeof(centers[0]); c++)
+  {
+    lfFix->lens->CenterX = centers[c];
+    lfFix->lens->CenterY = -centers[c];
+
+    lfModifier mod(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+    mod.Initialize(
+      lfFix->lens, LF_PF_F32,
+      24.0f, 2.8f, 1000.0f, 1.0f, LF_RECTILINEAR,
+      LF_MODIFY_DISTORTION, p->reverse);
+
+    // an unknown callback disables the radial table
+    lfModifier reference(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+    reference.Initialize(
+      lfFix->lens, LF_PF_F32,
+      24.0f, 2.8f, 1000.0f, 1.0f, LF_RECTILINEAR,
+      LF_MODIFY_DISTORTION, p->reverse);
+    reference.AddCoordCallback(identity_callback, 1000, NULL, 0);
+
+    float *coordData = (float *)lfFix->coordBuff;
+    g_assert_true(
+      mod.ApplyGeometryDistortion(0.0, 0.0, lfFix->img_width, lfFix->img_height, coordData)
+    );
+
+    std::vector<float> expected(2 * lfFix->img_width);
+    for(size_t y = 0; y < lfFix->img_height; y++)
+    {
+      g_assert_true(
+        reference.ApplyGeometryDistortion(0.0, y, lfFix->img_width, 1, &expected[0])
+      );
+
+      // the SSE kernels approximate the square root, the table does not
+      for(size_t i = 0; i < 2 * lfFix->img_width; i++)
+        g_assert_cmpfloat(fabs(coordData[2 * y * lfFix->img_width + i] - expected[i]), <=, 1e-2);
+    }
+  }
+}
+
+// after autoscaling, the border of the corrected image must lie inside the
+// original one, and a second modifier for the same lens and image must get
+// the same scale (cache hits are checked in test_modifier.cpp)
+void test_mod_coord_distortion_autoscale(lfFixture *lfFix, gconstpointer data)
+{
+  lfModifier mod(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+  mod.Initialize(
+    lfFix->lens, LF_PF_F32,
+    24.0f, 2.8f, 1000.0f, 0.0f, LF_RECTILINEAR,
+    LF_MODIFY_DISTORTION | LF_MODIFY_SCALE, false);
+
+  const float w = lfFix->img_width - 1, h = lfFix->img_height - 1;
+  for(size_t i = 0; i < lfFix->img_width; i++)
+  {
+    float res[4];
+    g_assert_true(mod.ApplyGeometryDistortion(i, 0.0, 1, 1, res));
+    g_assert_true(mod.ApplyGeometryDistortion(i, h, 1, 1, res + 2));
+    for(int k = 0; k < 4; k += 2)
+    {
+      g_assert_cmpfloat(res[k], >=, -0.01);
+      g_assert_cmpfloat(res[k], <=, w + 0.01);
+      g_assert_cmpfloat(res[k + 1], >=, -0.01);
+      g_assert_cmpfloat(res[k + 1], <=, h + 0.01);
+    }
+  }
+
+  lfModifier other(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+  other.Initialize(
+    lfFix->lens, LF_PF_F32,
+    24.0f, 2.8f, 1000.0f, 1.0f, LF_RECTILINEAR,
+    LF_MODIFY_DISTORTION, false);
+  const float scale = other.GetAutoScale(false);
+  g_assert_cmpfloat(scale, >, 0.0f);
+  g_assert_cmpfloat(lfFix->mod->GetAutoScale(false), ==, scale);
+}
+
+// the crop of the largest valid rectangle must only contain valid pixels, and
+// it must retain at least as much of the image as plain autoscaling
+void test_mod_coord_distortion_autocrop(lfFixture *lfFix, gconstpointer data)
+{
+  float crop[4];
+  const float scale = lfFix->mod->GetAutoCrop(false, crop);
+  const float autoscale = lfFix->mod->GetAutoScale(false);
+  g_assert_cmpfloat(scale, >, 0.0f);
+
+  const float w = lfFix->img_width - 1, h = lfFix->img_height - 1;
+  g_assert_cmpfloat(crop[0], >=, 0.0f);
+  g_assert_cmpfloat(crop[1], <=, w);
+  g_assert_cmpfloat(crop[2], >=, 0.0f);
+  g_assert_cmpfloat(crop[3], <=, h);
+  g_assert_cmpfloat(crop[0], <, crop[1]);
+  g_assert_cmpfloat(crop[2], <, crop[3]);
+
+  const double area = (crop[1] - crop[0]) * (crop[3] - crop[2]) / (scale * scale);
+  g_assert_cmpfloat(area, >=, 0.99 * w * h / (autoscale * autoscale));
+
+  lfModifier mod(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+  mod.Initialize(
+    lfFix->lens, LF_PF_F32,
+    24.0f, 2.8f, 1000.0f, scale, LF_RECTILINEAR,
+    LF_MODIFY_DISTORTION | LF_MODIFY_SCALE, false);
+
+  for(int i = 0; i <= 100; i++)
+  {
+    const float t = i / 100.0f;
+    const float points[] = {
+      crop[0] + t * (crop[1] - crop[0]), crop[2],
+      crop[0] + t * (crop[1] - crop[0]), crop[3],
+      crop[0], crop[2] + t * (crop[3] - crop[2]),
+      crop[1], crop[2] + t * (crop[3] - crop[2])
+    };
+    for(int k = 0; k < 8; k += 2)
+    {
+      float res[2];
+      g_assert_true(mod.ApplyGeometryDistortion(points[k], points[k + 1], 1, 1, res));
+      g_assert_cmpfloat(res[0], >=, -0.05);
+      g_assert_cmpfloat(res[0], <=, w + 0.05);
+      g_assert_cmpfloat(res[1], >=, -0.05);
+      g_assert_cmpfloat(res[1], <=, h + 0.05);
+    }
+  }
+}
+
 gchar *describe(lfTestParams *p, const char *prefix)
 {
   gchar alignment[32] = "";
@@ -130,6 +295,32 @@ void add_set_item(lfTestParams *p)
   g_free(desc);
   desc = NULL;
 
+  if(!p->reverse)
+  {
+    desc = describe(p, "modifier/coord/autoscale");
+    g_test_add(desc, lfFixture, p, mod_setup, test_mod_coord_distortion_autoscale, mod_teardown);
+    g_free(desc);
+    desc = NULL;
+
+    desc = describe(p, "modifier/coord/autocrop");
+    g_test_add(desc, lfFixture, p, mod_setup, test_mod_coord_distortion_autocrop, mod_teardown);
+    g_free(desc);
+    desc = NULL;
+  }
+
+  desc = describe(p, "modifier/coord/radialTable");
+  g_test_add(desc, lfFixture, p, mod_setup, test_mod_coord_distortion_radial_table, mod_teardown);
+  g_free(desc);
+  desc = NULL;
+
+  if(p->reverse)
+  {
+    desc = describe(p, "modifier/coord/roundtrip");
+    g_test_add(desc, lfFixture, p, mod_setup, test_mod_coord_distortion_roundtrip, mod_teardown);
+    g_free(desc);
+    desc = NULL;
+  }
+
 #ifdef _OPENMP
   desc = describe(p, "modifier/coord/parallelFor");
   g_test_add(desc, lfFixture, p, mod_setup, test_mod_coord_distortion_parallel, mod_teardown);
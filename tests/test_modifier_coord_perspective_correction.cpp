@@ -68,13 +68,13 @@ void mod_teardown (lfFixture *lfFix, gconstpointer data)
 
 void test_mod_coord_pc_svd (lfFixture *lfFix, gconstpointer data)
 {
-    dvector x (5), y (5);
+    double x [5], y [5];
     x[0] = 1; y[0] = 1;
     x[1] = 2; y[1] = 2;
     x[2] = 3; y[2] = 2;
     x[3] = 2; y[3] = 0;
     x[4] = 1; y[4] = 1.5;
-    matrix M (5, dvector (6));
+    double M [5][LF_SVD_COLUMNS];
     for (int i = 0; i < 5; i++)
     {
         M [i][0] = x [i] * x [i];
@@ -84,7 +84,8 @@ void test_mod_coord_pc_svd (lfFixture *lfFix, gconstpointer data)
         M [i][4] = y [i];
         M [i][5] = 1;
     }
-    dvector result = svd (M);
+    double result [LF_SVD_COLUMNS];
+    g_assert_true (svd (M, 5, result));
     const float epsilon = std::numeric_limits<double>::epsilon();
     g_assert_cmpfloat (fabs (result [0] - 0.04756514941544937), <=, epsilon);
     g_assert_cmpfloat (fabs (result [1] - 0.09513029883089875), <=, epsilon);
@@ -219,6 +220,116 @@ void test_mod_coord_pc_7_points (lfFixture *lfFix, gconstpointer data)
     }
 }
 
+void test_mod_coord_pc_batch (lfFixture *lfFix, gconstpointer data)
+{
+    const float epsilon = std::numeric_limits<float>::epsilon();
+
+    float x8[] = {615, 264, 1280, 813, 615, 1280, 264, 813};
+    float y8[] = {755, 292, 622, 220, 755, 622, 292, 220};
+    float x5[] = {661, 594, 461, 426, 530};
+    float y5[] = {501, 440, 442, 534, 562};
+    float x7[] = {661, 594, 461, 426, 530, 302, 815};
+    float y7[] = {501, 440, 442, 534, 562, 491, 279};
+    float *x[] = {x8, x5, x5, x7};
+    float *y[] = {y8, y5, y5, y7};
+    int count[] = {8, 5, 0, 7};
+    float d[] = {0, 0, 0, 0};
+    lfPerspectiveCorrection corrections [4];
+    g_assert_cmpint (lfFix->mod->FitPerspectiveCorrections (x, y, count, d, 4, corrections), ==, 3);
+    g_assert_false (corrections [2].Valid);
+
+    for (int i = 0; i < 4; i++)
+    {
+        lfPerspectiveCorrection single;
+        g_assert_true (lfFix->mod->FitPerspectiveCorrection (x [i], y [i], count [i], d [i], &single)
+                       == (bool)corrections [i].Valid);
+        if (single.Valid)
+            for (int j = 0; j < 11; j++)
+                g_assert_cmpfloat (single.Params [j], ==, corrections [i].Params [j]);
+    }
+    // Fitting alone must not enable anything
+    float coords [2];
+    g_assert_false (lfFix->mod->ApplyGeometryDistortion (0.0f, 0.0f, 1, 1, coords));
+
+    g_assert_false (lfFix->mod->AttachPerspectiveCorrection (&corrections [2]));
+    g_assert_true (lfFix->mod->AttachPerspectiveCorrection (&corrections [3]));
+
+    // Same as test_mod_coord_pc_7_points
+    float expected_x[] = {-138.189011f, 3.89023399f, 144.487122f, 283.624481f, 421.325409f,
+                          557.611755f, 692.505188f, 826.027039f, 958.197815f, 1089.03845f};
+    float expected_y[] = {522.404114f, 532.473145f, 542.437073f, 552.297729f, 562.056335f,
+                          571.714905f, 581.274719f, 590.737183f, 600.104004f, 609.376526f};
+    for (int i = 0; i < 10; i++)
+    {
+        g_assert_true (lfFix->mod->ApplyGeometryDistortion (100.0f * i, 100.0f * i, 1, 1, coords));
+        g_assert_cmpfloat (fabs (coords [0] - expected_x [i]), <=, epsilon);
+        g_assert_cmpfloat (fabs (coords [1] - expected_y [i]), <=, epsilon);
+    }
+}
+
+// Whole rows may take the vectorised path; it must agree with single points
+void test_mod_coord_pc_row (lfFixture *lfFix, gconstpointer data)
+{
+    float x[] = {503, 1063, 509, 1066};
+    float y[] = {150, 197, 860, 759};
+    g_assert_true (lfFix->mod->EnablePerspectiveCorrection (x, y, 4, 0));
+
+    float *row = (float *)lfFix->coordBuff;
+    for (size_t j = 0; j < lfFix->img_height; j += 111)
+    {
+        g_assert_true (lfFix->mod->ApplyGeometryDistortion (0.0f, j, lfFix->img_width, 1, row));
+        for (size_t i = 0; i < lfFix->img_width; i++)
+        {
+            // Rows accumulate the x coordinate, which costs a few ulps, too
+            float coords [2];
+            g_assert_true (lfFix->mod->ApplyGeometryDistortion (i, j, 1, 1, coords));
+            g_assert_cmpfloat (fabs (row [2 * i] - coords [0]), <=, 1e-3 + 1e-5 * fabs (coords [0]));
+            g_assert_cmpfloat (fabs (row [2 * i + 1] - coords [1]), <=, 1e-3 + 1e-5 * fabs (coords [1]));
+        }
+    }
+}
+
+// The valid area of a perspective correction is neither centred nor
+// symmetric; the crop of GetAutoCrop must still contain only pixels from
+// within the original image, and scaling about the image centre must not
+// waste most of it
+void test_mod_coord_pc_autocrop (lfFixture *lfFix, gconstpointer data)
+{
+    float x[] = {503, 1063, 509, 1066};
+    float y[] = {150, 197, 860, 759};
+    g_assert_true (lfFix->mod->EnablePerspectiveCorrection (x, y, 4, 0));
+
+    float crop [4];
+    const float scale = lfFix->mod->GetAutoCrop (false, crop);
+    g_assert_cmpfloat (scale, >, 0.0f);
+    g_assert_cmpfloat (crop [0], <, crop [1]);
+    g_assert_cmpfloat (crop [2], <, crop [3]);
+
+    const float w = lfFix->img_width - 1, h = lfFix->img_height - 1;
+    g_assert_cmpfloat ((crop [1] - crop [0]) * (crop [3] - crop [2]), >=, 0.5 * w * h);
+
+    lfModifier mod (lfFix->lens, 1.534f, lfFix->img_width, lfFix->img_height);
+    mod.Initialize (lfFix->lens, LF_PF_F32, 50.89f, 2.8f, 1000.0f, scale, LF_RECTILINEAR,
+                    LF_MODIFY_SCALE, false);
+    g_assert_true (mod.EnablePerspectiveCorrection (x, y, 4, 0));
+
+    // Every pixel on the outline of the crop, including its corners
+    const int left = ceil (crop [0]), right = floor (crop [1]);
+    const int top = ceil (crop [2]), bottom = floor (crop [3]);
+    const int width = right - left + 1, height = bottom - top + 1;
+    for (int i = 0; i < 2 * (width + height); i++)
+    {
+        float coords [2];
+        if (i < 2 * width)
+            g_assert_true (mod.ApplyGeometryDistortion (left + i / 2, i % 2 ? bottom : top, 1, 1, coords));
+        else
+            g_assert_true (mod.ApplyGeometryDistortion (i % 2 ? right : left, top + (i - 2 * width) / 2, 1, 1, coords));
+        g_assert_cmpfloat (coords [0], >=, -0.05);
+        g_assert_cmpfloat (coords [0], <=, w + 0.05);
+        g_assert_cmpfloat (coords [1], >=, -0.05);
+        g_assert_cmpfloat (coords [1], <=, h + 0.05);
+    }
+}
 
 int main (int argc, char **argv)
 {
@@ -230,6 +341,8 @@ int main (int argc, char **argv)
               mod_setup, test_mod_coord_pc_svd, mod_teardown);
   g_test_add ("/modifier/coord/pc/4 points", lfFixture, NULL,
               mod_setup, test_mod_coord_pc_4_points, mod_teardown);
+  g_test_add ("/modifier/coord/pc/row", lfFixture, NULL,
+              mod_setup, test_mod_coord_pc_row, mod_teardown);
   g_test_add ("/modifier/coord/pc/4 points portrait", lfFixture, NULL,
               mod_setup_portrait, test_mod_coord_pc_4_points_portrait, mod_teardown);
   g_test_add ("/modifier/coord/pc/8 points", lfFixture, NULL,
@@ -240,6 +353,10 @@ int main (int argc, char **argv)
               mod_setup, test_mod_coord_pc_5_points, mod_teardown);
   g_test_add ("/modifier/coord/pc/7 points", lfFixture, NULL,
               mod_setup, test_mod_coord_pc_7_points, mod_teardown);
+  g_test_add ("/modifier/coord/pc/batch", lfFixture, NULL,
+              mod_setup, test_mod_coord_pc_batch, mod_teardown);
+  g_test_add ("/modifier/coord/pc/autocrop", lfFixture, NULL,
+              mod_setup, test_mod_coord_pc_autocrop, mod_teardown);
 
   return g_test_run();
 }
@@ -107,6 +107,40 @@ void test_mod_subpix_parallel(lfFixture *lfFix, gconstpointer data)
 }
 #endif
 
+void identity_callback(void *data, float *iocoord, int count)
+{
+}
+
+// the tabulated radial chain must agree with calling the callbacks per pixel
+void test_mod_subpix_radial_table(lfFixture *lfFix, gconstpointer data)
+{
+  lfTestParams *p = (lfTestParams *)data;
+
+  // an unknown callback disables the radial table
+  lfModifier reference(lfFix->lens, 1.0f, lfFix->img_width, lfFix->img_height);
+  reference.Initialize(
+    lfFix->lens, LF_PF_F32,
+    24.0f, 2.8f, 1000.0f, 1.0f, LF_RECTILINEAR,
+    LF_MODIFY_TCA, p->reverse);
+  reference.AddSubpixelCallback(identity_callback, 1000, NULL, 0);
+
+  std::vector<float> expected(2 * 3 * lfFix->img_width);
+  for(size_t y = 0; y < lfFix->img_height; y++)
+  {
+    float *coordData = (float *)lfFix->coordBuff;
+
+    g_assert_true(
+      lfFix->mod->ApplySubpixelGeometryDistortion(0.0, y, lfFix->img_width, 1, coordData)
+    );
+    g_assert_true(
+      reference.ApplySubpixelGeometryDistortion(0.0, y, lfFix->img_width, 1, &expected[0])
+    );
+
+    for(size_t i = 0; i < 2 * 3 * lfFix->img_width; i++)
+      g_assert_cmpfloat(fabs(coordData[i] - expected[i]), <=, 1e-3);
+  }
+}
+
 gchar *describe(lfTestParams *p, const char *prefix)
 {
   gchar alignment[32] = "";
@@ -130,6 +164,11 @@ void add_set_item(lfTestParams *p)
   g_free(desc);
   desc = NULL;
 
+  desc = describe(p, "modifier/subpix/radialTable");
+  g_test_add(desc, lfFixture, p, mod_setup, test_mod_subpix_radial_table, mod_teardown);
+  g_free(desc);
+  desc = NULL;
+
 #ifdef _OPENMP
   desc = describe(p, "modifier/subpix/parallelFor");
   g_test_add(desc, lfFixture, p, mod_setup, test_mod_subpix_parallel, mod_teardown);